@@ -0,0 +1,157 @@
+// Animation.h: timed effects on the high-resolution clock.
+//
+// Effects that start, play for a while and end (a kill notice, say) live in
+// an AnimationPool: fixed storage, no allocation, as many instances at once
+// as it has room for. Running instances are kept packed at the front in the
+// order they started, so a frame only ever walks the ones that are playing
+// and an idle pool costs nothing. NextExpiry() tells the render loop when the
+// next one ends, so the frame that removes it is never late.
+//
+// Looping animations (watermark sway, rainbow hue) have no end and only need
+// the time since the overlay started: AnimationSeconds().
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "Clock.h"
+#include "FrameScheduler.h"
+#include <cmath>
+#include <cstdint>
+
+// --- Easing: maps linear progress 0..1 to eased progress 0..1 ---
+
+enum Easing
+{
+    EASE_LINEAR,
+    EASE_IN_QUAD,
+    EASE_OUT_QUAD,
+    EASE_IN_OUT_QUAD,
+    EASE_OUT_CUBIC,
+    EASE_IN_OUT_SINE,
+    EASE_COUNT
+};
+
+inline float Ease(Easing easing, float t)
+{
+    if (t <= 0.0f) return 0.0f;
+    if (t >= 1.0f) return 1.0f;
+
+    switch (easing)
+    {
+    case EASE_IN_QUAD:
+        return t * t;
+    case EASE_OUT_QUAD:
+        return t * (2.0f - t);
+    case EASE_IN_OUT_QUAD:
+        return t < 0.5f ? 2.0f * t * t : 1.0f - 2.0f * (1.0f - t) * (1.0f - t);
+    case EASE_OUT_CUBIC:
+    {
+        float u = 1.0f - t;
+        return 1.0f - u * u * u;
+    }
+    case EASE_IN_OUT_SINE:
+        return 0.5f - 0.5f * cosf(t * 3.14159265f);
+    default:
+        return t;
+    }
+}
+
+// Seconds from originNs to nowNs, for animations that loop forever
+inline float AnimationSeconds(int64_t nowNs, int64_t originNs)
+{
+    return (float)((double)(nowNs - originNs) / NS_PER_SEC);
+}
+
+// --- Pool of running instances ---
+
+template <class T, int Capacity>
+class AnimationPool
+{
+public:
+    struct Instance
+    {
+        T value;
+        int64_t startNs = 0;
+        int64_t durationNs = 1;
+        Easing easing = EASE_LINEAR;
+
+        int64_t EndNs() const { return startNs + durationNs; }
+
+        // Linear progress 0..1
+        float Progress(int64_t nowNs) const
+        {
+            if (nowNs <= startNs) return 0.0f;
+            if (nowNs >= EndNs()) return 1.0f;
+            return (float)((double)(nowNs - startNs) / durationNs);
+        }
+
+        float Eased(int64_t nowNs) const { return Ease(easing, Progress(nowNs)); }
+    };
+
+    // Starts a new instance alongside the running ones. When the pool is
+    // full the oldest is ended early, so a burst always shows its newest.
+    Instance& Start(const T& value, int64_t nowNs, int64_t durationNs, Easing easing = EASE_LINEAR)
+    {
+        if (count == Capacity)
+        {
+            for (int i = 1; i < count; i++)
+                instances[i - 1] = instances[i];
+            count--;
+            evicted++;
+        }
+
+        Instance& instance = instances[count++];
+        instance.value = value;
+        instance.startNs = nowNs;
+        instance.durationNs = durationNs > 0 ? durationNs : 1;
+        instance.easing = easing;
+        started++;
+        return instance;
+    }
+
+    // Removes every instance that has ended by nowNs, keeping start order.
+    // Returns true if any was removed.
+    bool Expire(int64_t nowNs)
+    {
+        int kept = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (instances[i].EndNs() <= nowNs) continue;
+            if (kept != i) instances[kept] = instances[i];
+            kept++;
+        }
+        bool removed = kept != count;
+        count = kept;
+        return removed;
+    }
+
+    void Clear() { count = 0; }
+
+    // Earliest end of a running instance, NO_DEADLINE when none is running
+    int64_t NextExpiry() const
+    {
+        int64_t next = NO_DEADLINE;
+        for (int i = 0; i < count; i++)
+            if (instances[i].EndNs() < next)
+                next = instances[i].EndNs();
+        return next;
+    }
+
+    // Running instances, oldest first
+    int Count() const { return count; }
+    bool IsEmpty() const { return count == 0; }
+    const Instance& operator[](int i) const { return instances[i]; }
+    const Instance* begin() const { return instances; }
+    const Instance* end() const { return instances + count; }
+
+    uint64_t Started() const { return started; }
+    uint64_t Evicted() const { return evicted; } // ended early because the pool was full
+
+private:
+    Instance instances[Capacity];
+    int count = 0;
+    uint64_t started = 0;
+    uint64_t evicted = 0;
+};
+
+#endif //ANIMATION_H
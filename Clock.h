@@ -0,0 +1,49 @@
+// Clock.h: time source for scheduling, animation and timing code.
+// Everything that needs "now" takes a Clock so tests and replays can drive
+// time by hand instead of reading the system clock.
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+
+const int64_t NS_PER_US = 1000;
+const int64_t NS_PER_MS = 1000 * NS_PER_US;
+const int64_t NS_PER_SEC = 1000 * NS_PER_MS;
+
+class Clock
+{
+public:
+    virtual ~Clock() {}
+
+    // Monotonic time in nanoseconds from an arbitrary origin
+    virtual int64_t NowNs() const = 0;
+};
+
+// steady_clock is QueryPerformanceCounter on Windows and CLOCK_MONOTONIC on Linux
+class SteadyClock : public Clock
+{
+public:
+    int64_t NowNs() const override
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+// Only moves when told to
+class ManualClock : public Clock
+{
+public:
+    explicit ManualClock(int64_t startNs = 0) : now(startNs) {}
+
+    int64_t NowNs() const override { return now; }
+    void Set(int64_t ns) { now = ns; }
+    void Advance(int64_t ns) { now += ns; }
+
+private:
+    int64_t now;
+};
+
+#endif //CLOCK_H
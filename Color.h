@@ -0,0 +1,71 @@
+// Color.h: colours for the overlay's widgets, ready for the rasterizer.
+//
+// Everything the rasterizer draws is premultiplied BGRA from the start: flat
+// colours through PremultipliedColor, the crosshair through a coverage mask
+// recoloured once per colour (SpriteCache.h). What is left to convert is
+// rainbow mode's hue, which moves every frame, and frames written out as PNG,
+// which want straight alpha (the unpremultiply kernel in Raster.h).
+//
+// Hues come from a table of fully saturated, full-value colours built once
+// with HsvToPixel, so a hue change is one lookup. At six steps per 8-bit
+// channel value (1536, the default) a looked-up colour is at most one off per
+// channel from the one HsvToPixel computes for the same hue.
+
+#ifndef COLOR_H
+#define COLOR_H
+
+#include "Raster.h"
+#include <cmath>
+#include <vector>
+
+// Build option: entries in the hue table
+#ifndef ASTRAL_HUE_STEPS
+#define ASTRAL_HUE_STEPS 1536
+#endif
+
+// Opaque colour for hue h, saturation s and value v, all 0..1
+inline Pixel HsvToPixel(float h, float s, float v)
+{
+    float r, g, b;
+    int i = (int)(h * 6);
+    float f = h * 6 - i;
+    float p = v * (1 - s);
+    float q = v * (1 - f * s);
+    float t = v * (1 - (1 - f) * s);
+    switch (i % 6)
+    {
+    case 0: r = v, g = t, b = p; break;
+    case 1: r = q, g = v, b = p; break;
+    case 2: r = p, g = v, b = t; break;
+    case 3: r = p, g = q, b = v; break;
+    case 4: r = t, g = p, b = v; break;
+    default: r = v, g = p, b = q; break;
+    }
+    return PremultipliedColor((uint8_t)(r * 255), (uint8_t)(g * 255), (uint8_t)(b * 255));
+}
+
+class HueTable
+{
+public:
+    explicit HueTable(int steps = ASTRAL_HUE_STEPS)
+    {
+        colors.resize(steps < 6 ? 6 : steps);
+        for (size_t i = 0; i < colors.size(); i++)
+            colors[i] = HsvToPixel((float)i / colors.size(), 1.0f, 1.0f);
+    }
+
+    // Fully saturated colour for a hue in turns; whole turns wrap around
+    Pixel At(float hue) const
+    {
+        hue -= floorf(hue);
+        size_t i = (size_t)(hue * colors.size());
+        return colors[i < colors.size() ? i : colors.size() - 1];
+    }
+
+    int Steps() const { return (int)colors.size(); }
+
+private:
+    std::vector<Pixel> colors;
+};
+
+#endif //COLOR_H
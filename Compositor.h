@@ -0,0 +1,262 @@
+// Compositor.h: draws a recorded DrawList tile by tile on several threads.
+//
+// The target is cut into square tiles on a grid fixed to its top-left corner,
+// and every command is binned into the tiles its bounds overlap. A tile
+// replays its commands in recorded order, clipped to itself, so no two
+// threads ever write the same pixel and the result is exactly what drawing
+// the list directly gives. Tiles no command reaches are never visited; on an
+// overlay that is mostly transparent that is most of the screen.
+//
+// The tiles that have work are dealt out to the threads as contiguous runs,
+// so neighbouring tiles (which tend to share commands and sprite rows) stay
+// on one core. A thread works through its own run, then steals from the
+// others'. Owner and thief both claim a tile with a fetch_add on the run's
+// cursor, so nothing is locked while tiles are drawn. The thread that calls
+// Compose draws tiles too.
+
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include "Raster.h"
+#include "Clock.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct CompositorStats
+{
+    uint64_t frames = 0;
+    uint64_t tilesDrawn = 0;
+    uint64_t tilesSkipped = 0;   // no command reached them
+    uint64_t tilesStolen = 0;    // drawn by a thread other than the one they were dealt to
+    uint64_t commandsBinned = 0; // summed over tiles, so a command spanning four tiles counts four times
+};
+
+class TileCompositor
+{
+public:
+    static const int TILE_SIZE = 128;
+    static const int MAX_THREADS = 16;
+
+    // threads counts the calling thread, so 1 starts no helpers and draws every tile in Compose
+    TileCompositor(const Clock& clock, int threads) : clock(clock)
+    {
+        threadCount = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+        for (int i = 1; i < threadCount; i++)
+            helpers.emplace_back([this, i] { HelperLoop(i); });
+    }
+
+    ~TileCompositor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quitting = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : helpers)
+            t.join();
+    }
+
+    TileCompositor(const TileCompositor&) = delete;
+    TileCompositor& operator=(const TileCompositor&) = delete;
+
+    // Replays the list into target within its clip and returns once every tile is drawn
+    void Compose(const DrawList& list, Surface& target)
+    {
+        IntRect area = RectIntersect(target.clip, target.Bounds());
+        stats.frames++;
+        if (list.IsEmpty() || area.IsEmpty())
+            return;
+
+        Bin(list, area);
+        if (active.empty())
+            return;
+
+        frameList = &list;
+        frameTarget = target;
+        frameTarget.recorder = nullptr;
+        frameArea = area;
+        stolen.store(0, std::memory_order_relaxed);
+
+        // Deal the active tiles out in contiguous runs, one per thread
+        int workers = threadCount < (int)active.size() ? threadCount : (int)active.size();
+        int per = ((int)active.size() + workers - 1) / workers;
+        for (int i = 0; i < threadCount; i++)
+        {
+            int begin = i * per < (int)active.size() ? i * per : (int)active.size();
+            int end = begin + per < (int)active.size() ? begin + per : (int)active.size();
+            runs[i].next.store(begin, std::memory_order_relaxed);
+            runs[i].end = i < workers ? end : begin;
+        }
+
+        if (threadCount > 1)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busyHelpers = threadCount - 1;
+                generation++;
+            }
+            wake.notify_all();
+        }
+
+        DrawTiles(0);
+
+        if (threadCount > 1)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this] { return busyHelpers == 0; });
+        }
+
+        stats.tilesDrawn += active.size();
+        stats.tilesStolen += stolen.load(std::memory_order_relaxed);
+        frameList = nullptr;
+    }
+
+    int ThreadCount() const { return threadCount; }
+    std::thread& Helper(int i) { return helpers[i]; } // threadCount - 1 of them
+    const CompositorStats& Stats() const { return stats; }
+
+    // Time the helper threads spent drawing since the last call. The calling
+    // thread's share is part of its own time already.
+    int64_t TakeHelperWorkNs() { return helperWorkNs.exchange(0, std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Run
+    {
+        std::atomic<int> next{ 0 };
+        int end = 0;
+    };
+
+    // Counting sort of (tile, command) pairs: per-tile counts, offsets, then the
+    // command indices, each tile's in recorded order
+    void Bin(const DrawList& list, const IntRect& area)
+    {
+        firstCol = FloorDiv(area.left, TILE_SIZE);
+        firstRow = FloorDiv(area.top, TILE_SIZE);
+        cols = FloorDiv(area.right - 1, TILE_SIZE) - firstCol + 1;
+        rows = FloorDiv(area.bottom - 1, TILE_SIZE) - firstRow + 1;
+        int tileCount = cols * rows;
+
+        offsets.assign((size_t)tileCount + 1, 0);
+        for (size_t i = 0; i < list.Size(); i++)
+        {
+            int c0, r0, c1, r1;
+            if (!TileSpan(list[i].bounds, area, c0, r0, c1, r1)) continue;
+            for (int r = r0; r <= r1; r++)
+                for (int c = c0; c <= c1; c++)
+                    offsets[(size_t)r * cols + c + 1]++;
+        }
+        for (int t = 0; t < tileCount; t++)
+            offsets[t + 1] += offsets[t];
+
+        binned.resize(offsets[tileCount]);
+        fill.assign(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < list.Size(); i++)
+        {
+            int c0, r0, c1, r1;
+            if (!TileSpan(list[i].bounds, area, c0, r0, c1, r1)) continue;
+            for (int r = r0; r <= r1; r++)
+                for (int c = c0; c <= c1; c++)
+                    binned[fill[(size_t)r * cols + c]++] = (uint32_t)i;
+        }
+
+        active.clear();
+        for (int t = 0; t < tileCount; t++)
+            if (offsets[t + 1] > offsets[t])
+                active.push_back(t);
+        stats.tilesSkipped += tileCount - active.size();
+        stats.commandsBinned += binned.size();
+    }
+
+    // Columns and rows of the tiles (relative to the area's first) that bounds overlaps within area
+    bool TileSpan(const IntRect& bounds, const IntRect& area, int& c0, int& r0, int& c1, int& r1) const
+    {
+        IntRect r = RectIntersect(bounds, area);
+        if (r.IsEmpty()) return false;
+        c0 = FloorDiv(r.left, TILE_SIZE) - firstCol;
+        r0 = FloorDiv(r.top, TILE_SIZE) - firstRow;
+        c1 = FloorDiv(r.right - 1, TILE_SIZE) - firstCol;
+        r1 = FloorDiv(r.bottom - 1, TILE_SIZE) - firstRow;
+        return true;
+    }
+
+    static int FloorDiv(int a, int b)
+    {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    void DrawTile(int tile)
+    {
+        int col = firstCol + tile % cols, row = firstRow + tile / cols;
+        IntRect rect = RectIntersect(MakeRect(col * TILE_SIZE, row * TILE_SIZE, (col + 1) * TILE_SIZE, (row + 1) * TILE_SIZE), frameArea);
+        for (uint32_t i = offsets[tile]; i < offsets[tile + 1]; i++)
+            frameList->Replay(binned[i], frameTarget, rect);
+    }
+
+    // Own run first, then the others' in turn
+    void DrawTiles(int self)
+    {
+        for (int k = 0; k < threadCount; k++)
+        {
+            Run& run = runs[(self + k) % threadCount];
+            for (;;)
+            {
+                int i = run.next.fetch_add(1, std::memory_order_relaxed);
+                if (i >= run.end) break;
+                DrawTile(active[i]);
+                if (k) stolen.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void HelperLoop(int self)
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return quitting || generation != seen; });
+                if (quitting) return;
+                seen = generation;
+            }
+
+            int64_t start = clock.NowNs();
+            DrawTiles(self);
+            helperWorkNs.fetch_add(clock.NowNs() - start, std::memory_order_relaxed);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busyHelpers--;
+            }
+            done.notify_one();
+        }
+    }
+
+    const Clock& clock;
+    int threadCount = 1;
+    std::vector<std::thread> helpers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    uint64_t generation = 0;
+    int busyHelpers = 0;
+    bool quitting = false;
+
+    // This frame's bins: command indices for tile t are binned[offsets[t] .. offsets[t + 1])
+    int firstCol = 0, firstRow = 0, cols = 0, rows = 0;
+    std::vector<uint32_t> offsets, fill, binned;
+    std::vector<int> active; // tiles with at least one command, row by row
+
+    const DrawList* frameList = nullptr;
+    Surface frameTarget;
+    IntRect frameArea;
+    Run runs[MAX_THREADS];
+    std::atomic<uint64_t> stolen{ 0 };
+    std::atomic<int64_t> helperWorkNs{ 0 };
+    CompositorStats stats;
+};
+
+#endif //COMPOSITOR_H
@@ -0,0 +1,152 @@
+// CpuGovernor.h: keeps the overlay under a CPU budget.
+//
+// The overlay runs inside the game and competes with it for cores. Each of
+// its threads adds up the time it spends working (a GovernorWorkScope around
+// the work), and once a second the governor compares the total against the
+// budget, a share of one core. Over budget it drops a quality level; after a
+// few seconds well under budget it climbs back one. A level says how much to
+// slow the animations down, how wide a scope vignette to draw and how long to
+// hold frames apart; the render loop applies it.
+//
+// Working time is wall time between the start and end of the work, so time
+// the thread spent preempted counts against it too: the measure errs high,
+// which is the safe side for a budget.
+
+#ifndef CPU_GOVERNOR_H
+#define CPU_GOVERNOR_H
+
+#include "Clock.h"
+#include <atomic>
+#include <cstdint>
+
+struct QualityLevel
+{
+    const char* name;
+    double animationRateScale; // multiplies the rate of every animation
+    float vignetteScale;       // multiplies the scope vignette width
+    int64_t frameHoldNs;       // least time between two animation frames
+};
+
+const QualityLevel QUALITY_LEVELS[] =
+{
+    { "full",    1.0,  1.0f,  0 },
+    { "reduced", 0.5,  1.0f,  0 },
+    { "low",     0.5,  0.5f,  50 * NS_PER_MS },
+    { "minimal", 0.25, 0.25f, 100 * NS_PER_MS },
+};
+
+const int QUALITY_LEVEL_COUNT = sizeof(QUALITY_LEVELS) / sizeof(QUALITY_LEVELS[0]);
+
+// What the info panel shows
+struct CpuBudgetStatus
+{
+    double usage = 0.0;  // share of one core over the last window
+    double budget = 0.0; // 0 when the governor is off
+    int level = 0;
+    const char* levelName = QUALITY_LEVELS[0].name;
+
+    bool OverBudget() const { return budget > 0.0 && usage > budget; }
+};
+
+class CpuGovernor
+{
+public:
+    static const int64_t WINDOW_NS = NS_PER_SEC;
+    static const int RAISE_AFTER = 3; // windows under half the budget before climbing a level
+
+    // budget is a share of one core, 0.005 for half a percent; 0 turns the governor off
+    CpuGovernor(const Clock& clock, double budget) : clock(clock), budget(budget)
+    {
+        windowStartNs = clock.NowNs();
+    }
+
+    void SetBudget(double shareOfCore)
+    {
+        budget = shareOfCore;
+        if (budget <= 0.0) level = 0;
+    }
+
+    // Any thread
+    void AddWork(int64_t ns) { workNs.fetch_add(ns, std::memory_order_relaxed); }
+
+    // Overlay thread, once per loop. Closes the window once it has run its
+    // length and picks the level for the next one. Returns true if the level changed.
+    bool Update()
+    {
+        int64_t now = clock.NowNs();
+        int64_t elapsed = now - windowStartNs;
+        if (elapsed < WINDOW_NS) return false;
+
+        usage = (double)workNs.exchange(0, std::memory_order_relaxed) / elapsed;
+        windowStartNs = now;
+        if (budget <= 0.0) return false;
+
+        int previous = level;
+        if (usage > budget)
+        {
+            if (level < QUALITY_LEVEL_COUNT - 1) level++;
+            calmWindows = 0;
+        }
+        else if (usage < budget * 0.5)
+        {
+            if (level > 0 && ++calmWindows >= RAISE_AFTER)
+            {
+                level--;
+                calmWindows = 0;
+            }
+        }
+        else
+        {
+            calmWindows = 0;
+        }
+        return level != previous;
+    }
+
+    // Moves to a level directly, as a replay does with the levels its trace recorded
+    void SetLevel(int newLevel)
+    {
+        level = newLevel < 0 ? 0 : newLevel >= QUALITY_LEVEL_COUNT ? QUALITY_LEVEL_COUNT - 1 : newLevel;
+        calmWindows = 0;
+    }
+
+    int Level() const { return level; }
+    const QualityLevel& Quality() const { return QUALITY_LEVELS[level]; }
+
+    CpuBudgetStatus Status() const
+    {
+        CpuBudgetStatus status;
+        status.usage = usage;
+        status.budget = budget > 0.0 ? budget : 0.0;
+        status.level = level;
+        status.levelName = QUALITY_LEVELS[level].name;
+        return status;
+    }
+
+private:
+    const Clock& clock;
+    double budget;
+    std::atomic<int64_t> workNs{ 0 };
+    int64_t windowStartNs = 0;
+    double usage = 0.0;
+    int level = 0;
+    int calmWindows = 0;
+};
+
+// Counts the time between construction and destruction as work
+class GovernorWorkScope
+{
+public:
+    GovernorWorkScope(CpuGovernor& governor, const Clock& clock)
+        : governor(governor), clock(clock), startNs(clock.NowNs()) {}
+    ~GovernorWorkScope() { governor.AddWork(clock.NowNs() - startNs); }
+
+    GovernorWorkScope(const GovernorWorkScope&) = delete;
+    GovernorWorkScope& operator=(const GovernorWorkScope&) = delete;
+
+private:
+    CpuGovernor& governor;
+    const Clock& clock;
+    int64_t startNs;
+};
+
+#endif //CPU_GOVERNOR_H
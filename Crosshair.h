@@ -0,0 +1,479 @@
+// Crosshair.h: crosshair shapes as precomputed row spans.
+//
+// Each shape is a CrosshairShapeTraits specialization that gives the
+// anti-aliased coverage of one pixel. That coverage is turned into runs: solid
+// runs go through the fill kernel and edge runs through the coverage-mask
+// kernel, so drawing a crosshair is a short list of span calls with no shape
+// logic left in it. Runs for the common sizes and gaps are generated at
+// compile time; anything else is built on the fly from the same coverage
+// functions, so both paths produce the same pixels.
+//
+// Adding a shape: add it to CrosshairShape before SHAPE_COUNT and write its
+// CrosshairShapeTraits specialization.
+
+#ifndef CROSSHAIR_H
+#define CROSSHAIR_H
+
+#include "Raster.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+enum CrosshairShape { SHAPE_PLUS, SHAPE_CIRCLE, SHAPE_DOT, SHAPE_CROSS, SHAPE_COUNT };
+
+// --- Constant-evaluable math for the coverage functions ---
+
+constexpr float ConstAbs(float v)
+{
+    return v < 0.0f ? -v : v;
+}
+
+constexpr float ConstClamp01(float v)
+{
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+// Newton's method from the power of two above; stops once it no longer decreases
+constexpr float ConstSqrt(float v)
+{
+    if (v <= 0.0f) return 0.0f;
+    double x = 1.0;
+    while (x * x < v) x *= 2.0;
+    for (int i = 0; i < 64; i++)
+    {
+        double next = 0.5 * (x + v / x);
+        if (next >= x) break;
+        x = next;
+    }
+    return (float)x;
+}
+
+// Coverage of (px, py) by a segment of half-width hw with flat, half-pixel-extended
+// ends, as DrawLine computes it. len must be the segment's length.
+constexpr float SegmentCoverage(float px, float py, float x0, float y0, float x1, float y1, float len, float hw)
+{
+    if (len < 1e-4f) return 0.0f;
+    float ux = (x1 - x0) / len, uy = (y1 - y0) / len;
+    float ox = px - x0, oy = py - y0;
+    float across = ConstAbs(ox * -uy + oy * ux);
+    if (across >= hw + 0.5f) return 0.0f;
+    float along = ox * ux + oy * uy;
+    float ends = along < len - along ? along : len - along;
+    return ConstClamp01(hw + 0.5f - across) * ConstClamp01(ends + 0.5f);
+}
+
+// Coverage of a ring between ri and ro, ri <= 0 for a disc, as DrawRing computes it
+constexpr float RingCoverage(float px, float py, float ri, float ro)
+{
+    if (ro <= 0.0f || ro <= ri) return 0.0f;
+    float d2 = px * px + py * py;
+    if (d2 >= (ro + 0.5f) * (ro + 0.5f)) return 0.0f;
+    if (ri > 0.5f && d2 <= (ri - 0.5f) * (ri - 0.5f)) return 0.0f;
+    float d = ConstSqrt(d2);
+    float c = ConstClamp01(ro - d + 0.5f);
+    if (ri > 0.0f) c -= ConstClamp01(ri - d + 0.5f);
+    return c < 0.0f ? 0.0f : c;
+}
+
+// --- Shapes ---
+// Coverage(dx, dy, size, gap): the pixel dx, dy away from the centre pixel,
+// whose top-left corner is the crosshair's centre point. Nothing may reach
+// further than CrosshairReach(size) pixels.
+
+template <CrosshairShape Shape>
+struct CrosshairShapeTraits;
+
+constexpr int CrosshairReach(int size)
+{
+    return size + 2; // 2px pen past the arm ends
+}
+
+template <>
+struct CrosshairShapeTraits<SHAPE_PLUS>
+{
+    static constexpr const char* name = "Plus";
+    static constexpr bool usesGap = true;
+
+    // Four 2px arms on whole pixels
+    static constexpr float Coverage(int dx, int dy, int size, int gap)
+    {
+        bool alongX = (dx >= -size && dx < -gap) || (dx >= gap && dx < size);
+        bool alongY = (dy >= -size && dy < -gap) || (dy >= gap && dy < size);
+        bool onRow = dy == -1 || dy == 0;
+        bool onColumn = dx == -1 || dx == 0;
+        return (alongX && onRow) || (alongY && onColumn) ? 1.0f : 0.0f;
+    }
+};
+
+template <>
+struct CrosshairShapeTraits<SHAPE_CIRCLE>
+{
+    static constexpr const char* name = "Circle";
+    static constexpr bool usesGap = false;
+
+    static constexpr float Coverage(int dx, int dy, int size, int)
+    {
+        return RingCoverage(dx + 0.5f, dy + 0.5f, size - 2.0f, (float)size);
+    }
+};
+
+template <>
+struct CrosshairShapeTraits<SHAPE_DOT>
+{
+    static constexpr const char* name = "Dot";
+    static constexpr bool usesGap = false;
+
+    static constexpr float Coverage(int dx, int dy, int size, int)
+    {
+        return RingCoverage(dx + 0.5f, dy + 0.5f, 0.0f, (float)(size / 4));
+    }
+};
+
+template <>
+struct CrosshairShapeTraits<SHAPE_CROSS>
+{
+    static constexpr const char* name = "Cross";
+    static constexpr bool usesGap = true;
+
+    // Four 2px diagonal arms
+    static constexpr float Coverage(int dx, int dy, int size, int gap)
+    {
+        float px = dx + 0.5f, py = dy + 0.5f;
+        if (ConstAbs(ConstAbs(px) - ConstAbs(py)) > 2.5f) return 0.0f; // off both diagonals
+        float s = (float)size, g = (float)gap;
+        float len = ConstSqrt(2.0f * (s - g) * (s - g));
+        float c = SegmentCoverage(px, py, -s, -s, -g, -g, len, 1.0f);
+        float c2 = SegmentCoverage(px, py, g, g, s, s, len, 1.0f);
+        float c3 = SegmentCoverage(px, py, -s, s, -g, g, len, 1.0f);
+        float c4 = SegmentCoverage(px, py, g, -g, s, -s, len, 1.0f);
+        if (c2 > c) c = c2;
+        if (c3 > c) c = c3;
+        if (c4 > c) c = c4;
+        return c;
+    }
+};
+
+// --- Runs ---
+
+// coverage is an offset into the table's coverage bytes, or -1 for a fully covered run
+struct CrosshairRun
+{
+    int16_t dy = 0, dx = 0, length = 0;
+    int16_t coverage = -1;
+};
+
+template <CrosshairShape Shape>
+constexpr uint8_t CrosshairCoverage8(int dx, int dy, int size, int gap)
+{
+    return (uint8_t)(CrosshairShapeTraits<Shape>::Coverage(dx, dy, size, gap) * 255.0f + 0.5f);
+}
+
+// Scans one row of the crosshair's box into runs of fully and partly covered pixels
+template <CrosshairShape Shape, class Table>
+constexpr void BuildCrosshairRow(Table& table, int dy, int size, int gap)
+{
+    int reach = CrosshairReach(size);
+    int dx = -reach;
+    uint8_t c = CrosshairCoverage8<Shape>(dx, dy, size, gap);
+    while (dx <= reach)
+    {
+        if (!c)
+        {
+            dx++;
+            if (dx <= reach) c = CrosshairCoverage8<Shape>(dx, dy, size, gap);
+            continue;
+        }
+
+        bool solid = c == 255;
+        int start = dx;
+        int offset = table.CoverageCount();
+        while (dx <= reach && c && (c == 255) == solid)
+        {
+            if (!solid) table.AddCoverage(c);
+            dx++;
+            if (dx <= reach) c = CrosshairCoverage8<Shape>(dx, dy, size, gap);
+        }
+        table.AddRun(dy, start, dx - start, solid ? -1 : offset);
+    }
+}
+
+struct CrosshairRunView
+{
+    const CrosshairRun* runs = nullptr;
+    int runCount = 0;
+    const uint8_t* coverage = nullptr;
+};
+
+// Runs built at draw time for sizes and gaps without a table
+struct DynamicCrosshairRuns
+{
+    std::vector<CrosshairRun> runs;
+    std::vector<uint8_t> coverage;
+    int size = -1, gap = -1; // what the runs were built for
+
+    template <CrosshairShape Shape>
+    void Build(int buildSize, int buildGap)
+    {
+        runs.clear();
+        coverage.clear();
+        int reach = CrosshairReach(buildSize);
+        for (int dy = -reach; dy <= reach; dy++)
+            BuildCrosshairRow<Shape>(*this, dy, buildSize, buildGap);
+        size = buildSize;
+        gap = buildGap;
+    }
+
+    int CoverageCount() const { return (int)coverage.size(); }
+    void AddCoverage(uint8_t c) { coverage.push_back(c); }
+    void AddRun(int dy, int dx, int length, int offset)
+    {
+        CrosshairRun r;
+        r.dy = (int16_t)dy;
+        r.dx = (int16_t)dx;
+        r.length = (int16_t)length;
+        r.coverage = (int16_t)offset;
+        runs.push_back(r);
+    }
+
+    CrosshairRunView View() const
+    {
+        CrosshairRunView view;
+        view.runs = runs.data();
+        view.runCount = (int)runs.size();
+        view.coverage = coverage.data();
+        return view;
+    }
+};
+
+// One row of a compile-time table. Every row is a constant evaluation of its
+// own, which keeps each one far below the compilers' constexpr step limits.
+template <int Width>
+struct CrosshairRowTable
+{
+    static const int MAX_RUNS = 16; // up to four arms, each an edge, a solid middle and an edge
+
+    CrosshairRun runs[MAX_RUNS] = {};
+    uint8_t coverage[Width] = {};
+    int runCount = 0;
+    int coverageCount = 0;
+
+    constexpr int CoverageCount() const { return coverageCount; }
+    constexpr void AddCoverage(uint8_t c) { coverage[coverageCount++] = c; }
+    constexpr void AddRun(int dy, int dx, int length, int offset)
+    {
+        CrosshairRun& r = runs[runCount++];
+        r.dy = (int16_t)dy;
+        r.dx = (int16_t)dx;
+        r.length = (int16_t)length;
+        r.coverage = (int16_t)offset;
+    }
+};
+
+template <CrosshairShape Shape, class Table>
+constexpr Table MakeCrosshairRow(int dy, int size, int gap)
+{
+    Table table;
+    BuildCrosshairRow<Shape>(table, dy, size, gap);
+    return table;
+}
+
+template <CrosshairShape Shape, int Size, int Gap, int Row>
+struct CompiledCrosshairRow
+{
+    typedef CrosshairRowTable<2 * CrosshairReach(Size) + 1> Table;
+    static constexpr Table table = MakeCrosshairRow<Shape, Table>(Row - CrosshairReach(Size), Size, Gap);
+
+    static constexpr CrosshairRunView View() { return { table.runs, table.runCount, table.coverage }; }
+};
+
+template <CrosshairShape Shape, int Size, int Gap>
+struct CompiledCrosshair
+{
+    static const int ROW_COUNT = 2 * CrosshairReach(Size) + 1;
+
+    struct Rows
+    {
+        CrosshairRunView row[ROW_COUNT];
+    };
+
+    template <int... Row>
+    static constexpr Rows MakeRows(std::integer_sequence<int, Row...>)
+    {
+        return { { CompiledCrosshairRow<Shape, Size, Gap, Row>::View()... } };
+    }
+
+    static constexpr Rows rows = MakeRows(std::make_integer_sequence<int, ROW_COUNT>());
+};
+
+// Runs to draw: a list of rows, each a list of runs
+struct CrosshairRunList
+{
+    const CrosshairRunView* rows = nullptr;
+    int rowCount = 0;
+};
+
+// --- Compile-time tables: every shape at these sizes and gaps ---
+
+const int CROSSHAIR_TABLE_GAPS[] = { 0, 2, 5 };
+const int CROSSHAIR_TABLE_GAP_COUNT = 3;
+
+template <CrosshairShape Shape>
+struct CrosshairTables
+{
+    // Shapes that ignore the gap share the gap 0 table
+    static constexpr int G(int gap) { return CrosshairShapeTraits<Shape>::usesGap ? gap : 0; }
+
+    template <int Size, int Gap>
+    static CrosshairRunList List()
+    {
+        typedef CompiledCrosshair<Shape, Size, G(Gap)> Compiled;
+        return { Compiled::rows.row, Compiled::ROW_COUNT };
+    }
+
+    template <int Size>
+    static CrosshairRunList At(int gapIndex)
+    {
+        return gapIndex == 0 ? List<Size, 0>() : gapIndex == 1 ? List<Size, 2>() : List<Size, 5>();
+    }
+
+    // Table for (size, gap), or false if there is none
+    static bool Find(int size, int gap, CrosshairRunList& list)
+    {
+        if (!CrosshairShapeTraits<Shape>::usesGap) gap = 0;
+
+        int gapIndex = -1;
+        for (int i = 0; i < CROSSHAIR_TABLE_GAP_COUNT; i++)
+            if (CROSSHAIR_TABLE_GAPS[i] == gap) gapIndex = i;
+        if (gapIndex < 0) return false;
+
+        switch (size)
+        {
+        case 5: list = At<5>(gapIndex); return true;
+        case 10: list = At<10>(gapIndex); return true;
+        case 15: list = At<15>(gapIndex); return true;
+        case 20: list = At<20>(gapIndex); return true;
+        }
+        return false;
+    }
+};
+
+// --- Drawing ---
+
+// Every pixel a crosshair centred on (cx, cy) can touch
+inline IntRect CrosshairExtent(int cx, int cy, int size)
+{
+    int reach = CrosshairReach(size);
+    return MakeRect(cx - reach, cy - reach, cx + reach + 1, cy + reach + 1);
+}
+
+inline void DrawCrosshairRuns(Surface& s, int cx, int cy, Pixel color, const CrosshairRunList& list)
+{
+    const RasterKernels& k = ActiveRasterKernels();
+    for (int row = 0; row < list.rowCount; row++)
+    {
+        const CrosshairRunView& view = list.rows[row];
+        for (int i = 0; i < view.runCount; i++)
+        {
+            const CrosshairRun& r = view.runs[i];
+            int y = cy + r.dy;
+            if (y < s.clip.top || y >= s.clip.bottom) continue;
+
+            int x0 = cx + r.dx, x1 = x0 + r.length;
+            if (r.coverage < 0)
+            {
+                FillSpan(s, y, x0, x1, color);
+                continue;
+            }
+
+            int skip = s.clip.left > x0 ? s.clip.left - x0 : 0;
+            if (x1 > s.clip.right) x1 = s.clip.right;
+            if (x1 <= x0 + skip) continue;
+            k.blendMaskSpan(s.Row(y) + x0 + skip, view.coverage + r.coverage + skip, x1 - x0 - skip, color);
+        }
+    }
+}
+
+inline void DrawCrosshairRuns(Surface& s, int cx, int cy, Pixel color, const DynamicCrosshairRuns& runs)
+{
+    CrosshairRunView view = runs.View();
+    CrosshairRunList list;
+    list.rows = &view;
+    list.rowCount = 1;
+    DrawCrosshairRuns(s, cx, cy, color, list);
+}
+
+// Builds the runs for any size and gap, then draws them
+template <CrosshairShape Shape>
+void DrawCrosshairGenericShape(Surface& s, int cx, int cy, Pixel color, int size, int gap)
+{
+    if (s.recorder)
+    {
+        s.recorder->Record(s, CrosshairExtent(cx, cy, size), [=](Surface& t) { DrawCrosshairGenericShape<Shape>(t, cx, cy, color, size, gap); });
+        return;
+    }
+
+    static thread_local DynamicCrosshairRuns scratch;
+    scratch.Build<Shape>(size, gap);
+    DrawCrosshairRuns(s, cx, cy, color, scratch);
+}
+
+template <CrosshairShape Shape>
+void DrawCrosshairShape(Surface& s, int cx, int cy, Pixel color, int size, int gap)
+{
+    // Recorded as the shape, not its runs: a replaying thread finds or builds them itself
+    if (s.recorder)
+    {
+        s.recorder->Record(s, CrosshairExtent(cx, cy, size), [=](Surface& t) { DrawCrosshairShape<Shape>(t, cx, cy, color, size, gap); });
+        return;
+    }
+
+    CrosshairRunList list;
+    if (CrosshairTables<Shape>::Find(size, gap, list))
+    {
+        DrawCrosshairRuns(s, cx, cy, color, list);
+        return;
+    }
+
+    // Off the table grid: keep the last size and gap built, so a setting is only built once
+    static thread_local DynamicCrosshairRuns last;
+    if (last.size != size || last.gap != gap)
+        last.Build<Shape>(size, gap);
+    DrawCrosshairRuns(s, cx, cy, color, last);
+}
+
+// --- Per-shape entry points, indexed by CrosshairShape ---
+
+typedef void (*CrosshairRenderer)(Surface& s, int cx, int cy, Pixel color, int size, int gap);
+
+struct CrosshairShapeEntry
+{
+    const char* name;
+    CrosshairRenderer draw;         // compile-time table when there is one
+    CrosshairRenderer drawGeneric;  // always built at draw time
+};
+
+template <int... Shapes>
+const CrosshairShapeEntry* CrosshairShapeEntries(std::integer_sequence<int, Shapes...>)
+{
+    static const CrosshairShapeEntry entries[] =
+    {
+        { CrosshairShapeTraits<(CrosshairShape)Shapes>::name,
+          DrawCrosshairShape<(CrosshairShape)Shapes>,
+          DrawCrosshairGenericShape<(CrosshairShape)Shapes> }...
+    };
+    return entries;
+}
+
+inline const CrosshairShapeEntry& GetCrosshairShape(CrosshairShape shape)
+{
+    static const CrosshairShapeEntry* entries = CrosshairShapeEntries(std::make_integer_sequence<int, SHAPE_COUNT>());
+    if (shape < 0 || shape >= SHAPE_COUNT) shape = SHAPE_PLUS;
+    return entries[shape];
+}
+
+inline const char* CrosshairShapeName(CrosshairShape shape)
+{
+    return GetCrosshairShape(shape).name;
+}
+
+#endif //CROSSHAIR_H
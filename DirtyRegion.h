@@ -0,0 +1,180 @@
+// DirtyRegion.h: per-widget damage tracking for the overlay surface.
+//
+// Each frame every widget reports the rectangle it is about to draw and a key
+// describing what it will draw there. A widget whose rectangle and key are the
+// same as last frame contributes nothing. Otherwise both its old and new
+// rectangles are damaged: the old one has to be erased and the new one painted.
+// The damage is kept as a short list of rectangles so that widgets far apart
+// (crosshair in the middle, watermark in a corner) do not merge into one huge
+// clear, plus a bounding rectangle for the present call.
+
+#ifndef DIRTY_REGION_H
+#define DIRTY_REGION_H
+
+#include "Geometry.h"
+#include <cstdint>
+#include <cstring>
+
+// Small FNV-1a helper for building widget state keys
+inline uint64_t HashCombine(uint64_t h, uint64_t value)
+{
+    if (!h) h = 1469598103934665603ULL;
+    for (int i = 0; i < 8; i++)
+    {
+        h ^= (value >> (i * 8)) & 0xFF;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+class DirtyRegionTracker
+{
+public:
+    static const int MAX_WIDGETS = 16;
+    static const int MAX_DAMAGE_RECTS = 8;
+
+    // Sets the surface bounds and forces a full repaint on the next frame
+    void Reset(int surfaceWidth, int surfaceHeight)
+    {
+        surface = MakeRect(0, 0, surfaceWidth, surfaceHeight);
+        for (int i = 0; i < MAX_WIDGETS; i++)
+            widgets[i] = WidgetState();
+        fullDamage = true;
+        damageCount = 0;
+        damageBounds = IntRect();
+    }
+
+    // Starts a frame. Widgets that are not reported before Resolve() count as hidden.
+    void BeginFrame()
+    {
+        for (int i = 0; i < MAX_WIDGETS; i++)
+        {
+            widgets[i].current = IntRect();
+            widgets[i].currentKey = 0;
+        }
+    }
+
+    // Reports what a widget draws this frame. An empty rectangle means it is not drawn.
+    void Report(int widget, const IntRect& bounds, uint64_t stateKey)
+    {
+        if (widget < 0 || widget >= MAX_WIDGETS) return;
+        widgets[widget].current = RectIntersect(bounds, surface);
+        widgets[widget].currentKey = widgets[widget].current.IsEmpty() ? 0 : stateKey;
+    }
+
+    // Compares this frame against the last one and builds the damage list
+    void Resolve()
+    {
+        damageCount = 0;
+        damageBounds = IntRect();
+
+        if (fullDamage)
+        {
+            AddDamage(surface);
+            fullDamage = false;
+        }
+
+        for (int i = 0; i < MAX_WIDGETS; i++)
+        {
+            WidgetState& w = widgets[i];
+            if (w.current != w.previous || w.currentKey != w.previousKey)
+            {
+                AddDamage(w.previous);
+                AddDamage(w.current);
+            }
+            w.previous = w.current;
+            w.previousKey = w.currentKey;
+        }
+    }
+
+    const IntRect& SurfaceBounds() const { return surface; }
+    // Adds damage no widget reported, after Resolve(); e.g. pixels a back buffer missed
+    void Invalidate(const IntRect& r) { AddDamage(r); }
+
+    bool HasDamage() const { return damageCount > 0; }
+    int DamageCount() const { return damageCount; }
+    const IntRect& Damage(int i) const { return damage[i]; }
+    const IntRect& DamageBounds() const { return damageBounds; }
+
+    long long DamagedPixels() const
+    {
+        long long total = 0;
+        for (int i = 0; i < damageCount; i++)
+            total += damage[i].Area();
+        return total;
+    }
+
+private:
+    struct WidgetState
+    {
+        IntRect previous, current;
+        uint64_t previousKey = 0, currentKey = 0;
+    };
+
+    void AddDamage(IntRect r)
+    {
+        r = RectIntersect(r, surface);
+        if (r.IsEmpty()) return;
+
+        // Absorb any existing rectangle this one touches, repeating until stable
+        bool merged = true;
+        while (merged)
+        {
+            merged = false;
+            for (int i = 0; i < damageCount; i++)
+            {
+                if (RectsOverlap(RectInflate(damage[i], 1), r))
+                {
+                    r = RectUnion(r, damage[i]);
+                    damage[i] = damage[--damageCount];
+                    merged = true;
+                    break;
+                }
+            }
+        }
+
+        if (damageCount == MAX_DAMAGE_RECTS)
+        {
+            // Out of slots: fold the new rectangle into the one whose union grows the least
+            int best = 0;
+            long long bestGrowth = -1;
+            for (int i = 0; i < damageCount; i++)
+            {
+                long long growth = RectUnion(damage[i], r).Area() - damage[i].Area();
+                if (bestGrowth < 0 || growth < bestGrowth)
+                {
+                    bestGrowth = growth;
+                    best = i;
+                }
+            }
+            r = RectUnion(damage[best], r);
+            damage[best] = damage[--damageCount];
+            AddDamage(r);
+            return;
+        }
+
+        damage[damageCount++] = r;
+        damageBounds = RectUnion(damageBounds, r);
+    }
+
+    IntRect surface;
+    WidgetState widgets[MAX_WIDGETS];
+    IntRect damage[MAX_DAMAGE_RECTS];
+    int damageCount = 0;
+    IntRect damageBounds;
+    bool fullDamage = true;
+};
+
+// Zeroes every damaged rectangle of a 32bpp top-down surface
+inline void ClearDamage(void* pixels, int pitchBytes, const DirtyRegionTracker& tracker)
+{
+    for (int i = 0; i < tracker.DamageCount(); i++)
+    {
+        const IntRect& r = tracker.Damage(i);
+        uint8_t* row = (uint8_t*)pixels + (size_t)r.top * pitchBytes + (size_t)r.left * 4;
+        for (int y = r.top; y < r.bottom; y++, row += pitchBytes)
+            memset(row, 0, (size_t)r.Width() * 4);
+    }
+}
+
+#endif //DIRTY_REGION_H
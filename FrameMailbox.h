@@ -0,0 +1,84 @@
+// FrameMailbox.h: lock-free triple buffer between one render thread and one
+// present thread. The renderer always owns a back buffer and never waits; the
+// presenter always owns the front buffer it last presented. A third buffer
+// sits in the mailbox between them, and buffers change hands only by swapping
+// indices through one atomic. If the presenter falls behind, a newer frame
+// replaces the one waiting in the mailbox and the stale one is counted as
+// dropped, so the presenter only ever shows the newest frame.
+
+#ifndef FRAME_MAILBOX_H
+#define FRAME_MAILBOX_H
+
+#include <atomic>
+#include <cstdint>
+
+template <class T>
+class FrameMailbox
+{
+public:
+    static const int BUFFER_COUNT = 3;
+
+    // Every buffer, for setup and teardown while neither thread is running
+    T& Buffer(int i) { return buffers[i]; }
+
+    // Producer side
+
+    int BackIndex() const { return back; }
+    T& Back() { return buffers[back]; }
+
+    // Hands the back buffer to the presenter and takes a free one in its
+    // place. Returns false if that replaced a frame the presenter never took.
+    bool Submit()
+    {
+        int previous = mailbox.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = previous & INDEX_MASK;
+        submitted.fetch_add(1, std::memory_order_relaxed);
+        if (previous & FRESH)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // Consumer side
+
+    int FrontIndex() const { return front; }
+    T& Front() { return buffers[front]; }
+
+    // Swaps the newest submitted frame into the front buffer. Returns false,
+    // leaving the front buffer alone, if nothing was submitted since the last call.
+    bool Acquire()
+    {
+        if (!(mailbox.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        front = mailbox.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        acquired.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Either side; only a snapshot
+
+    // Frames submitted but not yet acquired: 0 or 1
+    int Pending() const { return (mailbox.load(std::memory_order_acquire) & FRESH) ? 1 : 0; }
+
+    uint64_t Submitted() const { return submitted.load(std::memory_order_relaxed); }
+    uint64_t Acquired() const { return acquired.load(std::memory_order_relaxed); }
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH = 4; // set while the mailbox holds a frame the presenter has not taken
+
+    T buffers[BUFFER_COUNT];
+
+    // Producer and consumer state live on separate cache lines
+    alignas(64) int back = 0;
+    alignas(64) std::atomic<int> mailbox{ 1 };
+    alignas(64) int front = 2;
+    alignas(64) std::atomic<uint64_t> submitted{ 0 };
+    std::atomic<uint64_t> acquired{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+};
+
+#endif //FRAME_MAILBOX_H
@@ -0,0 +1,255 @@
+// FramePacer.h: lines frames up with the compositor's refresh.
+//
+// DWM picks up a layered window's new contents once per refresh. A frame
+// presented just after a refresh waits almost a whole interval to be seen, and
+// one presented just before is seen at once. Frames started whenever they come
+// due therefore reach the screen up to a refresh apart from where their
+// animation time says they should. Compositor pacing holds a due frame back to
+// just before the refresh that would show it anyway. That is late enough to
+// draw the newest input and animation time, and early enough to make that
+// refresh. The margin comes from how long recent frames took from their start
+// to their present. Immediate pacing starts frames when they come due, as the
+// loop always has.
+//
+// For every frame it lets go, the pacer records two times. One is from the
+// earliest key down the frame shows to the refresh that shows it. The other is
+// from the frame's start, which is its animation time, to that refresh. The
+// spread of the second is the jitter a viewer sees. Both are kept per pacing
+// mode, so switching modes compares them on the same session.
+//
+// Refresh timing comes from a RefreshSource, DwmGetCompositionTimingInfo in the
+// DLL, and time from a Clock. bench/FramePacingSim.cpp runs the same code
+// against a simulated display.
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include "Clock.h"
+#include "FrameScheduler.h"
+#include "FrameProfiler.h"
+#include <atomic>
+#include <cstdint>
+
+enum PacingMode { PACING_IMMEDIATE, PACING_COMPOSITOR, PACING_MODE_COUNT };
+const char* const PACING_MODE_NAMES[PACING_MODE_COUNT] = { "immediate", "compositor" };
+
+// One refresh of the display and the time between refreshes, in the pacer's clock
+struct RefreshTiming
+{
+    int64_t vblankNs = 0;
+    int64_t periodNs = 0;
+};
+
+class RefreshSource
+{
+public:
+    virtual ~RefreshSource() {}
+
+    // False when there is no compositor to pace against
+    virtual bool Sample(RefreshTiming& timing) = 0;
+};
+
+// A display that refreshes at a fixed rate, the first time at phaseNs
+class FixedRefreshSource : public RefreshSource
+{
+public:
+    explicit FixedRefreshSource(double rateHz, int64_t phaseNs = 0) : periodNs((int64_t)(NS_PER_SEC / rateHz)), phaseNs(phaseNs) {}
+
+    bool Sample(RefreshTiming& timing) override
+    {
+        timing.vblankNs = phaseNs;
+        timing.periodNs = periodNs;
+        return true;
+    }
+
+    // The first refresh at or after ns
+    int64_t NextRefreshNs(int64_t ns) const
+    {
+        int64_t intervals = (ns - phaseNs + periodNs - 1) / periodNs;
+        return phaseNs + (intervals > 0 ? intervals : 0) * periodNs;
+    }
+
+private:
+    int64_t periodNs;
+    int64_t phaseNs;
+};
+
+// What the pacer knows of a frame it let go; the host hands it to the present thread with the frame
+struct PacedFrame
+{
+    uint64_t id = 0;        // 0 for no frame
+    PacingMode mode = PACING_IMMEDIATE;
+    int64_t startNs = 0;
+    int64_t inputNs = 0;    // earliest key down the frame shows, 0 for none
+    int64_t targetNs = 0;   // the refresh compositor pacing aimed it at, 0 for none
+};
+
+class FramePacer
+{
+public:
+    static const int64_t RESAMPLE_NS = 500 * NS_PER_MS; // refresh timing is read again this often
+    static const int64_t SLACK_NS = NS_PER_MS;          // added to the margin for a late wake
+    static const int64_t DECAY = 128;                   // the margin falls by 1/DECAY a frame after a slow one
+
+    FramePacer(const Clock& clock, RefreshSource& refresh) : clock(clock), refresh(refresh) {}
+
+    void SetMode(PacingMode m)
+    {
+        mode = m;
+        targetNs = 0;
+    }
+
+    PacingMode Mode() const { return mode; }
+
+    // --- Overlay thread ---
+
+    // A key went down at timeNs; the next frame to show input shows it
+    void KeyDown(int64_t timeNs)
+    {
+        if (!pendingInputNs || timeNs < pendingInputNs)
+            pendingInputNs = timeNs;
+    }
+
+    // When to start the frame due at dueNs. Compositor pacing starts it the
+    // margin before the first refresh it can make; immediate pacing, or no
+    // compositor to pace against, at dueNs.
+    int64_t StartNs(int64_t dueNs)
+    {
+        if (mode != PACING_COMPOSITOR || dueNs == NO_DEADLINE || !Resample())
+            return dueNs;
+
+        // Frames that take a whole refresh can't be lined up with one
+        int64_t margin = MarginNs();
+        if (margin >= periodNs.load(std::memory_order_relaxed))
+        {
+            targetNs = 0;
+            return dueNs;
+        }
+        int64_t target = NextRefreshNs(dueNs + margin);
+
+        // A frame already aimed at a refresh keeps its aim until that refresh
+        // passes. A requested frame is due at every now, and aiming it again
+        // after waking for it would push it back forever.
+        if (targetNs > clock.NowNs() && targetNs <= target)
+            target = targetNs;
+        targetNs = target;
+        return target - margin;
+    }
+
+    // True while compositor pacing holds back the frame due at dueNs
+    bool Hold(int64_t dueNs)
+    {
+        return mode == PACING_COMPOSITOR && dueNs != NO_DEADLINE && StartNs(dueNs) > clock.NowNs();
+    }
+
+    // After every iteration that was not held, with what the overlay's
+    // BeginFrame fired. Input an iteration did nothing to show is dropped.
+    PacedFrame FrameBegun(uint32_t fired)
+    {
+        PacedFrame f;
+        if (fired)
+        {
+            f.id = ++frames;
+            f.mode = mode;
+            f.startNs = clock.NowNs();
+            f.inputNs = fired & FrameScheduler::FRAME_REQUESTED ? pendingInputNs : 0;
+            f.targetNs = mode == PACING_COMPOSITOR ? targetNs : 0;
+        }
+        pendingInputNs = 0;
+        targetNs = 0;
+        return f;
+    }
+
+    // --- Present thread ---
+
+    // The last window of a frame was presented at presentNs
+    void Presented(const PacedFrame& f, int64_t presentNs)
+    {
+        if (!f.id || f.id <= lastPresented) return;
+        lastPresented = f.id;
+
+        int64_t shownNs = NextRefreshNs(presentNs);
+        if (f.inputNs)
+            inputLatency[f.mode].Record((uint64_t)(shownNs - f.inputNs));
+        frameLag[f.mode].Record((uint64_t)(shownNs - f.startNs));
+        if (f.targetNs && shownNs > f.targetNs)
+            missed[f.mode].fetch_add(1, std::memory_order_relaxed);
+
+        // The margin follows the slowest recent frame up at once and back down slowly
+        int64_t cost = presentNs - f.startNs;
+        int64_t peak = costNs.load(std::memory_order_relaxed);
+        peak = cost > peak ? cost : peak - peak / DECAY;
+        costNs.store(peak, std::memory_order_relaxed);
+    }
+
+    // --- Either thread ---
+
+    // The refresh that picks up what is presented at ns; ns itself when there is no compositor
+    int64_t NextRefreshNs(int64_t ns) const
+    {
+        int64_t period = periodNs.load(std::memory_order_relaxed);
+        if (!period) return ns;
+        int64_t sinceVblank = (ns - vblankNs.load(std::memory_order_relaxed)) % period;
+        if (sinceVblank < 0) sinceVblank += period;
+        return sinceVblank ? ns - sinceVblank + period : ns;
+    }
+
+    // Start-to-present time of recent frames plus slack, at most a refresh
+    int64_t MarginNs() const
+    {
+        int64_t margin = costNs.load(std::memory_order_relaxed) + SLACK_NS;
+        int64_t period = periodNs.load(std::memory_order_relaxed);
+        return period && margin > period ? period : margin;
+    }
+
+    int64_t RefreshPeriodNs() const { return periodNs.load(std::memory_order_relaxed); }
+    const LatencyHistogram& InputLatency(PacingMode m) const { return inputLatency[m]; }
+    const LatencyHistogram& FrameLag(PacingMode m) const { return frameLag[m]; }
+    uint64_t Missed(PacingMode m) const { return missed[m].load(std::memory_order_relaxed); }
+
+private:
+    // Reads the refresh timing again once it is old. Only the phase is kept, so
+    // the present thread reading it half updated is off by no more than a change
+    // of refresh rate.
+    bool Resample()
+    {
+        int64_t now = clock.NowNs();
+        if (!sampledNs || now - sampledNs >= RESAMPLE_NS)
+        {
+            sampledNs = now;
+            RefreshTiming t;
+            if (refresh.Sample(t) && t.periodNs > 0)
+            {
+                int64_t phase = t.vblankNs % t.periodNs;
+                vblankNs.store(phase < 0 ? phase + t.periodNs : phase, std::memory_order_relaxed);
+                periodNs.store(t.periodNs, std::memory_order_relaxed);
+            }
+            else
+                periodNs.store(0, std::memory_order_relaxed);
+        }
+        return periodNs.load(std::memory_order_relaxed) != 0;
+    }
+
+    const Clock& clock;
+    RefreshSource& refresh;
+    PacingMode mode = PACING_IMMEDIATE;
+
+    // Overlay thread
+    int64_t sampledNs = 0;
+    int64_t targetNs = 0;       // refresh the pending frame is aimed at
+    int64_t pendingInputNs = 0;
+    uint64_t frames = 0;
+
+    // Written by the overlay thread, read by both
+    std::atomic<int64_t> vblankNs{ 0 };
+    std::atomic<int64_t> periodNs{ 0 };
+
+    // Present thread
+    uint64_t lastPresented = 0;
+    std::atomic<int64_t> costNs{ 0 };
+    LatencyHistogram inputLatency[PACING_MODE_COUNT];
+    LatencyHistogram frameLag[PACING_MODE_COUNT];
+    std::atomic<uint64_t> missed[PACING_MODE_COUNT] = {};
+};
+
+#endif //FRAME_PACER_H
@@ -0,0 +1,254 @@
+// FrameProfiler.h: low-overhead per-stage timing for the overlay loop.
+//
+// PROFILE_ZONE(profiler, stage) times the rest of the enclosing scope. Time
+// spent in a stage is summed over the frame (a widget may be drawn once per
+// damaged rectangle) and folded into that stage's histogram at EndFrame().
+// Histograms use log-linear buckets (8 per power of two, so about 12% error)
+// held in atomics: one thread writes, any thread may read percentiles.
+// Every zone is also appended to a ring of trace events that can be written
+// out in Chrome's trace format (chrome://tracing, Perfetto).
+//
+// Build with ASTRAL_PROFILING=0 and PROFILE_ZONE expands to nothing.
+
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include "Clock.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+#ifndef ASTRAL_PROFILING
+#define ASTRAL_PROFILING 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+inline int HighestBit(uint64_t v)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return (int)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanReverse(&index, (unsigned long)(v >> 32))) return (int)index + 32;
+    _BitScanReverse(&index, (unsigned long)v);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+class LatencyHistogram
+{
+public:
+    static const int SUB_BITS = 3;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = 40 * SUB_BUCKETS; // up to 2^41 ns, about half an hour
+
+    // Writer side (single thread)
+    void Record(uint64_t ns)
+    {
+        std::atomic<uint32_t>& b = buckets[BucketIndex(ns)];
+        b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum.store(sum.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > max.load(std::memory_order_relaxed))
+            max.store(ns, std::memory_order_relaxed);
+    }
+
+    void Reset()
+    {
+        for (int i = 0; i < BUCKETS; i++)
+            buckets[i].store(0, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+    // Reader side. Percentiles return the midpoint of the bucket holding that rank.
+    uint64_t Percentile(double p) const
+    {
+        uint64_t total = count.load(std::memory_order_relaxed);
+        if (!total) return 0;
+        uint64_t rank = (uint64_t)(p * (total - 1) / 100.0) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++)
+        {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+            {
+                uint64_t mid = (BucketLow(i) + BucketHigh(i)) / 2;
+                uint64_t m = Max();
+                return mid < m ? mid : m;
+            }
+        }
+        return Max();
+    }
+
+    uint64_t Count() const { return count.load(std::memory_order_relaxed); }
+    uint64_t Max() const { return max.load(std::memory_order_relaxed); }
+    uint64_t Mean() const
+    {
+        uint64_t n = Count();
+        return n ? sum.load(std::memory_order_relaxed) / n : 0;
+    }
+
+    static int BucketIndex(uint64_t ns)
+    {
+        if (ns < SUB_BUCKETS) return (int)ns;
+        int msb = HighestBit(ns);
+        int index = (msb - SUB_BITS + 1) * SUB_BUCKETS + (int)((ns >> (msb - SUB_BITS)) & (SUB_BUCKETS - 1));
+        return index < BUCKETS ? index : BUCKETS - 1;
+    }
+
+    static uint64_t BucketLow(int index)
+    {
+        if (index < SUB_BUCKETS) return index;
+        int shift = index / SUB_BUCKETS - 1;
+        return (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    }
+
+    static uint64_t BucketHigh(int index)
+    {
+        if (index < SUB_BUCKETS) return index;
+        return BucketLow(index) + ((uint64_t)1 << (index / SUB_BUCKETS - 1)) - 1;
+    }
+
+private:
+    std::atomic<uint32_t> buckets[BUCKETS] = {};
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> sum{ 0 };
+    std::atomic<uint64_t> max{ 0 };
+};
+
+class FrameProfiler
+{
+public:
+    static const int MAX_STAGES = 24;
+    static const int TRACE_CAPACITY = 16384;
+
+    explicit FrameProfiler(const Clock& clock) : clock(clock) {}
+
+    int AddStage(const char* name)
+    {
+        if (stageCount == MAX_STAGES) return -1;
+        stageNames[stageCount] = name;
+        return stageCount++;
+    }
+
+    int64_t Now() const { return clock.NowNs(); }
+
+    void BeginFrame()
+    {
+        for (int i = 0; i < stageCount; i++)
+        {
+            frameTotals[i] = 0;
+            frameTouched[i] = false;
+        }
+    }
+
+    void Record(int stage, int64_t startNs, int64_t endNs)
+    {
+        if (stage < 0 || stage >= stageCount) return;
+        frameTotals[stage] += endNs - startNs;
+        frameTouched[stage] = true;
+
+        TraceEvent& e = trace[traceNext % TRACE_CAPACITY];
+        e.stage = stage;
+        e.startNs = startNs;
+        e.durationNs = endNs - startNs;
+        traceNext++;
+    }
+
+    // Folds this frame's per-stage totals into the histograms
+    void EndFrame()
+    {
+        for (int i = 0; i < stageCount; i++)
+            if (frameTouched[i])
+                histograms[i].Record((uint64_t)frameTotals[i]);
+    }
+
+    const LatencyHistogram& Histogram(int stage) const { return histograms[stage]; }
+    int64_t FrameTotal(int stage) const { return frameTotals[stage]; } // this frame's so far
+    const char* StageName(int stage) const { return stageNames[stage]; }
+    int StageCount() const { return stageCount; }
+
+    void Reset()
+    {
+        for (int i = 0; i < stageCount; i++)
+            histograms[i].Reset();
+        traceNext = 0;
+    }
+
+    // Writes the buffered zones as Chrome trace JSON. Returns false if the file can't be opened.
+    bool WriteChromeTrace(const char* path) const
+    {
+        FILE* f = nullptr;
+#if defined(_MSC_VER)
+        if (fopen_s(&f, path, "w") != 0) f = nullptr;
+#else
+        f = fopen(path, "w");
+#endif
+        if (!f) return false;
+
+        fprintf(f, "{\"traceEvents\":[\n");
+        uint64_t first = traceNext > TRACE_CAPACITY ? traceNext - TRACE_CAPACITY : 0;
+        for (uint64_t i = first; i < traceNext; i++)
+        {
+            const TraceEvent& e = trace[i % TRACE_CAPACITY];
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}\n",
+                    i == first ? "" : ",", stageNames[e.stage], e.startNs / 1000.0, e.durationNs / 1000.0);
+        }
+        fprintf(f, "]}\n");
+        fclose(f);
+        return true;
+    }
+
+private:
+    struct TraceEvent
+    {
+        int stage;
+        int64_t startNs;
+        int64_t durationNs;
+    };
+
+    const Clock& clock;
+    const char* stageNames[MAX_STAGES] = {};
+    int stageCount = 0;
+    int64_t frameTotals[MAX_STAGES] = {};
+    bool frameTouched[MAX_STAGES] = {};
+    LatencyHistogram histograms[MAX_STAGES];
+    TraceEvent trace[TRACE_CAPACITY];
+    uint64_t traceNext = 0;
+};
+
+class ScopedZone
+{
+public:
+    ScopedZone(FrameProfiler& profiler, int stage) : profiler(profiler), stage(stage), start(profiler.Now()) {}
+    ~ScopedZone() { profiler.Record(stage, start, profiler.Now()); }
+
+private:
+    FrameProfiler& profiler;
+    int stage;
+    int64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if ASTRAL_PROFILING
+#define PROFILE_ZONE(profiler, stage) ScopedZone PROFILE_CONCAT(profileZone, __LINE__)(profiler, stage)
+#define PROFILE_BEGIN_FRAME(profiler) (profiler).BeginFrame()
+#define PROFILE_END_FRAME(profiler) (profiler).EndFrame()
+#else
+#define PROFILE_ZONE(profiler, stage) ((void)0)
+#define PROFILE_BEGIN_FRAME(profiler) ((void)0)
+#define PROFILE_END_FRAME(profiler) ((void)0)
+#endif
+
+#endif //FRAME_PROFILER_H
@@ -0,0 +1,137 @@
+// FrameScheduler.h: decides when the overlay needs to render.
+//
+// Animated things (kill effect, watermark sway, rainbow hue, FPS readout)
+// register as sources with their own update rate and are switched on and off
+// as they become visible. One-off events such as input or a window message
+// request a single frame. The render loop sleeps until NextDeadline() and
+// renders only when BeginFrame() says something is due, so with nothing
+// animating it does not render at all. A frame hold keeps animation frames
+// at least that far apart; requested frames are never held.
+
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include "Clock.h"
+#include <cstdint>
+
+const int64_t NO_DEADLINE = INT64_MAX;
+
+class FrameScheduler
+{
+public:
+    static const int MAX_SOURCES = 16;
+
+    // BeginFrame() bit for frames asked for through RequestFrame()
+    static const uint32_t FRAME_REQUESTED = 1u << 31;
+
+    explicit FrameScheduler(const Clock& clock) : clock(clock) {}
+
+    // Registers an inactive source that wants rateHz frames per second while active
+    int AddSource(const char* name, double rateHz)
+    {
+        if (sourceCount == MAX_SOURCES) return -1;
+        Source& s = sources[sourceCount];
+        s.name = name;
+        s.periodNs = RateToPeriod(rateHz);
+        return sourceCount++;
+    }
+
+    void SetRate(int source, double rateHz)
+    {
+        if (source < 0 || source >= sourceCount) return;
+        sources[source].periodNs = RateToPeriod(rateHz);
+    }
+
+    // Activating a source schedules its first frame firstDelayNs from now
+    void SetActive(int source, bool active, int64_t firstDelayNs = 0)
+    {
+        if (source < 0 || source >= sourceCount) return;
+        Source& s = sources[source];
+        if (active && !s.active)
+            s.dueNs = clock.NowNs() + firstDelayNs;
+        s.active = active;
+    }
+
+    bool IsActive(int source) const
+    {
+        return source >= 0 && source < sourceCount && sources[source].active;
+    }
+
+    // One-off frame, e.g. after input or a settings change
+    void RequestFrame() { requested = true; }
+
+    // Least time between two frames that nothing requested; 0 for none
+    void SetFrameHold(int64_t ns) { holdNs = ns > 0 ? ns : 0; }
+
+    // Earliest time a frame is due, NO_DEADLINE when idle
+    int64_t NextDeadline() const
+    {
+        if (requested) return clock.NowNs();
+        int64_t next = NO_DEADLINE;
+        for (int i = 0; i < sourceCount; i++)
+            if (sources[i].active && sources[i].dueNs < next)
+                next = sources[i].dueNs;
+        if (next != NO_DEADLINE && next < lastFrameNs + holdNs)
+            next = lastFrameNs + holdNs;
+        return next;
+    }
+
+    // Returns which sources are due (bit i for source i, plus FRAME_REQUESTED),
+    // or 0 when nothing needs rendering. Due sources move on to their next deadline.
+    uint32_t BeginFrame()
+    {
+        int64_t now = clock.NowNs();
+        if (!requested && now < lastFrameNs + holdNs)
+            return 0;
+
+        uint32_t fired = requested ? FRAME_REQUESTED : 0;
+        requested = false;
+
+        for (int i = 0; i < sourceCount; i++)
+        {
+            Source& s = sources[i];
+            if (!s.active || s.dueNs > now) continue;
+            fired |= 1u << i;
+
+            // Keep the source's phase, but never queue up missed frames
+            s.dueNs += s.periodNs;
+            if (s.dueNs <= now) s.dueNs = now + s.periodNs;
+        }
+
+        if (fired)
+        {
+            framesRendered++;
+            lastFrameNs = now;
+        }
+        return fired;
+    }
+
+    const char* SourceName(int source) const { return sources[source].name; }
+    int SourceCount() const { return sourceCount; }
+    uint64_t FramesRendered() const { return framesRendered; }
+
+private:
+    struct Source
+    {
+        const char* name = "";
+        int64_t periodNs = NS_PER_SEC;
+        int64_t dueNs = 0;
+        bool active = false;
+    };
+
+    static int64_t RateToPeriod(double rateHz)
+    {
+        if (rateHz <= 0.0) return NO_DEADLINE / 2;
+        return (int64_t)(NS_PER_SEC / rateHz);
+    }
+
+    const Clock& clock;
+    Source sources[MAX_SOURCES];
+    int sourceCount = 0;
+    bool requested = true; // first frame
+    uint64_t framesRendered = 0;
+    int64_t holdNs = 0;
+    int64_t lastFrameNs = 0;
+};
+
+#endif //FRAME_SCHEDULER_H
@@ -0,0 +1,73 @@
+// Geometry.h: small integer rectangle helpers shared by the overlay modules.
+// No Windows dependency, so everything built on top of it can run headless.
+
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+// Half-open rectangle: [left, right) x [top, bottom)
+struct IntRect
+{
+    int left = 0, top = 0, right = 0, bottom = 0;
+
+    bool IsEmpty() const { return right <= left || bottom <= top; }
+    int Width() const { return right - left; }
+    int Height() const { return bottom - top; }
+    long long Area() const { return IsEmpty() ? 0 : (long long)Width() * Height(); }
+
+    bool operator==(const IntRect& o) const
+    {
+        return left == o.left && top == o.top && right == o.right && bottom == o.bottom;
+    }
+    bool operator!=(const IntRect& o) const { return !(*this == o); }
+};
+
+inline IntRect MakeRect(int left, int top, int right, int bottom)
+{
+    IntRect r;
+    r.left = left;
+    r.top = top;
+    r.right = right;
+    r.bottom = bottom;
+    return r;
+}
+
+inline IntRect RectUnion(const IntRect& a, const IntRect& b)
+{
+    if (a.IsEmpty()) return b;
+    if (b.IsEmpty()) return a;
+    return MakeRect(a.left < b.left ? a.left : b.left,
+                    a.top < b.top ? a.top : b.top,
+                    a.right > b.right ? a.right : b.right,
+                    a.bottom > b.bottom ? a.bottom : b.bottom);
+}
+
+inline IntRect RectIntersect(const IntRect& a, const IntRect& b)
+{
+    IntRect r = MakeRect(a.left > b.left ? a.left : b.left,
+                         a.top > b.top ? a.top : b.top,
+                         a.right < b.right ? a.right : b.right,
+                         a.bottom < b.bottom ? a.bottom : b.bottom);
+    if (r.IsEmpty()) return IntRect();
+    return r;
+}
+
+inline bool RectsOverlap(const IntRect& a, const IntRect& b)
+{
+    return !RectIntersect(a, b).IsEmpty();
+}
+
+// Move a rectangle by (dx, dy)
+inline IntRect RectOffset(const IntRect& r, int dx, int dy)
+{
+    if (r.IsEmpty()) return r;
+    return MakeRect(r.left + dx, r.top + dy, r.right + dx, r.bottom + dy);
+}
+
+// Grow a rectangle by n pixels on every side
+inline IntRect RectInflate(const IntRect& r, int n)
+{
+    if (r.IsEmpty()) return r;
+    return MakeRect(r.left - n, r.top - n, r.right + n, r.bottom + n);
+}
+
+#endif //GEOMETRY_H
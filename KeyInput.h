@@ -0,0 +1,105 @@
+// KeyInput.h: timestamped key events and the edge/auto-repeat logic that
+// turns them into key presses.
+//
+// Presses come from down transitions only; the OS's own auto-repeat of a held
+// key is ignored. Held keys that opt in repeat on a schedule derived from the
+// timestamp of their down event, so repeat timing does not depend on how
+// often the consumer gets around to reading the queue. A consumer emits the
+// repeats due before each event it reads, then applies the event, so a key
+// pressed and released between two reads still gets its repeats. One that
+// falls more than an interval behind gets a single repeat for the stretch it
+// missed, not a burst of them, and the schedule restarts from there.
+
+#ifndef KEY_INPUT_H
+#define KEY_INPUT_H
+
+#include <cstdint>
+
+struct KeyEvent
+{
+    uint16_t key = 0;   // virtual-key code
+    bool down = false;
+    int64_t timeNs = 0; // when the event was captured
+};
+
+class KeyRepeater
+{
+public:
+    static const int MAX_KEYS = 256;
+
+    // Held key produces its first repeat after delayNs, then every intervalNs.
+    // intervalNs <= 0 turns repeat off.
+    void SetRepeat(int key, int64_t delayNs, int64_t intervalNs)
+    {
+        if (key < 0 || key >= MAX_KEYS) return;
+        keys[key].delayNs = delayNs;
+        keys[key].intervalNs = intervalNs;
+    }
+
+    // Returns true when the event is a fresh press
+    bool OnEvent(const KeyEvent& e)
+    {
+        if (e.key >= MAX_KEYS) return false;
+        KeyState& k = keys[e.key];
+        if (!e.down)
+        {
+            k.down = false;
+            return false;
+        }
+        if (k.down) return false; // OS auto-repeat
+        k.down = true;
+        k.nextRepeatNs = e.timeNs + k.delayNs;
+        return true;
+    }
+
+    // Calls onPress(key) for each held key with a repeat due at or before
+    // nowNs, once however many are due. A key more than an interval behind
+    // repeats next an interval after nowNs.
+    template <class Fn>
+    void EmitRepeats(int64_t nowNs, Fn onPress)
+    {
+        for (int key = 0; key < MAX_KEYS; key++)
+        {
+            KeyState& k = keys[key];
+            if (!k.down || k.intervalNs <= 0 || k.nextRepeatNs > nowNs) continue;
+            onPress(key);
+            k.nextRepeatNs += k.intervalNs;
+            if (k.nextRepeatNs <= nowNs)
+                k.nextRepeatNs = nowNs + k.intervalNs;
+        }
+    }
+
+    // Earliest pending repeat, INT64_MAX when no repeating key is held
+    int64_t NextRepeatDeadline() const
+    {
+        int64_t next = INT64_MAX;
+        for (int key = 0; key < MAX_KEYS; key++)
+        {
+            const KeyState& k = keys[key];
+            if (k.down && k.intervalNs > 0 && k.nextRepeatNs < next)
+                next = k.nextRepeatNs;
+        }
+        return next;
+    }
+
+    bool IsDown(int key) const { return key >= 0 && key < MAX_KEYS && keys[key].down; }
+
+    void ReleaseAll()
+    {
+        for (int key = 0; key < MAX_KEYS; key++)
+            keys[key].down = false;
+    }
+
+private:
+    struct KeyState
+    {
+        bool down = false;
+        int64_t delayNs = 0;
+        int64_t intervalNs = 0;
+        int64_t nextRepeatNs = 0;
+    };
+
+    KeyState keys[MAX_KEYS];
+};
+
+#endif //KEY_INPUT_H
@@ -0,0 +1,299 @@
+// Memory.h: where the overlay's memory comes from once it is running.
+//
+// Two allocators cover everything a frame touches. A FrameArena hands out
+// scratch that lives for one loop iteration, such as the closures of a
+// recorded DrawList, by bumping a pointer through blocks it keeps from one
+// frame to the next. The host resets it at the top of every iteration. A
+// SurfaceAllocator holds the pixels of cached sprites. It keeps freed blocks
+// in a pool per size class, and everything it holds, in use or pooled, stays
+// under a hard budget; when a block won't fit, the owner is asked to give
+// something back first. Effects and the like already live in fixed-size pools
+// of their own (AnimationPool).
+//
+// Once the overlay has drawn each thing it shows at least once, neither
+// allocator goes back to the heap: the arena's blocks are big enough and the
+// pools hold a block of every size a sprite takes.
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+struct MemoryStats
+{
+    size_t bytesInUse = 0;        // handed out and not given back
+    size_t peakBytes = 0;         // most ever in use at once
+    size_t pooledBytes = 0;       // given back and kept for reuse
+    size_t budgetBytes = 0;       // 0 for none
+    uint64_t heapAllocations = 0; // blocks taken from the heap, ever
+    uint64_t poolHits = 0;        // requests a pooled block met
+    uint64_t poolMisses = 0;      // requests that went to the heap or failed
+
+    double PoolHitRate() const
+    {
+        uint64_t requests = poolHits + poolMisses;
+        return requests ? (double)poolHits / requests : 0.0;
+    }
+};
+
+// --- Frame arena ---
+
+class FrameArena
+{
+public:
+    static const size_t BLOCK_SIZE = 16 * 1024;
+
+    FrameArena() {}
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Aligned for any type; valid until the next Reset
+    void* Allocate(size_t bytes)
+    {
+        const size_t align = alignof(std::max_align_t);
+        bytes = (bytes + align - 1) / align * align;
+        stats.bytesInUse += bytes;
+        if (stats.bytesInUse > stats.peakBytes)
+            stats.peakBytes = stats.bytesInUse;
+
+        for (; current < blocks.size(); current++)
+        {
+            Block& b = blocks[current];
+            if (b.size - b.used >= bytes)
+            {
+                void* p = b.data.get() + b.used;
+                b.used += bytes;
+                return p;
+            }
+        }
+
+        Block b;
+        b.size = bytes > BLOCK_SIZE ? bytes : BLOCK_SIZE;
+        b.data.reset(new unsigned char[b.size]);
+        b.used = bytes;
+        blocks.push_back(std::move(b));
+        current = blocks.size() - 1;
+        stats.heapAllocations++;
+        return blocks.back().data.get();
+    }
+
+    // Takes everything back, keeping the blocks for the next frame
+    void Reset()
+    {
+        for (Block& b : blocks)
+            b.used = 0;
+        current = 0;
+        stats.bytesInUse = 0;
+    }
+
+    // bytesInUse counts this frame so far; pooledBytes what the blocks hold in all
+    MemoryStats Stats() const
+    {
+        MemoryStats s = stats;
+        for (const Block& b : blocks)
+            s.pooledBytes += b.size;
+        return s;
+    }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size = 0;
+        size_t used = 0;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0; // first block that may still have room
+    MemoryStats stats;
+};
+
+// --- Surface allocator ---
+
+class SurfaceAllocator;
+
+// One block from a SurfaceAllocator, given back when dropped
+class SurfaceBlock
+{
+public:
+    SurfaceBlock() {}
+    ~SurfaceBlock() { Release(); }
+
+    SurfaceBlock(SurfaceBlock&& o) noexcept : owner(o.owner), data(o.data), sizeClass(o.sizeClass) { o.data = nullptr; }
+    SurfaceBlock& operator=(SurfaceBlock&& o) noexcept
+    {
+        if (this != &o)
+        {
+            Release();
+            owner = o.owner;
+            data = o.data;
+            sizeClass = o.sizeClass;
+            o.data = nullptr;
+        }
+        return *this;
+    }
+
+    SurfaceBlock(const SurfaceBlock&) = delete;
+    SurfaceBlock& operator=(const SurfaceBlock&) = delete;
+
+    void* Data() const { return data; }
+    size_t Bytes() const; // what the block holds, at least what was asked for
+    explicit operator bool() const { return data != nullptr; }
+
+    inline void Release();
+
+private:
+    friend class SurfaceAllocator;
+
+    SurfaceAllocator* owner = nullptr;
+    void* data = nullptr;
+    int sizeClass = 0;
+};
+
+class SurfaceAllocator
+{
+public:
+    // Four classes per doubling from 256 bytes, so a block wastes at most a fifth of itself
+    static const int SIZE_CLASSES = 4 * 24;
+
+    static size_t ClassBytes(int sizeClass) { return (size_t)(4 + sizeClass % 4) << (sizeClass / 4 + 6); }
+
+    static int SizeClass(size_t bytes)
+    {
+        int c = 0;
+        while (c < SIZE_CLASSES - 1 && ClassBytes(c) < bytes)
+            c++;
+        return c;
+    }
+
+    // Called when a block won't fit the budget. Gives back at least one block
+    // and returns true, or returns false if there is nothing left to give.
+    typedef bool (*ReclaimFn)(void* context);
+
+    explicit SurfaceAllocator(size_t budgetBytes) { stats.budgetBytes = budgetBytes; }
+    ~SurfaceAllocator() { Trim(); }
+
+    SurfaceAllocator(const SurfaceAllocator&) = delete;
+    SurfaceAllocator& operator=(const SurfaceAllocator&) = delete;
+
+    void SetReclaim(ReclaimFn fn, void* context)
+    {
+        reclaim = fn;
+        reclaimContext = context;
+    }
+
+    // A block of at least bytes, from the pool when one of its class is
+    // free. Empty when it can't be had within the budget.
+    SurfaceBlock Allocate(size_t bytes)
+    {
+        SurfaceBlock block;
+        int c = SizeClass(bytes);
+        size_t size = ClassBytes(c);
+        if (size < bytes || size > stats.budgetBytes)
+        {
+            stats.poolMisses++;
+            return block;
+        }
+
+        for (;;)
+        {
+            if (FreeBlock* f = freeLists[c])
+            {
+                freeLists[c] = f->next;
+                stats.pooledBytes -= size;
+                stats.poolHits++;
+                block.data = f;
+                break;
+            }
+            if (stats.bytesInUse + stats.pooledBytes + size <= stats.budgetBytes)
+            {
+                block.data = ::operator new(size);
+                stats.heapAllocations++;
+                stats.poolMisses++;
+                break;
+            }
+            // Over budget: pooled blocks of other sizes go first, then what the owner gives back
+            if (stats.pooledBytes > 0)
+                Trim();
+            else if (!reclaim || !reclaim(reclaimContext))
+            {
+                stats.poolMisses++;
+                return block;
+            }
+        }
+
+        block.owner = this;
+        block.sizeClass = c;
+        stats.bytesInUse += size;
+        if (stats.bytesInUse > stats.peakBytes)
+            stats.peakBytes = stats.bytesInUse;
+        return block;
+    }
+
+    // Hands pooled blocks back to the heap
+    void Trim()
+    {
+        for (int c = 0; c < SIZE_CLASSES; c++)
+        {
+            while (FreeBlock* f = freeLists[c])
+            {
+                freeLists[c] = f->next;
+                ::operator delete(f);
+                stats.pooledBytes -= ClassBytes(c);
+            }
+        }
+    }
+
+    void SetBudget(size_t budgetBytes)
+    {
+        stats.budgetBytes = budgetBytes;
+        if (stats.bytesInUse + stats.pooledBytes > budgetBytes)
+            Trim();
+        while (stats.bytesInUse > budgetBytes && reclaim && reclaim(reclaimContext))
+            Trim();
+    }
+
+    const MemoryStats& Stats() const { return stats; }
+
+private:
+    friend class SurfaceBlock;
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    void Free(void* data, int sizeClass)
+    {
+        FreeBlock* f = (FreeBlock*)data;
+        f->next = freeLists[sizeClass];
+        freeLists[sizeClass] = f;
+        size_t size = ClassBytes(sizeClass);
+        stats.bytesInUse -= size;
+        stats.pooledBytes += size;
+    }
+
+    FreeBlock* freeLists[SIZE_CLASSES] = {};
+    ReclaimFn reclaim = nullptr;
+    void* reclaimContext = nullptr;
+    MemoryStats stats;
+};
+
+inline size_t SurfaceBlock::Bytes() const
+{
+    return data ? SurfaceAllocator::ClassBytes(sizeClass) : 0;
+}
+
+inline void SurfaceBlock::Release()
+{
+    if (data)
+        owner->Free(data, sizeClass);
+    data = nullptr;
+}
+
+#endif //MEMORY_H
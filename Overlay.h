@@ -0,0 +1,534 @@
+// Overlay.h: the overlay's state and frame loop, without any windows.
+//
+// Everything between a key event and the pixels it changes lives here: the
+// settings and the menu that edits them, kill effects, the frame scheduler and
+// its animation sources, the governor's quality levels, and where each widget
+// window goes and what it draws. A host wakes the loop up, feeds it key
+// events and puts the windows it lays out somewhere: the DLL on screen as
+// layered windows, bench/OverlayReplay.cpp offscreen while it replays a
+// recorded session. Time only ever comes from the Clock the overlay was given,
+// so under a ManualClock a recorded session runs the same way every time.
+//
+// One loop iteration is StartIteration, ProcessInput, then BeginFrame and,
+// when that returns a frame, LayoutWindows. A host pacing its frames to the
+// display calls HoldFrame instead of BeginFrame while it holds one back.
+// NextWakeNs says when the next iteration is due.
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include "Widgets.h"
+#include "Color.h"
+#include "Clock.h"
+#include "FrameScheduler.h"
+#include "FrameProfiler.h"
+#include "KeyInput.h"
+#include "Snapshot.h"
+#include "CpuGovernor.h"
+#include "Trace.h"
+#include <cmath>
+
+// Keys the overlay reacts to, as Windows virtual-key codes so hook events need no translation
+const int OVERLAY_KEY_RETURN = 0x0D;
+const int OVERLAY_KEY_LEFT = 0x25;
+const int OVERLAY_KEY_UP = 0x26;
+const int OVERLAY_KEY_RIGHT = 0x27;
+const int OVERLAY_KEY_DOWN = 0x28;
+const int OVERLAY_KEY_INSERT = 0x2D;
+const int OVERLAY_KEY_KILL = 'K';            // kill effect demo
+const int OVERLAY_KEY_PROFILER_READOUT = 0x78; // F9
+const int OVERLAY_KEY_PROFILER_DUMP = 0x79;    // F10
+
+// One layered window per widget, in stacking order. The profiler readout is
+// drawn by the host; LayoutWindows covers the rest.
+enum OverlayWindowId { WINDOW_CENTER, WINDOW_WATERMARK, WINDOW_INFOPANEL, WINDOW_PROFILER, WINDOW_MENU, WINDOW_KILLEFFECT, WINDOW_COUNT };
+
+// Damage slots within a window; only the center window holds more than one widget
+enum OverlayWidget { WIDGET_SCOPE, WIDGET_CROSSHAIR, WIDGET_CONTENT = 0 };
+
+// Per-stage frame timing, registered in this order
+enum ProfileStage
+{
+    STAGE_FRAME, STAGE_MESSAGES, STAGE_INPUT, STAGE_DAMAGE, STAGE_CLEAR, STAGE_SCOPE, STAGE_CROSSHAIR,
+    STAGE_WATERMARK, STAGE_INFOPANEL, STAGE_MENU, STAGE_KILLEFFECT, STAGE_COMPOSE, STAGE_HASH, STAGE_SUBMIT, STAGE_COUNT
+};
+const char* const PROFILE_STAGE_NAMES[STAGE_COUNT] =
+{
+    "frame", "messages", "input", "damage", "clear", "scope", "crosshair",
+    "watermark", "info panel", "menu", "kill effect", "compose", "hash", "submit"
+};
+
+// Animation rates at full quality
+const double KILL_EFFECT_RATE = 30.0;
+const double WATERMARK_RATE = 20.0;
+const double RAINBOW_RATE = 30.0;
+
+class Overlay
+{
+public:
+    // cpuBudget is the governor's share of one core, 0 for no governor
+    Overlay(const Clock& clock, TextRenderer& text, double cpuBudget)
+        : clock(clock), text(text), scheduler(clock), governor(clock, cpuBudget), profiler(clock)
+    {
+        keyRepeater.SetRepeat(OVERLAY_KEY_UP, 300 * NS_PER_MS, 120 * NS_PER_MS);
+        keyRepeater.SetRepeat(OVERLAY_KEY_DOWN, 300 * NS_PER_MS, 120 * NS_PER_MS);
+        keyRepeater.SetRepeat(OVERLAY_KEY_LEFT, 300 * NS_PER_MS, 60 * NS_PER_MS);
+        keyRepeater.SetRepeat(OVERLAY_KEY_RIGHT, 300 * NS_PER_MS, 60 * NS_PER_MS);
+
+        // Each animation declares the rate it needs
+        sourceKillEffect = scheduler.AddSource("kill effect", KILL_EFFECT_RATE);
+        sourceWatermark = scheduler.AddSource("watermark", WATERMARK_RATE);
+        sourceRainbow = scheduler.AddSource("rainbow", RAINBOW_RATE);
+        sourceFps = scheduler.AddSource("fps", 1.0);
+        sourceProfiler = scheduler.AddSource("profiler", 2.0);
+
+        for (int i = 0; i < STAGE_COUNT; i++)
+            profiler.AddStage(PROFILE_STAGE_NAMES[i]);
+
+        // Looping animations run from here for as long as the overlay does
+        lastFpsNs = clock.NowNs();
+        animationOriginNs = lastFpsNs;
+    }
+
+    Overlay(const Overlay&) = delete;
+    Overlay& operator=(const Overlay&) = delete;
+
+    // --- From the host ---
+
+    // Widgets are laid out relative to the monitor's top-left corner
+    void SetMonitorSize(int width, int height)
+    {
+        if (width == monitorWidth && height == monitorHeight) return;
+        monitorWidth = width;
+        monitorHeight = height;
+        if (trace) trace->Monitor(width, height);
+        scheduler.RequestFrame();
+    }
+
+    // Something outside the overlay changed what its windows should show
+    void RequestFrame()
+    {
+        if (trace) trace->Request();
+        scheduler.RequestFrame();
+    }
+
+    // Replaces the settings, as a replay does with those its trace started with
+    void RestoreSettings(const OverlaySettings& s)
+    {
+        editedSettings = s;
+        publishedSettings.Publish(editedSettings);
+    }
+
+    // Takes on a profile's settings, as the host does when one is picked or
+    // its file changes; the menu stays open or closed where it was. A field
+    // the profile leaves as it was changes nothing on screen: damage follows
+    // each widget's state, so only widgets that draw a changed field repaint.
+    void ApplyProfile(const OverlaySettings& profile)
+    {
+        if (trace) trace->Profile(profile);
+        OverlaySettings s = profile;
+        s.menuOpen = editedSettings.menuOpen;
+        s.menuSelection = editedSettings.menuSelection;
+        if (s == editedSettings) return;
+        editedSettings = s;
+        publishedSettings.Publish(editedSettings);
+    }
+
+    // Puts a quality level into effect without the governor, as a replay does
+    // with the levels its trace recorded
+    void SetQualityLevel(int level)
+    {
+        governor.SetLevel(level);
+        ApplyQuality();
+    }
+
+    // Records the session from here on until StopTrace. Returns false if the file can't be created.
+    bool StartTrace(TraceWriter& writer, const char* path)
+    {
+        StopTrace();
+        if (!writer.Open(path, clock.NowNs(), monitorWidth, monitorHeight, editedSettings))
+            return false;
+        trace = &writer;
+        return true;
+    }
+
+    void StopTrace()
+    {
+        if (trace) trace->Close();
+        trace = nullptr;
+    }
+
+    bool Tracing() const { return trace != nullptr; }
+
+    // --- Loop ---
+
+    // Top of every iteration, once the host is awake. The governor closes its
+    // window if it has run its length, and a new quality level takes effect.
+    void StartIteration()
+    {
+        if (trace) trace->Tick(clock.NowNs());
+        if (governor.Update())
+        {
+            if (trace) trace->Quality(governor.Level());
+            ApplyQuality();
+        }
+    }
+
+    // Applies the key events pop(event) hands over until it returns false,
+    // each after the auto-repeats that came due before it, then the repeats
+    // due since the last one, and takes this frame's snapshot of the settings
+    template <class PopFn>
+    void ProcessInput(PopFn pop)
+    {
+        PROFILE_ZONE(profiler, STAGE_INPUT);
+        uint64_t inputState = InputStateKey();
+        OverlaySettings before = editedSettings;
+
+        auto repeat = [this](int key) { HandleKeyPress(key); };
+        KeyEvent e;
+        while (pop(e))
+        {
+            if (trace) trace->Key(e);
+            keyRepeater.EmitRepeats(e.timeNs, repeat);
+            if (keyRepeater.OnEvent(e))
+                HandleKeyPress(e.key);
+        }
+        keyRepeater.EmitRepeats(clock.NowNs(), repeat);
+
+        // Only real changes are published, so a new generation always means new settings
+        if (editedSettings != before)
+        {
+            publishedSettings.Publish(editedSettings);
+            if (trace) trace->Settings(editedSettings);
+        }
+        if (InputStateKey() != inputState)
+            scheduler.RequestFrame();
+
+        // One consistent view of the settings for everything this frame draws
+        uint64_t generation = publishedSettings.Read(settings);
+        if (generation != settingsGeneration)
+        {
+            settingsGeneration = generation;
+            scheduler.RequestFrame();
+        }
+    }
+
+    // In place of BeginFrame, for an iteration whose frame the host holds back
+    // until closer to the display's refresh; the frame stays due
+    void HoldFrame()
+    {
+        if (trace) trace->Hold();
+    }
+
+    // Ends finished effects and asks the scheduler whether a frame is due.
+    // Returns the sources that fired, 0 when there is no frame to render.
+    uint32_t BeginFrame()
+    {
+        if (killEffects.Expire(clock.NowNs()))
+            scheduler.RequestFrame();
+        UpdateAnimationSources();
+
+        uint32_t fired = scheduler.BeginFrame();
+        if (!fired)
+            return 0;
+        if (trace) trace->Frame(fired);
+        if (fired & (1u << sourceProfiler))
+            profilerReadoutGeneration++;
+
+        // Every animation in the frame is drawn as of the same instant
+        frameNs = clock.NowNs();
+        animationSeconds = AnimationSeconds(frameNs, animationOriginNs);
+
+        // Calculate FPS; frames rendered only to refresh the readout are not counted
+        if (fired != (1u << sourceFps))
+            frameCount++;
+        if (fired & (1u << sourceFps))
+        {
+            currentFPS = (float)(frameCount * (double)NS_PER_SEC / (frameNs - lastFpsNs));
+            lastFpsNs = frameNs;
+            frameCount = 0;
+        }
+        UpdateFpsSource();
+
+        // Crosshair color
+        if (settings.rainbowEnabled)
+            crosshairColor = rainbowHues.At(animationSeconds * 0.3f);
+        else
+            crosshairColor = PremultipliedColor(settings.colorR, settings.colorG, settings.colorB);
+        return fired;
+    }
+
+    // Calls update(window, rect, report, draw) for each widget window in
+    // stacking order. rect is where the window's content goes this frame, in
+    // monitor coordinates, and empty to hide it. report(tracker, dx, dy)
+    // reports its widgets in window coordinates, which are monitor coordinates
+    // offset by (dx, dy); draw(surface, damage, dx, dy) redraws whatever
+    // overlaps one damage rectangle.
+    template <class UpdateFn>
+    void LayoutWindows(UpdateFn update)
+    {
+        int cx = monitorWidth / 2;
+        int cy = monitorHeight / 2;
+
+        // Every widget reports where it draws and what it depends on, in monitor coordinates
+        IntRect scopeRect = settings.scopeOverlayEnabled ? ScopeBounds(cx, cy, settings.scopeRadius, settings.scopeOffsetX, settings.scopeOffsetY, ScopeVignetteWidth()) : IntRect();
+        IntRect crosshairRect = settings.crosshairEnabled ? CrosshairBounds(cx, cy, settings.crosshairSize) : IntRect();
+        IntRect watermarkRect = WatermarkBounds(text, WATERMARK_X, WATERMARK_Y, animationSeconds);
+
+        // Scope and crosshair share the window around the screen center
+        update(WINDOW_CENTER, RectUnion(scopeRect, crosshairRect),
+            [&](DirtyRegionTracker& tracker, int dx, int dy)
+            {
+                if (settings.scopeOverlayEnabled)
+                    tracker.Report(WIDGET_SCOPE, RectOffset(scopeRect, dx, dy), ScopeStateKey());
+                if (settings.crosshairEnabled)
+                    tracker.Report(WIDGET_CROSSHAIR, RectOffset(crosshairRect, dx, dy), CrosshairStateKey());
+            },
+            [&](Surface& surface, const IntRect& damage, int dx, int dy)
+            {
+                if (settings.scopeOverlayEnabled && RectsOverlap(damage, RectOffset(scopeRect, dx, dy)))
+                {
+                    PROFILE_ZONE(profiler, STAGE_SCOPE);
+                    DrawCachedScope(spriteCache, surface, cx + dx, cy + dy, settings.scopeRadius, settings.scopeOffsetX, settings.scopeOffsetY, ScopeVignetteWidth());
+                }
+                if (settings.crosshairEnabled && RectsOverlap(damage, RectOffset(crosshairRect, dx, dy)))
+                {
+                    PROFILE_ZONE(profiler, STAGE_CROSSHAIR);
+                    DrawCachedCrosshair(spriteCache, surface, cx + dx, cy + dy, crosshairColor, settings.crosshairSize, settings.crosshairGap, settings.crosshairShape);
+                }
+            });
+
+        // The watermark window covers the whole sway, so swaying only moves damage within it
+        update(WINDOW_WATERMARK, settings.watermarkEnabled ? WatermarkExtent(text, WATERMARK_X, WATERMARK_Y) : IntRect(),
+            [&](DirtyRegionTracker& tracker, int dx, int dy)
+            {
+                tracker.Report(WIDGET_CONTENT, RectOffset(watermarkRect, dx, dy), (uint64_t)WatermarkAlpha(animationSeconds));
+            },
+            [&](Surface& surface, const IntRect&, int dx, int dy)
+            {
+                PROFILE_ZONE(profiler, STAGE_WATERMARK);
+                DrawWatermark(surface, text, widgetText, WATERMARK_X + dx, WATERMARK_Y + dy, animationSeconds);
+            });
+
+        update(WINDOW_INFOPANEL, InfoPanelBounds(INFO_PANEL_X, INFO_PANEL_Y),
+            [&](DirtyRegionTracker& tracker, int, int)
+            {
+                tracker.Report(WIDGET_CONTENT, tracker.SurfaceBounds(), InfoPanelStateKey());
+            },
+            [&](Surface& surface, const IntRect&, int dx, int dy)
+            {
+                PROFILE_ZONE(profiler, STAGE_INFOPANEL);
+                DrawInfoPanel(surface, text, widgetText, settings, currentFPS, governor.Status(), INFO_PANEL_X + dx, INFO_PANEL_Y + dy);
+            });
+
+        update(WINDOW_MENU, settings.menuOpen ? MenuBounds(MENU_X, MENU_Y) : IntRect(),
+            [&](DirtyRegionTracker& tracker, int dx, int dy)
+            {
+                ReportMenu(tracker, settings, MENU_X + dx, MENU_Y + dy);
+            },
+            [&](Surface& surface, const IntRect&, int dx, int dy)
+            {
+                PROFILE_ZONE(profiler, STAGE_MENU);
+                DrawMenu(surface, text, widgetText, settings, MENU_X + dx, MENU_Y + dy);
+            });
+
+        // Draw kill effect text; one window spans every running effect and the state key follows each fade
+        update(WINDOW_KILLEFFECT, KillEffectsExtent(text, killEffects),
+            [&](DirtyRegionTracker& tracker, int, int)
+            {
+                tracker.Report(WIDGET_CONTENT, tracker.SurfaceBounds(), KillEffectsKey(killEffects, frameNs));
+            },
+            [&](Surface& surface, const IntRect&, int dx, int dy)
+            {
+                PROFILE_ZONE(profiler, STAGE_KILLEFFECT);
+                DrawKillEffects(surface, text, widgetText, killEffects, frameNs, -dx, -dy);
+            });
+    }
+
+    // When the next iteration is due: a scheduled frame, a key repeat or the
+    // end of a kill effect, so an ended effect is cleared on time
+    int64_t NextWakeNs() const
+    {
+        int64_t wake = scheduler.NextDeadline();
+        int64_t repeat = keyRepeater.NextRepeatDeadline();
+        if (repeat < wake)
+            wake = repeat;
+        int64_t expiry = killEffects.NextExpiry();
+        if (expiry < wake)
+            wake = expiry;
+        return wake;
+    }
+
+    // --- State ---
+
+    const OverlaySettings& Settings() const { return settings; } // this frame's snapshot
+    int MonitorWidth() const { return monitorWidth; }
+    int MonitorHeight() const { return monitorHeight; }
+    float CurrentFps() const { return currentFPS; }
+    float AnimationTime() const { return animationSeconds; } // this frame's, in seconds since the overlay was made
+    Pixel CrosshairColor() const { return crosshairColor; }  // this frame's
+    bool ProfilerReadoutEnabled() const { return profilerReadoutEnabled; }
+    uint64_t ProfilerReadoutGeneration() const { return profilerReadoutGeneration; } // bumped when the readout should refresh
+
+    TextRenderer& Text() { return text; }
+    FrameScheduler& Scheduler() { return scheduler; }
+    CpuGovernor& Governor() { return governor; }
+    FrameProfiler& Profiler() { return profiler; }
+    SpriteCache& Sprites() { return spriteCache; }
+
+private:
+    // Applies one key press (fresh or auto-repeated) to the overlay state
+    void HandleKeyPress(int key)
+    {
+        if (key == OVERLAY_KEY_INSERT)
+            editedSettings.menuOpen = !editedSettings.menuOpen;
+
+        // Trigger kill effect demo when pressing K (only on key down)
+        if (key == OVERLAY_KEY_KILL)
+        {
+            KillEffect effect;
+            effect.x = monitorWidth / 2 + 50; // Demo position offset
+            effect.y = monitorHeight / 2 - 50;
+            killEffects.Start(effect, clock.NowNs(), KILL_EFFECT_DURATION_NS, EASE_OUT_CUBIC);
+        }
+
+#if ASTRAL_PROFILING
+        // F9 toggles the timing readout, F10 dumps the buffered zones for chrome://tracing
+        if (key == OVERLAY_KEY_PROFILER_READOUT)
+            profilerReadoutEnabled = !profilerReadoutEnabled;
+        if (key == OVERLAY_KEY_PROFILER_DUMP)
+            profiler.WriteChromeTrace("astral_trace.json");
+#endif
+
+        if (!editedSettings.menuOpen)
+            return;
+
+        if (key == OVERLAY_KEY_UP)
+            MenuMoveSelection(editedSettings, -1);
+        if (key == OVERLAY_KEY_DOWN)
+            MenuMoveSelection(editedSettings, 1);
+        if (key == OVERLAY_KEY_LEFT || key == OVERLAY_KEY_RIGHT)
+            MenuAdjust(editedSettings, key == OVERLAY_KEY_RIGHT ? 1 : -1);
+        if (key == OVERLAY_KEY_RETURN)
+            MenuActivate(editedSettings);
+    }
+
+    // Puts the governor's current quality level into effect; the vignette width is read per frame
+    void ApplyQuality()
+    {
+        const QualityLevel& q = governor.Quality();
+        scheduler.SetRate(sourceKillEffect, KILL_EFFECT_RATE * q.animationRateScale);
+        scheduler.SetRate(sourceWatermark, WATERMARK_RATE * q.animationRateScale);
+        scheduler.SetRate(sourceRainbow, RAINBOW_RATE * q.animationRateScale);
+        scheduler.SetFrameHold(q.frameHoldNs);
+        scheduler.RequestFrame();
+    }
+
+    // Turns animation sources on while the thing they animate is on screen
+    void UpdateAnimationSources()
+    {
+        scheduler.SetActive(sourceKillEffect, !killEffects.IsEmpty());
+        scheduler.SetActive(sourceWatermark, settings.watermarkEnabled);
+        scheduler.SetActive(sourceRainbow, settings.rainbowEnabled && settings.crosshairEnabled);
+        scheduler.SetActive(sourceProfiler, profilerReadoutEnabled);
+    }
+
+    // The FPS readout runs while frames are being rendered and once more to
+    // show zero. Its first tick is a full second out so the rate is measured
+    // over a whole window. Called as soon as a frame is counted, so the next
+    // wake already includes the tick that frame needs.
+    void UpdateFpsSource()
+    {
+        bool fpsActive = frameCount > 0 || currentFPS != 0.0f;
+        if (fpsActive && !scheduler.IsActive(sourceFps))
+            lastFpsNs = clock.NowNs();
+        scheduler.SetActive(sourceFps, fpsActive, NS_PER_SEC);
+    }
+
+    // --- Damage reporting: what each widget depends on ---
+
+    uint64_t CrosshairStateKey() const
+    {
+        uint64_t key = HashCombine(0, crosshairColor);
+        key = HashCombine(key, settings.crosshairSize);
+        key = HashCombine(key, settings.crosshairGap);
+        return HashCombine(key, settings.crosshairShape);
+    }
+
+    // The vignette width the scope is drawn with: the setting, narrowed by the governor
+    int ScopeVignetteWidth() const
+    {
+        return (int)(settings.scopeVignetteWidth * governor.Quality().vignetteScale);
+    }
+
+    uint64_t ScopeStateKey() const
+    {
+        return HashCombine(HashCombine(0, settings.scopeRadius), ScopeVignetteWidth());
+    }
+
+    uint64_t InfoPanelStateKey() const
+    {
+        CpuBudgetStatus cpu = governor.Status();
+        uint64_t key = HashCombine(0, (uint64_t)(currentFPS * 10.0f));
+        key = HashCombine(key, (uint64_t)(cpu.usage * 10000.0) | (uint64_t)cpu.level << 32);
+        key = HashCombine(key, settings.crosshairEnabled | settings.watermarkEnabled << 1 | settings.scopeOverlayEnabled << 2);
+        key = HashCombine(key, settings.scopeRadius);
+        key = HashCombine(key, (uint32_t)settings.scopeOffsetX);
+        return HashCombine(key, (uint32_t)settings.scopeOffsetY);
+    }
+
+    // What input can change besides the settings, which carry their own generation
+    uint64_t InputStateKey() const
+    {
+        return HashCombine(HashCombine(0, profilerReadoutEnabled), killEffects.Started());
+    }
+
+    const Clock& clock;
+    TextRenderer& text;
+    WidgetText widgetText;
+    SpriteCache spriteCache{ 4 * 1024 * 1024 }; // retained crosshair and scope layers
+    HueTable rainbowHues;
+
+    // Key handling edits its own copy of the settings and publishes it whole; every
+    // frame draws from one snapshot, so nothing ever renders a half-applied change
+    OverlaySettings editedSettings;
+    SnapshotCell<OverlaySettings> publishedSettings;
+    OverlaySettings settings;        // this frame's snapshot
+    uint64_t settingsGeneration = 0; // and its generation
+
+    KeyRepeater keyRepeater;
+    KillEffectPool killEffects; // in monitor coordinates; any number play at once
+    int monitorWidth = 0, monitorHeight = 0;
+
+    // Frame scheduling: render only when something is due
+    FrameScheduler scheduler;
+    int sourceKillEffect = -1;
+    int sourceWatermark = -1;
+    int sourceRainbow = -1;
+    int sourceFps = -1;
+    int sourceProfiler = -1;
+
+    // Measures what the overlay costs and picks the quality that stays under budget
+    CpuGovernor governor;
+
+    FrameProfiler profiler;
+    bool profilerReadoutEnabled = false;
+    uint64_t profilerReadoutGeneration = 0;
+
+    // FPS tracking: rendered frames per second
+    int64_t lastFpsNs = 0;
+    int frameCount = 0;
+    float currentFPS = 0.0f;
+
+    // This frame: when it is drawn as of, looping animation time (counted from
+    // animationOriginNs, when the overlay was made, and never reset) and the
+    // crosshair colour
+    int64_t frameNs = 0;
+    int64_t animationOriginNs = 0;
+    float animationSeconds = 0.0f;
+    Pixel crosshairColor = 0;
+
+    TraceWriter* trace = nullptr;
+};
+
+#endif //OVERLAY_H
@@ -0,0 +1,391 @@
+// Platform.h: the calls the overlay makes into the OS, counted.
+//
+// Widgets are rasterized in memory (Raster.h), so what is left of GDI, USER and
+// the kernel is the plumbing around them: DIB sections for each window's
+// buffers, the memory DC the present thread selects them into,
+// UpdateLayeredWindowIndirect, the events and the timer the loop waits on, the
+// compositor's refresh timing the loop paces frames by, and the glyph source's
+// TextOutA at startup. Those go through a PlatformBackend, the DLL's over Win32
+// or, to run without Windows, the mock in bench/MockPlatformBackend.h.
+// TrackedPlatform wraps whichever is in use.
+//
+// TrackedPlatform counts and times every call by type and registers every
+// object it creates until it is destroyed. Objects made once and never through
+// a backend (windows, threads) are registered with the ResourceTracker
+// directly. At the end of each frame the tracker turns its counters into a
+// per-frame report. At shutdown, once everything has been let go of, anything
+// still registered has leaked, and WriteLeaks or ForEachLeak lists it.
+//
+// Calls come from the overlay and present threads at once, so the counters are
+// atomics and a frame's report holds whatever both made since the last one.
+// Waits are counted but not timed: their time is sleep, not work.
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include "Raster.h"
+#include "Clock.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+typedef void* PlatformHandle;
+
+enum PlatformCall
+{
+    CALL_CREATE_BITMAP, CALL_DELETE_BITMAP, CALL_CREATE_CONTEXT, CALL_DELETE_CONTEXT, CALL_SELECT, CALL_TEXT,
+    CALL_PRESENT, CALL_SHOW_WINDOW, CALL_CREATE_SIGNAL, CALL_SIGNAL, CALL_CLOSE_SIGNAL, CALL_CREATE_TIMER,
+    CALL_ARM_TIMER, CALL_CANCEL_TIMER, CALL_CLOSE_TIMER, CALL_WAIT, CALL_REFRESH_TIMING, CALL_COUNT
+};
+const char* const PLATFORM_CALL_NAMES[CALL_COUNT] =
+{
+    "create bitmap", "delete bitmap", "create dc", "delete dc", "select", "text",
+    "present", "show window", "create event", "set event", "close event", "create timer",
+    "arm timer", "cancel timer", "close timer", "wait", "refresh timing"
+};
+
+enum PlatformObject { OBJECT_BITMAP, OBJECT_CONTEXT, OBJECT_SIGNAL, OBJECT_TIMER, OBJECT_WINDOW, OBJECT_THREAD, OBJECT_WATCH, OBJECT_COUNT };
+const char* const PLATFORM_OBJECT_NAMES[OBJECT_COUNT] = { "bitmap", "dc", "event", "timer", "window", "thread", "change notification" };
+
+// --- Backend ---
+
+class PlatformBackend
+{
+public:
+    virtual ~PlatformBackend() {}
+
+    // A top-down 32-bit bitmap the CPU can write through bits
+    virtual PlatformHandle CreateBitmap(int width, int height, Pixel** bits) = 0;
+    virtual void DeleteBitmap(PlatformHandle bitmap) = 0;
+
+    // A memory device context to select bitmaps into; Select returns what it replaced
+    virtual PlatformHandle CreateContext() = 0;
+    virtual void DeleteContext(PlatformHandle dc) = 0;
+    virtual PlatformHandle Select(PlatformHandle dc, PlatformHandle object) = 0;
+    virtual void Text(PlatformHandle dc, int x, int y, const char* text, int length) = 0;
+
+    // Shows what is selected into dc in a layered window at (x, y), dirty being what changed
+    virtual void Present(PlatformHandle window, PlatformHandle dc, int x, int y, int width, int height, const IntRect& dirty) = 0;
+    virtual void ShowWindow(PlatformHandle window, bool show) = 0;
+
+    // Auto-reset events, and a one-shot timer armed dueNs from now
+    virtual PlatformHandle CreateSignal() = 0;
+    virtual void Signal(PlatformHandle signal) = 0;
+    virtual void CloseSignal(PlatformHandle signal) = 0;
+    virtual PlatformHandle CreateTimer() = 0;
+    virtual void ArmTimer(PlatformHandle timer, int64_t dueNs) = 0;
+    virtual void CancelTimer(PlatformHandle timer) = 0;
+    virtual void CloseTimer(PlatformHandle timer) = 0;
+
+    // Until one of the handles is signalled or, if messages is set, a window message arrives
+    virtual void Wait(const PlatformHandle* handles, int count, bool messages) = 0;
+
+    // How long ago the compositor's last refresh was, and the time between
+    // refreshes. False when nothing composes the desktop.
+    virtual bool RefreshTiming(int64_t* sinceVblankNs, int64_t* periodNs) = 0;
+};
+
+// --- Tracker ---
+
+struct PlatformFrameReport
+{
+    uint32_t calls[CALL_COUNT] = {};
+    int64_t callNs[CALL_COUNT] = {};
+    uint32_t created[OBJECT_COUNT] = {};
+    uint32_t destroyed[OBJECT_COUNT] = {};
+    int live = 0; // objects alive at the end of the frame
+
+    uint32_t TotalCalls() const
+    {
+        uint32_t n = 0;
+        for (int i = 0; i < CALL_COUNT; i++) n += calls[i];
+        return n;
+    }
+
+    int64_t TotalNs() const
+    {
+        int64_t ns = 0;
+        for (int i = 0; i < CALL_COUNT; i++) ns += callNs[i];
+        return ns;
+    }
+};
+
+class ResourceTracker
+{
+public:
+    // Any thread
+    void Call(PlatformCall call, int64_t ns)
+    {
+        calls[call].fetch_add(1, std::memory_order_relaxed);
+        callNs[call].fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void Created(PlatformObject kind, const void* handle)
+    {
+        std::lock_guard<std::mutex> lock(liveMutex);
+        LiveObject o;
+        o.kind = kind;
+        o.handle = handle;
+        o.frame = frame;
+        live.push_back(o);
+        created[kind].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // A handle that was never registered, or already destroyed, counts as a stray
+    void Destroyed(PlatformObject kind, const void* handle)
+    {
+        std::lock_guard<std::mutex> lock(liveMutex);
+        for (size_t i = 0; i < live.size(); i++)
+        {
+            if (live[i].kind == kind && live[i].handle == handle)
+            {
+                live[i] = live.back();
+                live.pop_back();
+                destroyed[kind].fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        strays++;
+    }
+
+    // Overlay thread: this frame's counts become LastFrame
+    void EndFrame()
+    {
+        PlatformFrameReport totals;
+        for (int i = 0; i < CALL_COUNT; i++)
+        {
+            totals.calls[i] = calls[i].load(std::memory_order_relaxed);
+            totals.callNs[i] = callNs[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < OBJECT_COUNT; i++)
+        {
+            totals.created[i] = created[i].load(std::memory_order_relaxed);
+            totals.destroyed[i] = destroyed[i].load(std::memory_order_relaxed);
+        }
+
+        for (int i = 0; i < CALL_COUNT; i++)
+        {
+            lastFrame.calls[i] = totals.calls[i] - frameStart.calls[i];
+            lastFrame.callNs[i] = totals.callNs[i] - frameStart.callNs[i];
+        }
+        for (int i = 0; i < OBJECT_COUNT; i++)
+        {
+            lastFrame.created[i] = totals.created[i] - frameStart.created[i];
+            lastFrame.destroyed[i] = totals.destroyed[i] - frameStart.destroyed[i];
+        }
+        lastFrame.live = LiveCount();
+        frameStart = totals;
+
+        std::lock_guard<std::mutex> lock(liveMutex);
+        frame++;
+    }
+
+    const PlatformFrameReport& LastFrame() const { return lastFrame; }
+
+    int LiveCount() const
+    {
+        std::lock_guard<std::mutex> lock(liveMutex);
+        return (int)live.size();
+    }
+
+    uint64_t CreatedCount(PlatformObject kind) const { return created[kind].load(std::memory_order_relaxed); }
+    uint64_t Calls(PlatformCall call) const { return calls[call].load(std::memory_order_relaxed); }
+    uint64_t Strays() const
+    {
+        std::lock_guard<std::mutex> lock(liveMutex);
+        return strays;
+    }
+
+    // Hands line() what is still alive, one object per newline-terminated
+    // line. Returns how many.
+    template <class LineFn>
+    int ForEachLeak(LineFn line) const
+    {
+        char text[160];
+        std::lock_guard<std::mutex> lock(liveMutex);
+        for (const LiveObject& o : live)
+        {
+            snprintf(text, sizeof(text), "leaked %s %p, created in frame %llu\n", PLATFORM_OBJECT_NAMES[o.kind], o.handle,
+                     (unsigned long long)o.frame);
+            line((const char*)text);
+        }
+        if (strays)
+        {
+            snprintf(text, sizeof(text), "%llu objects destroyed that were never created or already destroyed\n",
+                     (unsigned long long)strays);
+            line((const char*)text);
+        }
+        return (int)live.size();
+    }
+
+    // Lists what is still alive to a file. Returns how many.
+    int WriteLeaks(FILE* f) const
+    {
+        return ForEachLeak([f](const char* text) { fputs(text, f); });
+    }
+
+private:
+    struct LiveObject
+    {
+        PlatformObject kind;
+        const void* handle;
+        uint64_t frame;
+    };
+
+    std::atomic<uint64_t> calls[CALL_COUNT] = {};
+    std::atomic<int64_t> callNs[CALL_COUNT] = {};
+    std::atomic<uint64_t> created[OBJECT_COUNT] = {};
+    std::atomic<uint64_t> destroyed[OBJECT_COUNT] = {};
+
+    mutable std::mutex liveMutex;
+    std::vector<LiveObject> live;
+    uint64_t frame = 0;  // under liveMutex
+    uint64_t strays = 0; // under liveMutex
+
+    PlatformFrameReport frameStart; // totals as of the last EndFrame, overlay thread
+    PlatformFrameReport lastFrame;
+};
+
+// --- Tracked platform ---
+
+// Every call on the backend, counted and timed into the tracker
+class TrackedPlatform
+{
+public:
+    TrackedPlatform(PlatformBackend& backend, ResourceTracker& tracker, const Clock& clock)
+        : backend(backend), tracker(tracker), clock(clock) {}
+
+    PlatformHandle CreateBitmap(int width, int height, Pixel** bits)
+    {
+        CallScope call(*this, CALL_CREATE_BITMAP);
+        return Register(OBJECT_BITMAP, backend.CreateBitmap(width, height, bits));
+    }
+
+    void DeleteBitmap(PlatformHandle bitmap)
+    {
+        CallScope call(*this, CALL_DELETE_BITMAP);
+        tracker.Destroyed(OBJECT_BITMAP, bitmap);
+        backend.DeleteBitmap(bitmap);
+    }
+
+    PlatformHandle CreateContext()
+    {
+        CallScope call(*this, CALL_CREATE_CONTEXT);
+        return Register(OBJECT_CONTEXT, backend.CreateContext());
+    }
+
+    void DeleteContext(PlatformHandle dc)
+    {
+        CallScope call(*this, CALL_DELETE_CONTEXT);
+        tracker.Destroyed(OBJECT_CONTEXT, dc);
+        backend.DeleteContext(dc);
+    }
+
+    PlatformHandle Select(PlatformHandle dc, PlatformHandle object)
+    {
+        CallScope call(*this, CALL_SELECT);
+        return backend.Select(dc, object);
+    }
+
+    void Text(PlatformHandle dc, int x, int y, const char* text, int length)
+    {
+        CallScope call(*this, CALL_TEXT);
+        backend.Text(dc, x, y, text, length);
+    }
+
+    void Present(PlatformHandle window, PlatformHandle dc, int x, int y, int width, int height, const IntRect& dirty)
+    {
+        CallScope call(*this, CALL_PRESENT);
+        backend.Present(window, dc, x, y, width, height, dirty);
+    }
+
+    void ShowWindow(PlatformHandle window, bool show)
+    {
+        CallScope call(*this, CALL_SHOW_WINDOW);
+        backend.ShowWindow(window, show);
+    }
+
+    PlatformHandle CreateSignal()
+    {
+        CallScope call(*this, CALL_CREATE_SIGNAL);
+        return Register(OBJECT_SIGNAL, backend.CreateSignal());
+    }
+
+    void Signal(PlatformHandle signal)
+    {
+        CallScope call(*this, CALL_SIGNAL);
+        backend.Signal(signal);
+    }
+
+    void CloseSignal(PlatformHandle signal)
+    {
+        CallScope call(*this, CALL_CLOSE_SIGNAL);
+        tracker.Destroyed(OBJECT_SIGNAL, signal);
+        backend.CloseSignal(signal);
+    }
+
+    PlatformHandle CreateTimer()
+    {
+        CallScope call(*this, CALL_CREATE_TIMER);
+        return Register(OBJECT_TIMER, backend.CreateTimer());
+    }
+
+    void ArmTimer(PlatformHandle timer, int64_t dueNs)
+    {
+        CallScope call(*this, CALL_ARM_TIMER);
+        backend.ArmTimer(timer, dueNs);
+    }
+
+    void CancelTimer(PlatformHandle timer)
+    {
+        CallScope call(*this, CALL_CANCEL_TIMER);
+        backend.CancelTimer(timer);
+    }
+
+    void CloseTimer(PlatformHandle timer)
+    {
+        CallScope call(*this, CALL_CLOSE_TIMER);
+        tracker.Destroyed(OBJECT_TIMER, timer);
+        backend.CloseTimer(timer);
+    }
+
+    void Wait(const PlatformHandle* handles, int count, bool messages)
+    {
+        tracker.Call(CALL_WAIT, 0);
+        backend.Wait(handles, count, messages);
+    }
+
+    bool RefreshTiming(int64_t* sinceVblankNs, int64_t* periodNs)
+    {
+        CallScope call(*this, CALL_REFRESH_TIMING);
+        return backend.RefreshTiming(sinceVblankNs, periodNs);
+    }
+
+    ResourceTracker& Tracker() { return tracker; }
+
+private:
+    struct CallScope
+    {
+        CallScope(TrackedPlatform& platform, PlatformCall call) : platform(platform), call(call), start(platform.clock.NowNs()) {}
+        ~CallScope() { platform.tracker.Call(call, platform.clock.NowNs() - start); }
+
+        TrackedPlatform& platform;
+        PlatformCall call;
+        int64_t start;
+    };
+
+    PlatformHandle Register(PlatformObject kind, PlatformHandle handle)
+    {
+        if (handle)
+            tracker.Created(kind, handle);
+        return handle;
+    }
+
+    PlatformBackend& backend;
+    ResourceTracker& tracker;
+    const Clock& clock;
+};
+
+#endif //PLATFORM_H
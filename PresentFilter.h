@@ -0,0 +1,76 @@
+// PresentFilter.h: skips presenting frames that are already on screen.
+//
+// Damage comes from what the widgets report, not from their pixels, so a
+// repaint can land on exactly what was there before: an FPS readout that
+// rounds to the same text, a fade step too small to move a pixel. Each
+// window keeps a hash of every row of the frame it last presented. After a
+// repaint only the rows of the dirty rectangle are hashed again (see the hash
+// kernel in Raster.h). Rows that hash the same are trimmed off the rectangle
+// handed to the compositor, and a frame with no changed rows left is not
+// presented at all.
+
+#ifndef PRESENT_FILTER_H
+#define PRESENT_FILTER_H
+
+#include "Raster.h"
+#include <cstdint>
+#include <vector>
+
+struct PresentStats
+{
+    uint64_t presented = 0;
+    uint64_t skipped = 0;     // repainted to exactly what was presented
+    uint64_t hashedBytes = 0;
+    uint64_t presentedBytes = 0; // of the dirty rectangles presented
+};
+
+class PresentFilter
+{
+public:
+    // Forgets the presented frame, so the next one counts as changed throughout
+    void Reset() { rowHashes.clear(); }
+
+    // surface holds the whole new frame and dirty what was repainted. Narrows
+    // dirty to the rows that differ from the last frame passed here and
+    // returns whether there is anything to present. A window that moved
+    // (mustPresent) is always presented, whole if nothing else changed.
+    bool ShouldPresent(const Surface& surface, IntRect& dirty, bool mustPresent, PresentStats& stats)
+    {
+        bool known = rowHashes.size() == (size_t)surface.height;
+        if (!known)
+            rowHashes.assign((size_t)surface.height, 0);
+
+        IntRect rows = RectIntersect(dirty, surface.Bounds());
+        const RasterKernels& k = ActiveRasterKernels();
+        int top = rows.bottom, bottom = rows.top;
+        for (int y = rows.top; y < rows.bottom; y++)
+        {
+            uint64_t h = k.hashSpan(surface.pixels + (size_t)y * surface.stride, surface.width, 0);
+            if (known && h == rowHashes[y])
+                continue;
+            rowHashes[y] = h;
+            if (y < top) top = y;
+            bottom = y + 1;
+        }
+        if (!rows.IsEmpty())
+            stats.hashedBytes += (uint64_t)rows.Height() * surface.width * sizeof(Pixel);
+
+        if (top < bottom)
+            dirty = MakeRect(rows.left, top, rows.right, bottom);
+        else if (mustPresent)
+            dirty = surface.Bounds();
+        else
+        {
+            stats.skipped++;
+            return false;
+        }
+        stats.presented++;
+        stats.presentedBytes += (uint64_t)dirty.Area() * sizeof(Pixel);
+        return true;
+    }
+
+private:
+    std::vector<uint64_t> rowHashes; // of the last frame passed in, one per row
+};
+
+#endif //PRESENT_FILTER_H
@@ -0,0 +1,401 @@
+// Profiles.h: named settings profiles, kept in one binary file.
+//
+// The file is a fixed header and an array of fixed-size records, one per
+// profile, laid out exactly as the structs below, so loading it is mapping it,
+// checking the header and copying the records out: there is nothing to parse.
+// The copy is what lets go of the file straight away, so an editor can save
+// over it while the overlay runs, and a reload is another map and copy.
+//
+// The header carries a checksum of the records. A file caught halfway through
+// being written fails it and is ignored; the writer finishing changes the file
+// again, and that reload picks it up. Switching profiles reads one record.
+//
+// Records hold what a profile sets, not the menu's state. A field added later
+// takes a reserved slot and bumps PROFILE_VERSION.
+
+#ifndef PROFILES_H
+#define PROFILES_H
+
+#include "Widgets.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char PROFILE_MAGIC[8] = { 'A', 'S', 'T', 'R', 'P', 'R', 'F', '1' };
+const uint32_t PROFILE_VERSION = 1;
+const int PROFILE_NAME_LENGTH = 32; // including the terminating zero
+const int PROFILE_DEFAULT_COUNT = 4; // in a file the overlay creates
+const int PROFILE_MAX_COUNT = 256;
+
+struct ProfileFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t count;
+    uint32_t checksum; // of the records that follow
+    uint32_t reserved[2];
+};
+
+struct ProfileRecord
+{
+    char name[PROFILE_NAME_LENGTH];
+    int32_t crosshairEnabled;
+    int32_t crosshairSize;
+    int32_t crosshairGap;
+    int32_t crosshairShape;
+    int32_t colorR, colorG, colorB;
+    int32_t rainbowEnabled;
+    int32_t watermarkEnabled;
+    int32_t scopeOverlayEnabled;
+    int32_t scopeRadius;
+    int32_t scopeOffsetX;
+    int32_t scopeOffsetY;
+    int32_t scopeVignetteWidth;
+    int32_t reserved[10];
+};
+
+static_assert(sizeof(ProfileFileHeader) == 32, "profile file header layout");
+static_assert(sizeof(ProfileRecord) == 128, "profile record layout");
+
+// FNV-1a
+inline uint32_t ProfileChecksum(const void* data, size_t size)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+        h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+inline ProfileRecord MakeProfileRecord(const char* name, const OverlaySettings& s)
+{
+    ProfileRecord r;
+    memset(&r, 0, sizeof(r));
+    for (int i = 0; i < PROFILE_NAME_LENGTH - 1 && name[i]; i++)
+        r.name[i] = name[i];
+    r.crosshairEnabled = s.crosshairEnabled;
+    r.crosshairSize = s.crosshairSize;
+    r.crosshairGap = s.crosshairGap;
+    r.crosshairShape = s.crosshairShape;
+    r.colorR = s.colorR;
+    r.colorG = s.colorG;
+    r.colorB = s.colorB;
+    r.rainbowEnabled = s.rainbowEnabled;
+    r.watermarkEnabled = s.watermarkEnabled;
+    r.scopeOverlayEnabled = s.scopeOverlayEnabled;
+    r.scopeRadius = s.scopeRadius;
+    r.scopeOffsetX = s.scopeOffsetX;
+    r.scopeOffsetY = s.scopeOffsetY;
+    r.scopeVignetteWidth = s.scopeVignetteWidth;
+    return r;
+}
+
+// The settings a profile sets, on top of the defaults. Values are held to
+// what the menu could have set, so a hand-edited file can't draw a
+// crosshair the menu can't reach.
+inline OverlaySettings ProfileSettings(const ProfileRecord& r)
+{
+    OverlaySettings s;
+    s.crosshairEnabled = r.crosshairEnabled != 0;
+    s.crosshairSize = r.crosshairSize;
+    s.crosshairGap = r.crosshairGap;
+    s.crosshairShape = (CrosshairShape)r.crosshairShape;
+    s.colorR = r.colorR;
+    s.colorG = r.colorG;
+    s.colorB = r.colorB;
+    s.rainbowEnabled = r.rainbowEnabled != 0;
+    s.watermarkEnabled = r.watermarkEnabled != 0;
+    s.scopeOverlayEnabled = r.scopeOverlayEnabled != 0;
+    s.scopeRadius = r.scopeRadius;
+    s.scopeOffsetX = r.scopeOffsetX;
+    s.scopeOffsetY = r.scopeOffsetY;
+    s.scopeVignetteWidth = r.scopeVignetteWidth < 0 ? 0 : r.scopeVignetteWidth > 4 * SCOPE_VIGNETTE_WIDTH ? 4 * SCOPE_VIGNETTE_WIDTH : r.scopeVignetteWidth;
+
+    for (int i = 0; i < MENU_ITEM_COUNT; i++)
+    {
+        const MenuItem& item = MENU_ITEMS[i];
+        int value = item.get(s);
+        if (value < item.minValue) item.set(s, item.minValue);
+        if (value > item.maxValue) item.set(s, item.maxValue);
+    }
+    return s;
+}
+
+// --- Files ---
+
+// A file mapped read-only for as long as this lives
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file can't be opened or is empty
+    bool Open(const char* path)
+    {
+        Close();
+#ifdef _WIN32
+        // Shared every way, so writers and renames aren't held up while it is open
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+            data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        size = (size_t)fileSize.QuadPart;
+#else
+        file = open(path, O_RDONLY);
+        if (file < 0)
+            return false;
+        struct stat st;
+        if (fstat(file, &st) != 0 || st.st_size == 0)
+        {
+            Close();
+            return false;
+        }
+        void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (view != MAP_FAILED)
+            data = (const uint8_t*)view;
+        size = (size_t)st.st_size;
+#endif
+        if (!data)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data) munmap((void*)data, size);
+        if (file >= 0) close(file);
+        file = -1;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int file = -1;
+#endif
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// When a file was last written and how big it is; a change to either means
+// it is worth reading again
+struct FileStamp
+{
+    bool exists = false;
+    int64_t writeTime = 0; // in the platform's units
+    int64_t size = 0;
+
+    bool operator==(const FileStamp& o) const { return exists == o.exists && writeTime == o.writeTime && size == o.size; }
+    bool operator!=(const FileStamp& o) const { return !(*this == o); }
+};
+
+inline FileStamp GetFileStamp(const char* path)
+{
+    FileStamp stamp;
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info))
+        return stamp;
+    stamp.writeTime = (int64_t)info.ftLastWriteTime.dwHighDateTime << 32 | info.ftLastWriteTime.dwLowDateTime;
+    stamp.size = (int64_t)info.nFileSizeHigh << 32 | info.nFileSizeLow;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return stamp;
+    stamp.writeTime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    stamp.size = (int64_t)st.st_size;
+#endif
+    stamp.exists = true;
+    return stamp;
+}
+
+// Writes a whole profile file next to path and moves it into place, so a
+// reader never maps half of it. Returns false if it can't be written.
+inline bool WriteProfileFile(const char* path, const std::vector<ProfileRecord>& records)
+{
+    ProfileFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PROFILE_MAGIC, sizeof(PROFILE_MAGIC));
+    header.version = PROFILE_VERSION;
+    header.recordSize = sizeof(ProfileRecord);
+    header.count = (uint32_t)records.size();
+    header.checksum = ProfileChecksum(records.data(), records.size() * sizeof(ProfileRecord));
+
+    std::string temp = std::string(path) + ".tmp";
+    FILE* f = nullptr;
+#if defined(_MSC_VER)
+    if (fopen_s(&f, temp.c_str(), "wb") != 0) f = nullptr;
+#else
+    f = fopen(temp.c_str(), "wb");
+#endif
+    if (!f) return false;
+    bool written = fwrite(&header, sizeof(header), 1, f) == 1 &&
+                   fwrite(records.data(), sizeof(ProfileRecord), records.size(), f) == records.size();
+    written = fclose(f) == 0 && written;
+    if (!written)
+    {
+        remove(temp.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    return MoveFileExA(temp.c_str(), path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(temp.c_str(), path) == 0;
+#endif
+}
+
+// --- Store ---
+
+// The profiles of one file and which of them is active
+class ProfileStore
+{
+public:
+    // Reads the profiles from path and keeps watching it. Returns false if
+    // there is no valid profile file there (yet); SaveActive creates one.
+    bool Load(const char* filePath)
+    {
+        path = filePath;
+        records.clear();
+        active = 0;
+        return Read();
+    }
+
+    // Reads the file again if it changed since it was last read, as a
+    // file-change notification prompts. Returns true if the active profile
+    // now holds different settings; other profiles changing returns false.
+    bool ReloadIfChanged()
+    {
+        if (path.empty() || GetFileStamp(path.c_str()) == stamp)
+            return false;
+        ProfileRecord before = records.empty() ? ProfileRecord() : records[active];
+        bool hadActive = !records.empty();
+        if (!Read())
+            return false;
+        return !hadActive || memcmp(&before, &records[active], sizeof(ProfileRecord)) != 0;
+    }
+
+    // Moves the active profile delta places on, wrapping around. Returns
+    // false if there is no other profile to move to.
+    bool Step(int delta)
+    {
+        int count = Count();
+        if (count < 2) return false;
+        active = ((active + delta) % count + count) % count;
+        return true;
+    }
+
+    // Stores the settings into the active profile and writes the file,
+    // creating it with PROFILE_DEFAULT_COUNT profiles if there is none
+    bool SaveActive(const OverlaySettings& s)
+    {
+        if (records.empty())
+        {
+            for (int i = 0; i < PROFILE_DEFAULT_COUNT; i++)
+            {
+                char name[PROFILE_NAME_LENGTH];
+                sprintf_s(name, "Profile %d", i + 1);
+                records.push_back(MakeProfileRecord(name, OverlaySettings()));
+            }
+        }
+        char name[PROFILE_NAME_LENGTH];
+        memcpy(name, records[active].name, sizeof(name));
+        name[PROFILE_NAME_LENGTH - 1] = 0;
+        records[active] = MakeProfileRecord(name, s);
+        if (!WriteProfileFile(path.c_str(), records))
+            return false;
+        stamp = GetFileStamp(path.c_str()); // already holds what was written
+        return true;
+    }
+
+    int Count() const { return (int)records.size(); }
+    int Active() const { return active; }
+    bool HasActive() const { return !records.empty(); }
+    const ProfileRecord& Record(int i) const { return records[i]; }
+    const ProfileRecord& ActiveRecord() const { return records[active]; }
+    const std::string& Path() const { return path; }
+    uint64_t Reloads() const { return reloads; }
+
+private:
+    // Maps the file and copies its records out. Leaves the profiles as they
+    // were if the file is missing or isn't whole.
+    bool Read()
+    {
+        FileStamp current = GetFileStamp(path.c_str());
+        MappedFile file;
+        if (!file.Open(path.c_str()))
+            return false;
+        if (file.Size() < sizeof(ProfileFileHeader))
+            return false;
+
+        const ProfileFileHeader* header = (const ProfileFileHeader*)file.Data();
+        size_t recordBytes = (size_t)header->count * sizeof(ProfileRecord);
+        if (memcmp(header->magic, PROFILE_MAGIC, sizeof(PROFILE_MAGIC)) != 0 || header->version != PROFILE_VERSION ||
+            header->recordSize != sizeof(ProfileRecord) || header->count == 0 || header->count > PROFILE_MAX_COUNT ||
+            file.Size() < sizeof(ProfileFileHeader) + recordBytes)
+            return false;
+
+        const uint8_t* first = file.Data() + sizeof(ProfileFileHeader);
+        if (ProfileChecksum(first, recordBytes) != header->checksum)
+            return false;
+
+        records.resize(header->count);
+        memcpy(records.data(), first, recordBytes);
+        for (ProfileRecord& r : records)
+            r.name[PROFILE_NAME_LENGTH - 1] = 0;
+        if (active >= Count())
+            active = Count() - 1;
+        stamp = current;
+        reloads++;
+        return true;
+    }
+
+    std::string path;
+    std::vector<ProfileRecord> records;
+    int active = 0;
+    FileStamp stamp;      // of the file as last read or written
+    uint64_t reloads = 0; // times the file was read
+};
+
+#endif //PROFILES_H
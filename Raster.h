@@ -0,0 +1,1318 @@
+// Raster.h: software rasterizer for the overlay's premultiplied BGRA surfaces.
+//
+// Everything is drawn into plain 32bpp memory laid out like a top-down DIB, so
+// the alpha channel UpdateLayeredWindow reads is always meaningful. Shapes are
+// turned into rows of spans: fully covered runs go through the fill or blend
+// kernel, anti-aliased edges through the coverage-mask kernel, cached
+// bitmaps through the pixel blend kernel and text through the shadowed mask
+// kernel. The scope is not built from shapes at all: one kernel evaluates its
+// distance field per pixel. Two last kernels hash pixels and turn them back
+// to straight alpha instead of drawing them. Each kernel has scalar, SSE2 and
+// AVX2 versions picked at runtime, and all three produce the same pixels (and
+// hashes).
+// A surface can also record instead of draw: every primitive then appends
+// itself to a DrawList, which can be replayed later, in pieces and on other
+// threads (see Compositor.h).
+// There is no Windows dependency here so the rasterizer can be tested and
+// benchmarked headless.
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "Geometry.h"
+#include "Memory.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RASTER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define RASTER_TARGET_SSE2
+#define RASTER_TARGET_AVX2
+#else
+#define RASTER_TARGET_SSE2 __attribute__((target("sse2")))
+#define RASTER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Premultiplied pixel, 0xAARRGGBB (B, G, R, A in memory like a 32bpp DIB)
+typedef uint32_t Pixel;
+
+// Rounded x / 255 for x in [0, 255 * 255]
+inline uint32_t MulDiv255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+inline Pixel PremultipliedColor(int r, int g, int b, int a = 255)
+{
+    return (Pixel)a << 24 | MulDiv255(r * a) << 16 | MulDiv255(g * a) << 8 | MulDiv255(b * a);
+}
+
+// Scales all four channels of a pixel by scale / 255
+inline Pixel ScalePixel(Pixel p, uint32_t scale)
+{
+    uint32_t rb = (p & 0x00FF00FF) * scale + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    uint32_t ag = ((p >> 8) & 0x00FF00FF) * scale + 0x00800080;
+    ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+    return rb | ag;
+}
+
+inline float Clamp01(float v)
+{
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+// Premultiplied source-over
+inline Pixel BlendPixel(Pixel dst, Pixel src)
+{
+    return src + ScalePixel(dst, 255 - (src >> 24));
+}
+
+// --- Span kernels ---
+
+inline void FillSpanScalar(Pixel* dst, int count, Pixel color)
+{
+    for (int i = 0; i < count; i++)
+        dst[i] = color;
+}
+
+inline void BlendSpanScalar(Pixel* dst, int count, Pixel color)
+{
+    uint32_t inv = 255 - (color >> 24);
+    for (int i = 0; i < count; i++)
+        dst[i] = color + ScalePixel(dst[i], inv);
+}
+
+inline void BlendMaskSpanScalar(Pixel* dst, const uint8_t* mask, int count, Pixel color)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t m = mask[i];
+        if (!m) continue;
+        Pixel src = m == 255 ? color : ScalePixel(color, m);
+        dst[i] = BlendPixel(dst[i], src);
+    }
+}
+
+// Source-over of a row of premultiplied pixels
+inline void BlendPixelSpanScalar(Pixel* dst, const Pixel* src, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        Pixel p = src[i];
+        uint32_t a = p >> 24;
+        if (a == 255) dst[i] = p;
+        else if (p) dst[i] = BlendPixel(dst[i], p);
+    }
+}
+
+// Text with a drop shadow in one pass: shadow coverage in shadowColor under
+// mask coverage in color, both composited over dst together
+inline void BlendShadowMaskSpanScalar(Pixel* dst, const uint8_t* mask, const uint8_t* shadowMask, int count,
+                                      Pixel color, Pixel shadowColor)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t m = mask[i], sm = shadowMask[i];
+        if (!(m | sm)) continue;
+        Pixel text = ScalePixel(color, m);
+        Pixel src = text + ScalePixel(ScalePixel(shadowColor, sm), 255 - (text >> 24));
+        dst[i] = BlendPixel(dst[i], src);
+    }
+}
+
+// A scope as a distance field around its centre: a white anti-aliased ring,
+// a black vignette fading out beyond it and a white reticle through the middle
+struct ScopeField
+{
+    float radius = 100.0f;          // centre line of the ring
+    float ringHalfWidth = 1.5f;
+    float vignetteWidth = 50.0f;    // falloff from the ring's centre line to nothing, > 0
+    float vignetteAlpha = 0.3f;     // 0..1, at the ring
+    float lineHalfWidth = 0.5f;     // reticle lines, which run out to the ring's centre line
+};
+
+// White coverage and total alpha of the scope at (x, y) from its centre,
+// for the whole row y's shared terms precomputed by the caller
+inline Pixel ScopeFieldPixel(float x, float y2, float horizontal, float vertical, const ScopeField& f, float invWidth)
+{
+    float d = sqrtf(x * x + y2);
+    float ring = Clamp01(f.ringHalfWidth + 0.5f - fabsf(d - f.radius));
+    float vert = Clamp01(f.lineHalfWidth + 0.5f - fabsf(x)) * vertical;
+    float horz = horizontal * Clamp01(f.radius + 0.5f - fabsf(x));
+    float white = 1.0f - (1.0f - ring) * (1.0f - vert) * (1.0f - horz);
+    float shade = f.vignetteAlpha * Clamp01(d - f.radius + 0.5f) * Clamp01((f.radius + f.vignetteWidth - d) * invWidth);
+    float alpha = white + shade * (1.0f - white);
+    uint32_t a = (uint32_t)(alpha * 255.0f + 0.5f);
+    uint32_t c = (uint32_t)(white * 255.0f + 0.5f);
+    return a << 24 | c * 0x010101;
+}
+
+// count pixels of row y of the scope, starting x pixels right of its centre
+inline void ScopeFieldSpanScalar(Pixel* dst, int count, float x, float y, const ScopeField& f)
+{
+    float ay = fabsf(y);
+    float horizontal = Clamp01(f.lineHalfWidth + 0.5f - ay);
+    float vertical = Clamp01(f.radius + 0.5f - ay);
+    float invWidth = 1.0f / f.vignetteWidth;
+    for (int i = 0; i < count; i++)
+    {
+        Pixel src = ScopeFieldPixel(x + i, y * y, horizontal, vertical, f, invWidth);
+        uint32_t a = src >> 24;
+        if (a == 255) dst[i] = src;
+        else if (a) dst[i] = BlendPixel(dst[i], src);
+    }
+}
+
+#ifdef RASTER_X86
+
+RASTER_TARGET_SSE2 inline __m128i Div255Epu16(__m128i x)
+{
+    return _mm_mulhi_epu16(_mm_add_epi16(x, _mm_set1_epi16(128)), _mm_set1_epi16(257));
+}
+
+// Broadcasts each pixel's alpha lane over its four 16-bit channels
+RASTER_TARGET_SSE2 inline __m128i AlphaEpu16(__m128i x)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xFF), 0xFF);
+}
+
+RASTER_TARGET_SSE2 inline void FillSpanSSE2(Pixel* dst, int count, Pixel color)
+{
+    __m128i c = _mm_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i*)(dst + i), c);
+    for (; i < count; i++)
+        dst[i] = color;
+}
+
+RASTER_TARGET_SSE2 inline void BlendSpanSSE2(Pixel* dst, int count, Pixel color)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i src = _mm_set1_epi32((int)color);
+    __m128i inv = _mm_set1_epi16((short)(255 - (color >> 24)));
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i lo = Div255Epu16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv));
+        __m128i hi = Div255Epu16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi8(_mm_packus_epi16(lo, hi), src));
+    }
+    BlendSpanScalar(dst + i, count - i, color);
+}
+
+RASTER_TARGET_SSE2 inline void BlendMaskSpanSSE2(Pixel* dst, const uint8_t* mask, int count, Pixel color)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i c16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+    __m128i full = _mm_set1_epi16(255);
+    bool opaque = (color >> 24) == 255;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32_t m4;
+        memcpy(&m4, mask + i, 4);
+        if (m4 == 0) continue;
+        if (m4 == 0xFFFFFFFF && opaque)
+        {
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_set1_epi32((int)color));
+            continue;
+        }
+
+        // Spread each coverage byte over its pixel's four channels
+        __m128i m = _mm_cvtsi32_si128((int)m4);
+        m = _mm_unpacklo_epi8(m, m);
+        m = _mm_unpacklo_epi16(m, m);
+
+        __m128i sLo = Div255Epu16(_mm_mullo_epi16(c16, _mm_unpacklo_epi8(m, zero)));
+        __m128i sHi = Div255Epu16(_mm_mullo_epi16(c16, _mm_unpackhi_epi8(m, zero)));
+
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i dLo = Div255Epu16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(full, AlphaEpu16(sLo))));
+        __m128i dHi = Div255Epu16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(full, AlphaEpu16(sHi))));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_add_epi16(dLo, sLo), _mm_add_epi16(dHi, sHi)));
+    }
+    BlendMaskSpanScalar(dst + i, mask + i, count - i, color);
+}
+
+RASTER_TARGET_SSE2 inline void BlendShadowMaskSpanSSE2(Pixel* dst, const uint8_t* mask, const uint8_t* shadowMask, int count,
+                                                        Pixel color, Pixel shadowColor)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i c16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+    __m128i sc16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)shadowColor), zero);
+    __m128i full = _mm_set1_epi16(255);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32_t m4, s4;
+        memcpy(&m4, mask + i, 4);
+        memcpy(&s4, shadowMask + i, 4);
+        if ((m4 | s4) == 0) continue;
+
+        __m128i m = _mm_cvtsi32_si128((int)m4);
+        m = _mm_unpacklo_epi8(m, m);
+        m = _mm_unpacklo_epi16(m, m);
+        __m128i sm = _mm_cvtsi32_si128((int)s4);
+        sm = _mm_unpacklo_epi8(sm, sm);
+        sm = _mm_unpacklo_epi16(sm, sm);
+
+        // Text over shadow first, then the pair over the destination
+        __m128i tLo = Div255Epu16(_mm_mullo_epi16(c16, _mm_unpacklo_epi8(m, zero)));
+        __m128i tHi = Div255Epu16(_mm_mullo_epi16(c16, _mm_unpackhi_epi8(m, zero)));
+        __m128i shLo = Div255Epu16(_mm_mullo_epi16(sc16, _mm_unpacklo_epi8(sm, zero)));
+        __m128i shHi = Div255Epu16(_mm_mullo_epi16(sc16, _mm_unpackhi_epi8(sm, zero)));
+        __m128i sLo = _mm_add_epi16(tLo, Div255Epu16(_mm_mullo_epi16(shLo, _mm_sub_epi16(full, AlphaEpu16(tLo)))));
+        __m128i sHi = _mm_add_epi16(tHi, Div255Epu16(_mm_mullo_epi16(shHi, _mm_sub_epi16(full, AlphaEpu16(tHi)))));
+
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i dLo = Div255Epu16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(full, AlphaEpu16(sLo))));
+        __m128i dHi = Div255Epu16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(full, AlphaEpu16(sHi))));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_add_epi16(dLo, sLo), _mm_add_epi16(dHi, sHi)));
+    }
+    BlendShadowMaskSpanScalar(dst + i, mask + i, shadowMask + i, count - i, color, shadowColor);
+}
+
+RASTER_TARGET_SSE2 inline void BlendPixelSpanSSE2(Pixel* dst, const Pixel* src, int count)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i full = _mm_set1_epi16(255);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i sv = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i invLo = _mm_sub_epi16(full, AlphaEpu16(_mm_unpacklo_epi8(sv, zero)));
+        __m128i invHi = _mm_sub_epi16(full, AlphaEpu16(_mm_unpackhi_epi8(sv, zero)));
+        __m128i lo = Div255Epu16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), invLo));
+        __m128i hi = Div255Epu16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), invHi));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi8(_mm_packus_epi16(lo, hi), sv));
+    }
+    BlendPixelSpanScalar(dst + i, src + i, count - i);
+}
+
+RASTER_TARGET_SSE2 inline __m128 Clamp01SSE2(__m128 v)
+{
+    return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+RASTER_TARGET_SSE2 inline __m128 AbsSSE2(__m128 v)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+// Same arithmetic as ScopeFieldPixel, in the same order, four pixels at a time
+RASTER_TARGET_SSE2 inline void ScopeFieldSpanSSE2(Pixel* dst, int count, float x, float y, const ScopeField& f)
+{
+    float ay = fabsf(y);
+    float horizontalS = Clamp01(f.lineHalfWidth + 0.5f - ay);
+    float verticalS = Clamp01(f.radius + 0.5f - ay);
+    float invWidthS = 1.0f / f.vignetteWidth;
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 y2 = _mm_set1_ps(y * y);
+    __m128 horizontal = _mm_set1_ps(horizontalS), vertical = _mm_set1_ps(verticalS), invWidth = _mm_set1_ps(invWidthS);
+    __m128 radius = _mm_set1_ps(f.radius);
+    __m128 ringReach = _mm_set1_ps(f.ringHalfWidth + 0.5f);
+    __m128 lineReach = _mm_set1_ps(f.lineHalfWidth + 0.5f);
+    __m128 lineEnd = _mm_set1_ps(f.radius + 0.5f);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 outer = _mm_set1_ps(f.radius + f.vignetteWidth);
+    __m128 shadeAlpha = _mm_set1_ps(f.vignetteAlpha);
+    __m128 scale = _mm_set1_ps(255.0f);
+    __m128i zero = _mm_setzero_si128();
+    __m128i full = _mm_set1_epi16(255);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 px = _mm_add_ps(_mm_set1_ps(x), _mm_cvtepi32_ps(_mm_setr_epi32(i, i + 1, i + 2, i + 3)));
+        __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(px, px), y2));
+        __m128 ring = Clamp01SSE2(_mm_sub_ps(ringReach, AbsSSE2(_mm_sub_ps(d, radius))));
+        __m128 vert = _mm_mul_ps(Clamp01SSE2(_mm_sub_ps(lineReach, AbsSSE2(px))), vertical);
+        __m128 horz = _mm_mul_ps(horizontal, Clamp01SSE2(_mm_sub_ps(lineEnd, AbsSSE2(px))));
+        __m128 clear = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(one, ring), _mm_sub_ps(one, vert)), _mm_sub_ps(one, horz));
+        __m128 white = _mm_sub_ps(one, clear);
+        __m128 shade = _mm_mul_ps(_mm_mul_ps(shadeAlpha, Clamp01SSE2(_mm_add_ps(_mm_sub_ps(d, radius), half))),
+                                  Clamp01SSE2(_mm_mul_ps(_mm_sub_ps(outer, d), invWidth)));
+        __m128 alpha = _mm_add_ps(white, _mm_mul_ps(shade, _mm_sub_ps(one, white)));
+
+        __m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(alpha, scale), half));
+        __m128i c = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(white, scale), half));
+        __m128i sv = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(a, 24), _mm_slli_epi32(c, 16)), _mm_or_si128(_mm_slli_epi32(c, 8), c));
+
+        __m128i dv = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i invLo = _mm_sub_epi16(full, AlphaEpu16(_mm_unpacklo_epi8(sv, zero)));
+        __m128i invHi = _mm_sub_epi16(full, AlphaEpu16(_mm_unpackhi_epi8(sv, zero)));
+        __m128i lo = Div255Epu16(_mm_mullo_epi16(_mm_unpacklo_epi8(dv, zero), invLo));
+        __m128i hi = Div255Epu16(_mm_mullo_epi16(_mm_unpackhi_epi8(dv, zero), invHi));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi8(_mm_packus_epi16(lo, hi), sv));
+    }
+    ScopeFieldSpanScalar(dst + i, count - i, x + i, y, f);
+}
+
+RASTER_TARGET_AVX2 inline __m256i Div255Epu16x8(__m256i x)
+{
+    return _mm256_mulhi_epu16(_mm256_add_epi16(x, _mm256_set1_epi16(128)), _mm256_set1_epi16(257));
+}
+
+RASTER_TARGET_AVX2 inline __m256i AlphaEpu16x8(__m256i x)
+{
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, 0xFF), 0xFF);
+}
+
+RASTER_TARGET_AVX2 inline void FillSpanAVX2(Pixel* dst, int count, Pixel color)
+{
+    __m256i c = _mm256_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_si256((__m256i*)(dst + i), c);
+    for (; i < count; i++)
+        dst[i] = color;
+}
+
+RASTER_TARGET_AVX2 inline void BlendSpanAVX2(Pixel* dst, int count, Pixel color)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i src = _mm256_set1_epi32((int)color);
+    __m256i inv = _mm256_set1_epi16((short)(255 - (color >> 24)));
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i lo = Div255Epu16x8(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), inv));
+        __m256i hi = Div255Epu16x8(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), inv));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi8(_mm256_packus_epi16(lo, hi), src));
+    }
+    BlendSpanScalar(dst + i, count - i, color);
+}
+
+RASTER_TARGET_AVX2 inline void BlendMaskSpanAVX2(Pixel* dst, const uint8_t* mask, int count, Pixel color)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i c16 = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)color), zero);
+    __m256i full = _mm256_set1_epi16(255);
+    bool opaque = (color >> 24) == 255;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        uint64_t m8;
+        memcpy(&m8, mask + i, 8);
+        if (m8 == 0) continue;
+        if (m8 == ~0ULL && opaque)
+        {
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_set1_epi32((int)color));
+            continue;
+        }
+
+        // Pixels 0-3 live in the low 128-bit lane and 4-7 in the high one
+        __m128i m = _mm_loadl_epi64((const __m128i*)(mask + i));
+        m = _mm_unpacklo_epi8(m, m);
+        __m256i mm = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(m, m)), _mm_unpackhi_epi16(m, m), 1);
+
+        __m256i sLo = Div255Epu16x8(_mm256_mullo_epi16(c16, _mm256_unpacklo_epi8(mm, zero)));
+        __m256i sHi = Div255Epu16x8(_mm256_mullo_epi16(c16, _mm256_unpackhi_epi8(mm, zero)));
+
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i dLo = Div255Epu16x8(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), _mm256_sub_epi16(full, AlphaEpu16x8(sLo))));
+        __m256i dHi = Div255Epu16x8(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), _mm256_sub_epi16(full, AlphaEpu16x8(sHi))));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(_mm256_add_epi16(dLo, sLo), _mm256_add_epi16(dHi, sHi)));
+    }
+    BlendMaskSpanScalar(dst + i, mask + i, count - i, color);
+}
+
+// Eight coverage bytes spread over their pixels' channels, pixels 0-3 in the low lane
+RASTER_TARGET_AVX2 inline __m256i SpreadMaskAVX2(const uint8_t* mask)
+{
+    __m128i m = _mm_loadl_epi64((const __m128i*)mask);
+    m = _mm_unpacklo_epi8(m, m);
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(m, m)), _mm_unpackhi_epi16(m, m), 1);
+}
+
+RASTER_TARGET_AVX2 inline void BlendShadowMaskSpanAVX2(Pixel* dst, const uint8_t* mask, const uint8_t* shadowMask, int count,
+                                                        Pixel color, Pixel shadowColor)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i c16 = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)color), zero);
+    __m256i sc16 = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)shadowColor), zero);
+    __m256i full = _mm256_set1_epi16(255);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        uint64_t m8, s8;
+        memcpy(&m8, mask + i, 8);
+        memcpy(&s8, shadowMask + i, 8);
+        if ((m8 | s8) == 0) continue;
+
+        __m256i m = SpreadMaskAVX2(mask + i);
+        __m256i sm = SpreadMaskAVX2(shadowMask + i);
+
+        // Text over shadow first, then the pair over the destination
+        __m256i tLo = Div255Epu16x8(_mm256_mullo_epi16(c16, _mm256_unpacklo_epi8(m, zero)));
+        __m256i tHi = Div255Epu16x8(_mm256_mullo_epi16(c16, _mm256_unpackhi_epi8(m, zero)));
+        __m256i shLo = Div255Epu16x8(_mm256_mullo_epi16(sc16, _mm256_unpacklo_epi8(sm, zero)));
+        __m256i shHi = Div255Epu16x8(_mm256_mullo_epi16(sc16, _mm256_unpackhi_epi8(sm, zero)));
+        __m256i sLo = _mm256_add_epi16(tLo, Div255Epu16x8(_mm256_mullo_epi16(shLo, _mm256_sub_epi16(full, AlphaEpu16x8(tLo)))));
+        __m256i sHi = _mm256_add_epi16(tHi, Div255Epu16x8(_mm256_mullo_epi16(shHi, _mm256_sub_epi16(full, AlphaEpu16x8(tHi)))));
+
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i dLo = Div255Epu16x8(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), _mm256_sub_epi16(full, AlphaEpu16x8(sLo))));
+        __m256i dHi = Div255Epu16x8(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), _mm256_sub_epi16(full, AlphaEpu16x8(sHi))));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(_mm256_add_epi16(dLo, sLo), _mm256_add_epi16(dHi, sHi)));
+    }
+    BlendShadowMaskSpanScalar(dst + i, mask + i, shadowMask + i, count - i, color, shadowColor);
+}
+
+RASTER_TARGET_AVX2 inline void BlendPixelSpanAVX2(Pixel* dst, const Pixel* src, int count)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i full = _mm256_set1_epi16(255);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i sv = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i invLo = _mm256_sub_epi16(full, AlphaEpu16x8(_mm256_unpacklo_epi8(sv, zero)));
+        __m256i invHi = _mm256_sub_epi16(full, AlphaEpu16x8(_mm256_unpackhi_epi8(sv, zero)));
+        __m256i lo = Div255Epu16x8(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), invLo));
+        __m256i hi = Div255Epu16x8(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), invHi));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi8(_mm256_packus_epi16(lo, hi), sv));
+    }
+    BlendPixelSpanScalar(dst + i, src + i, count - i);
+}
+
+RASTER_TARGET_AVX2 inline __m256 Clamp01AVX2(__m256 v)
+{
+    return _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+}
+
+RASTER_TARGET_AVX2 inline __m256 AbsAVX2(__m256 v)
+{
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+}
+
+RASTER_TARGET_AVX2 inline void ScopeFieldSpanAVX2(Pixel* dst, int count, float x, float y, const ScopeField& f)
+{
+    float ay = fabsf(y);
+    float horizontalS = Clamp01(f.lineHalfWidth + 0.5f - ay);
+    float verticalS = Clamp01(f.radius + 0.5f - ay);
+    float invWidthS = 1.0f / f.vignetteWidth;
+
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 y2 = _mm256_set1_ps(y * y);
+    __m256 horizontal = _mm256_set1_ps(horizontalS), vertical = _mm256_set1_ps(verticalS), invWidth = _mm256_set1_ps(invWidthS);
+    __m256 radius = _mm256_set1_ps(f.radius);
+    __m256 ringReach = _mm256_set1_ps(f.ringHalfWidth + 0.5f);
+    __m256 lineReach = _mm256_set1_ps(f.lineHalfWidth + 0.5f);
+    __m256 lineEnd = _mm256_set1_ps(f.radius + 0.5f);
+    __m256 half = _mm256_set1_ps(0.5f);
+    __m256 outer = _mm256_set1_ps(f.radius + f.vignetteWidth);
+    __m256 shadeAlpha = _mm256_set1_ps(f.vignetteAlpha);
+    __m256 scale = _mm256_set1_ps(255.0f);
+    __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i full = _mm256_set1_epi16(255);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 px = _mm256_add_ps(_mm256_set1_ps(x), _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(i), lanes)));
+        __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(px, px), y2));
+        __m256 ring = Clamp01AVX2(_mm256_sub_ps(ringReach, AbsAVX2(_mm256_sub_ps(d, radius))));
+        __m256 vert = _mm256_mul_ps(Clamp01AVX2(_mm256_sub_ps(lineReach, AbsAVX2(px))), vertical);
+        __m256 horz = _mm256_mul_ps(horizontal, Clamp01AVX2(_mm256_sub_ps(lineEnd, AbsAVX2(px))));
+        __m256 clear = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(one, ring), _mm256_sub_ps(one, vert)), _mm256_sub_ps(one, horz));
+        __m256 white = _mm256_sub_ps(one, clear);
+        __m256 shade = _mm256_mul_ps(_mm256_mul_ps(shadeAlpha, Clamp01AVX2(_mm256_add_ps(_mm256_sub_ps(d, radius), half))),
+                                     Clamp01AVX2(_mm256_mul_ps(_mm256_sub_ps(outer, d), invWidth)));
+        __m256 alpha = _mm256_add_ps(white, _mm256_mul_ps(shade, _mm256_sub_ps(one, white)));
+
+        __m256i a = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(alpha, scale), half));
+        __m256i c = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(white, scale), half));
+        __m256i sv = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(a, 24), _mm256_slli_epi32(c, 16)),
+                                     _mm256_or_si256(_mm256_slli_epi32(c, 8), c));
+
+        __m256i dv = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i invLo = _mm256_sub_epi16(full, AlphaEpu16x8(_mm256_unpacklo_epi8(sv, zero)));
+        __m256i invHi = _mm256_sub_epi16(full, AlphaEpu16x8(_mm256_unpackhi_epi8(sv, zero)));
+        __m256i lo = Div255Epu16x8(_mm256_mullo_epi16(_mm256_unpacklo_epi8(dv, zero), invLo));
+        __m256i hi = Div255Epu16x8(_mm256_mullo_epi16(_mm256_unpackhi_epi8(dv, zero), invHi));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi8(_mm256_packus_epi16(lo, hi), sv));
+    }
+    ScopeFieldSpanScalar(dst + i, count - i, x + i, y, f);
+}
+
+#endif // RASTER_X86
+
+// --- Straight alpha ---
+//
+// Premultiplied pixels back to straight alpha, for writing images out. Each
+// channel becomes c * (255 / a) rounded, worked in float the same way on
+// every ISA so all give the same bytes.
+
+inline void UnpremultiplySpanScalar(Pixel* dst, const Pixel* src, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        Pixel p = src[i];
+        uint32_t a = p >> 24;
+        float scale = 255.0f / (float)(a ? a : 1);
+        Pixel out = a << 24;
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            float c = (float)(p >> shift & 0xFF) * scale + 0.5f;
+            out |= (uint32_t)(c < 255.0f ? c : 255.0f) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+// --- Content hash ---
+//
+// A 64-bit hash of a run of pixels, for telling whether a repaint changed
+// anything. Eight pixels (32 bytes) at a time feed four 64-bit lanes the way
+// XXH3 does: each lane adds the product of the two halves of its word mixed
+// with a key that moves on every stripe, so where a pixel sits matters as
+// well as what it is, and the neighbouring lane adds the word itself. Every
+// 16 stripes the lanes are scrambled. The SIMD versions keep the same lanes,
+// so every ISA gives the same hash.
+
+const uint64_t HASH_PRIME_1 = 0x9E3779B185EBCA87ull;
+const uint64_t HASH_PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t HASH_PRIME_3 = 0x165667919E3779F9ull;
+const uint32_t HASH_SCRAMBLE_PRIME = 0x9E3779B1u;
+const uint64_t HASH_KEYS[4] = { 0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull, 0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull };
+const uint64_t HASH_KEY_STEP = 0x78E5C0CC4EE679CBull;
+const int HASH_STRIPES_PER_SCRAMBLE = 16;
+
+inline uint64_t HashAvalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= HASH_PRIME_3;
+    return h ^ h >> 32;
+}
+
+inline uint64_t RotateLeft64(uint64_t v, int r)
+{
+    return v << r | v >> (64 - r);
+}
+
+// Folds the lanes, then the pixels past the last whole stripe, into the hash
+inline uint64_t HashFinish(const uint64_t acc[4], const Pixel* tail, int tailCount, int count, uint64_t seed)
+{
+    uint64_t h = seed ^ (uint64_t)count * HASH_PRIME_1;
+    for (int i = 0; i < 4; i++)
+        h = RotateLeft64(h ^ HashAvalanche(acc[i]), 27) * HASH_PRIME_1 + HASH_PRIME_2;
+    for (int i = 0; i < tailCount; i++)
+        h = RotateLeft64(h ^ tail[i] * HASH_PRIME_2, 31) * HASH_PRIME_1;
+    return HashAvalanche(h);
+}
+
+inline uint64_t HashSpanScalar(const Pixel* src, int count, uint64_t seed)
+{
+    uint64_t acc[4], key[4];
+    for (int i = 0; i < 4; i++)
+    {
+        acc[i] = HASH_KEYS[i] ^ seed;
+        key[i] = HASH_KEYS[i];
+    }
+    int stripes = count / 8;
+    for (int s = 0; s < stripes; s++)
+    {
+        uint64_t v[4];
+        memcpy(v, src + s * 8, sizeof(v));
+        for (int i = 0; i < 4; i++)
+        {
+            uint64_t k = v[i] ^ key[i];
+            acc[i ^ 1] += v[i];
+            acc[i] += (k & 0xFFFFFFFF) * (k >> 32);
+            key[i] += HASH_KEY_STEP;
+        }
+        if ((s + 1) % HASH_STRIPES_PER_SCRAMBLE == 0)
+            for (int i = 0; i < 4; i++)
+                acc[i] = (acc[i] ^ acc[i] >> 47 ^ HASH_KEYS[i]) * HASH_SCRAMBLE_PRIME;
+    }
+    return HashFinish(acc, src + stripes * 8, count - stripes * 8, count, seed);
+}
+
+#ifdef RASTER_X86
+
+RASTER_TARGET_SSE2 inline void UnpremultiplySpanSSE2(Pixel* dst, const Pixel* src, int count)
+{
+    __m128i byteMask = _mm_set1_epi32(0xFF);
+    __m128 max = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i a = _mm_srli_epi32(p, 24);
+        // a fits in 16 bits, so SSE2's 16-bit max does for the missing 32-bit one
+        __m128 scale = _mm_div_ps(max, _mm_cvtepi32_ps(_mm_max_epi16(a, _mm_set1_epi32(1))));
+        __m128i out = _mm_slli_epi32(a, 24);
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            __m128 c = _mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(p, _mm_cvtsi32_si128(shift)), byteMask));
+            c = _mm_min_ps(_mm_add_ps(_mm_mul_ps(c, scale), half), max);
+            out = _mm_or_si128(out, _mm_sll_epi32(_mm_cvttps_epi32(c), _mm_cvtsi32_si128(shift)));
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), out);
+    }
+    UnpremultiplySpanScalar(dst + i, src + i, count - i);
+}
+
+RASTER_TARGET_AVX2 inline void UnpremultiplySpanAVX2(Pixel* dst, const Pixel* src, int count)
+{
+    __m256i byteMask = _mm256_set1_epi32(0xFF);
+    __m256 max = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i p = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i a = _mm256_srli_epi32(p, 24);
+        __m256 scale = _mm256_div_ps(max, _mm256_cvtepi32_ps(_mm256_max_epi32(a, _mm256_set1_epi32(1))));
+        __m256i out = _mm256_slli_epi32(a, 24);
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            __m256 c = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srl_epi32(p, _mm_cvtsi32_si128(shift)), byteMask));
+            c = _mm256_min_ps(_mm256_add_ps(_mm256_mul_ps(c, scale), half), max);
+            out = _mm256_or_si256(out, _mm256_sll_epi32(_mm256_cvttps_epi32(c), _mm_cvtsi32_si128(shift)));
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), out);
+    }
+    UnpremultiplySpanScalar(dst + i, src + i, count - i);
+}
+
+// The scramble step on two lanes: 64-bit multiply by a 32-bit prime from two 32x32 products
+RASTER_TARGET_SSE2 inline __m128i HashScrambleSSE2(__m128i acc, __m128i key)
+{
+    __m128i prime = _mm_set1_epi32((int)HASH_SCRAMBLE_PRIME);
+    acc = _mm_xor_si128(_mm_xor_si128(acc, _mm_srli_epi64(acc, 47)), key);
+    __m128i lo = _mm_mul_epu32(acc, prime);
+    __m128i hi = _mm_mul_epu32(_mm_srli_epi64(acc, 32), prime);
+    return _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+}
+
+// One stripe into two lanes: the word's halves multiplied, the word itself into the lane beside
+RASTER_TARGET_SSE2 inline __m128i HashAccumulateSSE2(__m128i acc, __m128i v, __m128i key)
+{
+    __m128i k = _mm_xor_si128(v, key);
+    __m128i product = _mm_mul_epu32(k, _mm_srli_epi64(k, 32));
+    return _mm_add_epi64(acc, _mm_add_epi64(_mm_shuffle_epi32(v, 0x4E), product));
+}
+
+RASTER_TARGET_SSE2 inline uint64_t HashSpanSSE2(const Pixel* src, int count, uint64_t seed)
+{
+    __m128i seeds = _mm_set1_epi64x((long long)seed);
+    __m128i keys0 = _mm_set_epi64x((long long)HASH_KEYS[1], (long long)HASH_KEYS[0]);
+    __m128i keys1 = _mm_set_epi64x((long long)HASH_KEYS[3], (long long)HASH_KEYS[2]);
+    __m128i acc0 = _mm_xor_si128(keys0, seeds), acc1 = _mm_xor_si128(keys1, seeds);
+    __m128i key0 = keys0, key1 = keys1;
+    __m128i step = _mm_set1_epi64x((long long)HASH_KEY_STEP);
+
+    int stripes = count / 8;
+    for (int s = 0; s < stripes; s++)
+    {
+        acc0 = HashAccumulateSSE2(acc0, _mm_loadu_si128((const __m128i*)(src + s * 8)), key0);
+        acc1 = HashAccumulateSSE2(acc1, _mm_loadu_si128((const __m128i*)(src + s * 8 + 4)), key1);
+        key0 = _mm_add_epi64(key0, step);
+        key1 = _mm_add_epi64(key1, step);
+        if ((s + 1) % HASH_STRIPES_PER_SCRAMBLE == 0)
+        {
+            acc0 = HashScrambleSSE2(acc0, keys0);
+            acc1 = HashScrambleSSE2(acc1, keys1);
+        }
+    }
+
+    uint64_t acc[4];
+    _mm_storeu_si128((__m128i*)acc, acc0);
+    _mm_storeu_si128((__m128i*)(acc + 2), acc1);
+    return HashFinish(acc, src + stripes * 8, count - stripes * 8, count, seed);
+}
+
+RASTER_TARGET_AVX2 inline uint64_t HashSpanAVX2(const Pixel* src, int count, uint64_t seed)
+{
+    __m256i keys = _mm256_set_epi64x((long long)HASH_KEYS[3], (long long)HASH_KEYS[2], (long long)HASH_KEYS[1], (long long)HASH_KEYS[0]);
+    __m256i acc = _mm256_xor_si256(keys, _mm256_set1_epi64x((long long)seed));
+    __m256i key = keys;
+    __m256i step = _mm256_set1_epi64x((long long)HASH_KEY_STEP);
+    __m256i prime = _mm256_set1_epi32((int)HASH_SCRAMBLE_PRIME);
+
+    int stripes = count / 8;
+    for (int s = 0; s < stripes; s++)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + s * 8));
+        __m256i k = _mm256_xor_si256(v, key);
+        __m256i product = _mm256_mul_epu32(k, _mm256_srli_epi64(k, 32));
+        acc = _mm256_add_epi64(acc, _mm256_add_epi64(_mm256_shuffle_epi32(v, 0x4E), product));
+        key = _mm256_add_epi64(key, step);
+        if ((s + 1) % HASH_STRIPES_PER_SCRAMBLE == 0)
+        {
+            acc = _mm256_xor_si256(_mm256_xor_si256(acc, _mm256_srli_epi64(acc, 47)), keys);
+            __m256i lo = _mm256_mul_epu32(acc, prime);
+            __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(acc, 32), prime);
+            acc = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+        }
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return HashFinish(lanes, src + stripes * 8, count - stripes * 8, count, seed);
+}
+
+#endif // RASTER_X86
+
+// --- Runtime dispatch ---
+
+enum RasterIsa { RASTER_ISA_SCALAR, RASTER_ISA_SSE2, RASTER_ISA_AVX2 };
+
+struct RasterKernels
+{
+    RasterIsa isa;
+    const char* name;
+    void (*fillSpan)(Pixel* dst, int count, Pixel color);
+    void (*blendSpan)(Pixel* dst, int count, Pixel color);
+    void (*blendMaskSpan)(Pixel* dst, const uint8_t* mask, int count, Pixel color);
+    void (*blendPixelSpan)(Pixel* dst, const Pixel* src, int count);
+    void (*blendShadowMaskSpan)(Pixel* dst, const uint8_t* mask, const uint8_t* shadowMask, int count, Pixel color, Pixel shadowColor);
+    void (*scopeFieldSpan)(Pixel* dst, int count, float x, float y, const ScopeField& field);
+    uint64_t (*hashSpan)(const Pixel* src, int count, uint64_t seed);
+    void (*unpremultiplySpan)(Pixel* dst, const Pixel* src, int count);
+};
+
+inline RasterIsa DetectRasterIsa()
+{
+#if defined(RASTER_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    if (avx2) return RASTER_ISA_AVX2;
+    if (sse2) return RASTER_ISA_SSE2;
+#elif defined(RASTER_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return RASTER_ISA_AVX2;
+    if (__builtin_cpu_supports("sse2")) return RASTER_ISA_SSE2;
+#endif
+    return RASTER_ISA_SCALAR;
+}
+
+// Kernels for the requested ISA, falling back to what the CPU actually supports
+inline RasterKernels MakeRasterKernels(RasterIsa isa)
+{
+    RasterIsa best = DetectRasterIsa();
+    if (isa > best) isa = best;
+#ifdef RASTER_X86
+    if (isa == RASTER_ISA_AVX2)
+        return { RASTER_ISA_AVX2, "avx2", FillSpanAVX2, BlendSpanAVX2, BlendMaskSpanAVX2, BlendPixelSpanAVX2, BlendShadowMaskSpanAVX2, ScopeFieldSpanAVX2, HashSpanAVX2, UnpremultiplySpanAVX2 };
+    if (isa == RASTER_ISA_SSE2)
+        return { RASTER_ISA_SSE2, "sse2", FillSpanSSE2, BlendSpanSSE2, BlendMaskSpanSSE2, BlendPixelSpanSSE2, BlendShadowMaskSpanSSE2, ScopeFieldSpanSSE2, HashSpanSSE2, UnpremultiplySpanSSE2 };
+#endif
+    return { RASTER_ISA_SCALAR, "scalar", FillSpanScalar, BlendSpanScalar, BlendMaskSpanScalar, BlendPixelSpanScalar, BlendShadowMaskSpanScalar, ScopeFieldSpanScalar, HashSpanScalar, UnpremultiplySpanScalar };
+}
+
+inline RasterKernels& ActiveRasterKernels()
+{
+    static RasterKernels kernels = MakeRasterKernels(RASTER_ISA_AVX2);
+    return kernels;
+}
+
+// Forces a kernel set, e.g. to compare ISAs in tests and benchmarks
+inline void SelectRasterIsa(RasterIsa isa)
+{
+    ActiveRasterKernels() = MakeRasterKernels(isa);
+}
+
+// --- Surface ---
+
+class DrawList;
+
+struct Surface
+{
+    Pixel* pixels = nullptr;
+    int width = 0, height = 0;
+    int stride = 0; // in pixels
+    IntRect clip;
+    DrawList* recorder = nullptr; // when set, primitives are recorded here instead of drawn
+
+    Surface() {}
+    Surface(Pixel* p, int w, int h, int strideInPixels)
+        : pixels(p), width(w), height(h), stride(strideInPixels), clip(MakeRect(0, 0, w, h)) {}
+
+    Pixel* Row(int y) const { return pixels + (size_t)y * stride; }
+    IntRect Bounds() const { return MakeRect(0, 0, width, height); }
+    void SetClip(const IntRect& r) { clip = RectIntersect(r, Bounds()); }
+    void ResetClip() { clip = Bounds(); }
+};
+
+// --- Recording ---
+
+// A frame as a list of commands. Each command is the rectangle a primitive can
+// touch, already clipped to the recording surface's clip, and a closure that
+// draws the primitive again with the arguments it was recorded with. Replaying
+// a command clips it to its rectangle and to the part of the target being
+// replayed, so replaying the list in pieces, in any order of pieces, gives the
+// pixels drawing it directly would have.
+//
+// Closures live in a FrameArena (Memory.h) whose blocks are kept between
+// frames, so once a frame's worth has been recorded the list stops
+// allocating. The arena is the list's own, reset by Clear, or one the host
+// resets once per frame after clearing the list. Commands refer to
+// sprites and text layouts rather than copy them: those must stay as they are
+// until the list has been replayed.
+class DrawList
+{
+public:
+    struct Command
+    {
+        IntRect bounds;
+        void (*replay)(const void* closure, Surface& target);
+        const void* closure;
+    };
+
+    explicit DrawList(FrameArena* frameArena = nullptr) : arena(frameArena ? frameArena : &ownArena) {}
+    ~DrawList() { Clear(); }
+
+    DrawList(const DrawList&) = delete;
+    DrawList& operator=(const DrawList&) = delete;
+
+    // Appends draw(target) as a command covering bounds within recording's clip
+    template <class DrawFn>
+    void Record(const Surface& recording, const IntRect& bounds, DrawFn draw)
+    {
+        static_assert(alignof(DrawFn) <= alignof(std::max_align_t), "closure alignment");
+
+        IntRect r = RectIntersect(bounds, recording.clip);
+        if (r.IsEmpty()) return;
+
+        void* storage = arena->Allocate(sizeof(DrawFn));
+        closureBytes += sizeof(DrawFn);
+        DrawFn* closure = new (storage) DrawFn(std::move(draw));
+        if (!std::is_trivially_destructible<DrawFn>::value)
+            destructors.push_back({ closure, [](void* p) { ((DrawFn*)p)->~DrawFn(); } });
+
+        Command c;
+        c.bounds = r;
+        c.replay = [](const void* p, Surface& target) { (*(const DrawFn*)p)(target); };
+        c.closure = closure;
+        commands.push_back(c);
+        extent = RectUnion(extent, r);
+    }
+
+    // Forgets the commands, keeping the memory for the next frame
+    void Clear()
+    {
+        for (const Destructor& d : destructors)
+            d.destroy(d.closure);
+        destructors.clear();
+        commands.clear();
+        if (arena == &ownArena)
+            ownArena.Reset();
+        closureBytes = 0;
+        extent = IntRect();
+    }
+
+    // Draws command i where it overlaps area
+    void Replay(size_t i, Surface& target, const IntRect& area) const
+    {
+        const Command& c = commands[i];
+        IntRect clip = RectIntersect(c.bounds, area);
+        if (clip.IsEmpty()) return;
+
+        Surface t = target;
+        t.recorder = nullptr;
+        t.SetClip(clip);
+        c.replay(c.closure, t);
+    }
+
+    // Draws every command where it overlaps area, in recorded order
+    void Replay(Surface& target, const IntRect& area) const
+    {
+        for (size_t i = 0; i < commands.size(); i++)
+            Replay(i, target, area);
+    }
+
+    void Replay(Surface& target) const { Replay(target, target.clip); }
+
+    size_t Size() const { return commands.size(); }
+    bool IsEmpty() const { return commands.empty(); }
+    const Command& operator[](size_t i) const { return commands[i]; }
+
+    IntRect Extent() const { return extent; } // union of every command's bounds
+    size_t Bytes() const { return commands.size() * sizeof(Command) + closureBytes; }
+
+private:
+    struct Destructor
+    {
+        void* closure;
+        void (*destroy)(void*);
+    };
+
+    FrameArena ownArena;
+    FrameArena* arena;
+    std::vector<Command> commands;
+    std::vector<Destructor> destructors;
+    size_t closureBytes = 0;
+    IntRect extent;
+};
+
+// Solid span [x0, x1) on row y, clipped
+inline void FillSpan(Surface& s, int y, int x0, int x1, Pixel color)
+{
+    if (y < s.clip.top || y >= s.clip.bottom) return;
+    if (x0 < s.clip.left) x0 = s.clip.left;
+    if (x1 > s.clip.right) x1 = s.clip.right;
+    if (x1 <= x0) return;
+    const RasterKernels& k = ActiveRasterKernels();
+    if ((color >> 24) == 255)
+        k.fillSpan(s.Row(y) + x0, x1 - x0, color);
+    else if (color)
+        k.blendSpan(s.Row(y) + x0, x1 - x0, color);
+}
+
+// Anti-aliased span [x0, x1) on row y. coverage(px) gets the pixel centre and returns 0..1.
+template <class CoverageFn>
+void CoverageSpan(Surface& s, int y, int x0, int x1, Pixel color, CoverageFn coverage)
+{
+    if (y < s.clip.top || y >= s.clip.bottom) return;
+    if (x0 < s.clip.left) x0 = s.clip.left;
+    if (x1 > s.clip.right) x1 = s.clip.right;
+
+    const RasterKernels& k = ActiveRasterKernels();
+    uint8_t mask[256];
+    for (int x = x0; x < x1; x += 256)
+    {
+        int n = x1 - x < 256 ? x1 - x : 256;
+        for (int i = 0; i < n; i++)
+            mask[i] = (uint8_t)(coverage(x + i + 0.5f) * 255.0f + 0.5f);
+        k.blendMaskSpan(s.Row(y) + x, mask, n, color);
+    }
+}
+
+// --- Primitives ---
+// Each records itself when the surface has a recorder. FillSpan and
+// CoverageSpan are their building blocks and always draw.
+
+inline void FillRectangle(Surface& s, const IntRect& rect, Pixel color)
+{
+    if (s.recorder)
+    {
+        s.recorder->Record(s, rect, [=](Surface& t) { FillRectangle(t, rect, color); });
+        return;
+    }
+
+    IntRect r = RectIntersect(rect, s.clip);
+    for (int y = r.top; y < r.bottom; y++)
+        FillSpan(s, y, r.left, r.right, color);
+}
+
+// Narrows [lo, hi] to the offsets t where minValue <= a * t + b <= maxValue
+inline void ConstrainSpan(float& lo, float& hi, float a, float b, float minValue, float maxValue)
+{
+    if (fabsf(a) < 1e-6f)
+    {
+        if (b < minValue || b > maxValue) hi = lo - 1.0f;
+        return;
+    }
+    float t0 = (minValue - b) / a;
+    float t1 = (maxValue - b) / a;
+    if (t0 > t1) { float t = t0; t0 = t1; t1 = t; }
+    if (t0 > lo) lo = t0;
+    if (t1 < hi) hi = t1;
+}
+
+// Butt-capped line of any thickness. Coordinates are in pixel-edge space, so a
+// 2px line along y = 10 covers rows 9 and 10 exactly.
+inline void DrawLine(Surface& s, float x0, float y0, float x1, float y1, float thickness, Pixel color)
+{
+    if (s.recorder)
+    {
+        float reach = thickness * 0.5f + 1.5f;
+        IntRect bounds = MakeRect((int)floorf((x0 < x1 ? x0 : x1) - reach), (int)floorf((y0 < y1 ? y0 : y1) - reach),
+                                  (int)ceilf((x0 > x1 ? x0 : x1) + reach), (int)ceilf((y0 > y1 ? y0 : y1) + reach));
+        s.recorder->Record(s, bounds, [=](Surface& t) { DrawLine(t, x0, y0, x1, y1, thickness, color); });
+        return;
+    }
+
+    float dx = x1 - x0, dy = y1 - y0;
+    float len = sqrtf(dx * dx + dy * dy);
+    if (len < 1e-4f || thickness <= 0.0f) return;
+    float hw = thickness * 0.5f;
+
+    // Axis-aligned lines that land on whole pixels are plain rectangles
+    if (dx == 0.0f || dy == 0.0f)
+    {
+        float l = (dx < 0 ? x1 : x0) - (dx == 0.0f ? hw : 0.0f);
+        float r = (dx < 0 ? x0 : x1) + (dx == 0.0f ? hw : 0.0f);
+        float t = (dy < 0 ? y1 : y0) - (dy == 0.0f ? hw : 0.0f);
+        float b = (dy < 0 ? y0 : y1) + (dy == 0.0f ? hw : 0.0f);
+        if (l == floorf(l) && r == floorf(r) && t == floorf(t) && b == floorf(b))
+        {
+            FillRectangle(s, MakeRect((int)l, (int)t, (int)r, (int)b), color);
+            return;
+        }
+    }
+
+    float ux = dx / len, uy = dy / len;
+    float nx = -uy, ny = ux;
+    float reach = hw + 0.5f;
+
+    int top = (int)floorf((y0 < y1 ? y0 : y1) - reach);
+    int bottom = (int)ceilf((y0 > y1 ? y0 : y1) + reach);
+    if (top < s.clip.top) top = s.clip.top;
+    if (bottom > s.clip.bottom) bottom = s.clip.bottom;
+
+    for (int y = top; y < bottom; y++)
+    {
+        float oy = y + 0.5f - y0;
+
+        // Horizontal extent of the (slightly grown) segment on this row
+        float lo = -1e9f, hi = 1e9f;
+        ConstrainSpan(lo, hi, nx, oy * ny, -reach, reach);
+        ConstrainSpan(lo, hi, ux, oy * uy, -0.5f, len + 0.5f);
+        if (hi < lo) continue;
+
+        int xa = (int)floorf(x0 + lo - 0.5f);
+        int xb = (int)ceilf(x0 + hi + 0.5f);
+        CoverageSpan(s, y, xa, xb, color, [&](float px)
+        {
+            float ox = px - x0;
+            float across = fabsf(ox * nx + oy * ny);
+            float along = ox * ux + oy * uy;
+            float ends = along < len - along ? along : len - along;
+            return Clamp01(hw + 0.5f - across) * Clamp01(ends + 0.5f);
+        });
+    }
+}
+
+// Ring between two radii around (cx, cy). innerRadius <= 0 gives a filled disc.
+inline void DrawRing(Surface& s, float cx, float cy, float innerRadius, float outerRadius, Pixel color)
+{
+    if (outerRadius <= 0.0f || outerRadius <= innerRadius) return;
+    if (s.recorder)
+    {
+        float reach = outerRadius + 1.5f;
+        IntRect bounds = MakeRect((int)floorf(cx - reach), (int)floorf(cy - reach), (int)ceilf(cx + reach), (int)ceilf(cy + reach));
+        s.recorder->Record(s, bounds, [=](Surface& t) { DrawRing(t, cx, cy, innerRadius, outerRadius, color); });
+        return;
+    }
+
+    int top = (int)floorf(cy - outerRadius - 0.5f);
+    int bottom = (int)ceilf(cy + outerRadius + 0.5f);
+    if (top < s.clip.top) top = s.clip.top;
+    if (bottom > s.clip.bottom) bottom = s.clip.bottom;
+
+    float ro = outerRadius, ri = innerRadius;
+    for (int y = top; y < bottom; y++)
+    {
+        float dy = y + 0.5f - cy;
+        float adY = fabsf(dy);
+        if (adY >= ro + 0.5f) continue;
+
+        auto coverage = [&](float px)
+        {
+            float dx = px - cx;
+            float d = sqrtf(dx * dx + dy * dy);
+            float c = Clamp01(ro - d + 0.5f);
+            if (ri > 0.0f) c -= Clamp01(ri - d + 0.5f);
+            return c < 0.0f ? 0.0f : c;
+        };
+
+        float outer = sqrtf((ro + 0.5f) * (ro + 0.5f) - dy * dy);
+        int xa = (int)floorf(cx - outer);
+        int xb = (int)ceilf(cx + outer);
+
+        if (ri <= 0.0f)
+        {
+            // Filled disc: solid middle, anti-aliased ends
+            if (adY < ro - 0.5f)
+            {
+                float full = sqrtf((ro - 0.5f) * (ro - 0.5f) - dy * dy);
+                int fa = (int)ceilf(cx - full - 0.5f);
+                int fb = (int)floorf(cx + full - 0.5f) + 1;
+                if (fa < fb)
+                {
+                    CoverageSpan(s, y, xa, fa, color, coverage);
+                    FillSpan(s, y, fa, fb, color);
+                    CoverageSpan(s, y, fb, xb, color, coverage);
+                    continue;
+                }
+            }
+            CoverageSpan(s, y, xa, xb, color, coverage);
+        }
+        else
+        {
+            // Ring: skip the hole, evaluate coverage over the band on either side
+            if (adY < ri - 0.5f)
+            {
+                float hole = sqrtf((ri - 0.5f) * (ri - 0.5f) - dy * dy);
+                int ha = (int)ceilf(cx - hole - 0.5f);
+                int hb = (int)floorf(cx + hole - 0.5f) + 1;
+                if (ha < hb)
+                {
+                    CoverageSpan(s, y, xa, ha, color, coverage);
+                    CoverageSpan(s, y, hb, xb, color, coverage);
+                    continue;
+                }
+            }
+            CoverageSpan(s, y, xa, xb, color, coverage);
+        }
+    }
+}
+
+inline void FillCircle(Surface& s, float cx, float cy, float radius, Pixel color)
+{
+    DrawRing(s, cx, cy, 0.0f, radius, color);
+}
+
+// Whole pixels the scope field can touch on each side of its centre pixel
+inline int ScopeFieldExtent(const ScopeField& f)
+{
+    float reach = f.vignetteWidth > f.ringHalfWidth ? f.vignetteWidth : f.ringHalfWidth;
+    return (int)ceilf(f.radius + reach + 0.5f);
+}
+
+// The scope centred on pixel (cx, cy), in one pass over its bounding box.
+// Inside the ring only the reticle has coverage, so that part of each row is skipped.
+inline void DrawScopeField(Surface& s, int cx, int cy, ScopeField f)
+{
+    if (f.vignetteWidth <= 0.0f)
+    {
+        f.vignetteWidth = 1.0f;
+        f.vignetteAlpha = 0.0f;
+    }
+
+    int extent = ScopeFieldExtent(f);
+    IntRect field = MakeRect(cx - extent, cy - extent, cx + extent + 1, cy + extent + 1);
+    if (s.recorder)
+    {
+        s.recorder->Record(s, field, [=](Surface& t) { DrawScopeField(t, cx, cy, f); });
+        return;
+    }
+
+    IntRect box = RectIntersect(field, s.clip);
+    if (box.IsEmpty()) return;
+
+    const RasterKernels& k = ActiveRasterKernels();
+    auto span = [&](Pixel* row, int y, int x0, int x1)
+    {
+        if (x0 < box.left) x0 = box.left;
+        if (x1 > box.right) x1 = box.right;
+        if (x1 > x0)
+            k.scopeFieldSpan(row + x0, x1 - x0, (float)(x0 - cx), (float)(y - cy), f);
+    };
+
+    int lineReach = (int)ceilf(f.lineHalfWidth + 0.5f) - 1;  // reticle columns either side of the centre
+    float hollow = f.radius - f.ringHalfWidth - 1.0f;         // nothing but the reticle within this distance
+    for (int y = box.top; y < box.bottom; y++)
+    {
+        Pixel* row = s.Row(y);
+        int dy = y - cy < 0 ? cy - y : y - cy;
+        int skip = 0; // pixels with lineReach < |dx| < skip are empty
+        if (dy > lineReach && dy < hollow)
+            skip = (int)sqrtf(hollow * hollow - (float)dy * dy);
+
+        if (skip <= lineReach + 1)
+        {
+            span(row, y, box.left, box.right);
+            continue;
+        }
+        span(row, y, box.left, cx - skip + 1);
+        span(row, y, cx - lineReach, cx + lineReach + 1);
+        span(row, y, cx + skip, box.right);
+    }
+}
+
+// Coverage of a pixel centre by a rounded rectangle with whole-pixel edges
+inline float RoundRectCoverage(const IntRect& rc, float radius, float px, float py)
+{
+    if (px < rc.left || px > rc.right || py < rc.top || py > rc.bottom) return 0.0f;
+    float cx = px < rc.left + radius ? rc.left + radius : (px > rc.right - radius ? rc.right - radius : px);
+    float cy = py < rc.top + radius ? rc.top + radius : (py > rc.bottom - radius ? rc.bottom - radius : py);
+    if (cx == px || cy == py) return 1.0f;
+    float dx = px - cx, dy = py - cy;
+    return Clamp01(radius - sqrtf(dx * dx + dy * dy) + 0.5f);
+}
+
+// Rounded rectangle, filled when thickness <= 0, otherwise stroked inside its edges
+inline void DrawRoundRect(Surface& s, const IntRect& rect, float radius, int thickness, Pixel color)
+{
+    if (rect.IsEmpty()) return;
+    if (s.recorder)
+    {
+        s.recorder->Record(s, rect, [=](Surface& t) { DrawRoundRect(t, rect, radius, thickness, color); });
+        return;
+    }
+
+    float maxRadius = (rect.Width() < rect.Height() ? rect.Width() : rect.Height()) * 0.5f;
+    if (radius > maxRadius) radius = maxRadius;
+    if (radius < 0.0f) radius = 0.0f;
+
+    bool filled = thickness <= 0 || thickness * 2 >= rect.Width() || thickness * 2 >= rect.Height();
+    IntRect inner = filled ? IntRect() : MakeRect(rect.left + thickness, rect.top + thickness, rect.right - thickness, rect.bottom - thickness);
+    float innerRadius = radius - thickness > 0.0f ? radius - thickness : 0.0f;
+
+    int band = (int)ceilf(radius);
+    int innerBand = filled ? 0 : thickness + (int)ceilf(innerRadius);
+    if (innerBand > band) band = innerBand;
+
+    int top = rect.top > s.clip.top ? rect.top : s.clip.top;
+    int bottom = rect.bottom < s.clip.bottom ? rect.bottom : s.clip.bottom;
+    for (int y = top; y < bottom; y++)
+    {
+        float py = y + 0.5f;
+        auto coverage = [&](float px)
+        {
+            float c = RoundRectCoverage(rect, radius, px, py);
+            if (!filled) c -= RoundRectCoverage(inner, innerRadius, px, py);
+            return c < 0.0f ? 0.0f : c;
+        };
+
+        bool insideInner = !filled && y >= inner.top && y < inner.bottom;
+        bool cornerRow = py < rect.top + radius || py > rect.bottom - radius;
+        if (!insideInner && !cornerRow)
+        {
+            FillSpan(s, y, rect.left, rect.right, color);
+            continue;
+        }
+
+        int rowBand = insideInner ? band : (int)ceilf(radius);
+        if (rowBand * 2 >= rect.Width())
+        {
+            CoverageSpan(s, y, rect.left, rect.right, color, coverage);
+            continue;
+        }
+        CoverageSpan(s, y, rect.left, rect.left + rowBand, color, coverage);
+        if (!insideInner)
+            FillSpan(s, y, rect.left + rowBand, rect.right - rowBand, color);
+        CoverageSpan(s, y, rect.right - rowBand, rect.right, color, coverage);
+    }
+}
+
+inline void FillRoundRect(Surface& s, const IntRect& rect, float radius, Pixel color)
+{
+    DrawRoundRect(s, rect, radius, 0, color);
+}
+
+#endif //RASTER_H
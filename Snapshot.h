@@ -0,0 +1,89 @@
+// Snapshot.h: a value shared between one writer and any number of readers
+// without locks, as a seqlock. The writer publishes whole values; a reader
+// copies out a consistent one and retries only if a publish overlapped its
+// copy, which never blocks the writer. Every publish bumps the generation, so
+// a reader that keeps the generation of its last copy can tell whether
+// anything changed without comparing values.
+//
+// The value is held as atomic words rather than raw bytes, so a copy that
+// overlaps a publish is well defined and race detectors have nothing to
+// report. T must be trivially copyable.
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+template <class T>
+class SnapshotCell
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SnapshotCell copies its value as raw words");
+
+public:
+    // Holds T() at generation 0
+    SnapshotCell() { StoreWords(T()); }
+    explicit SnapshotCell(const T& initial) { StoreWords(initial); }
+
+    // Writer side: one thread at a time. Returns the new generation.
+    uint64_t Publish(const T& value)
+    {
+        uint64_t s = sequence.load(std::memory_order_relaxed);
+        sequence.store(s + 1, std::memory_order_relaxed); // odd while the words are being replaced
+        StoreWords(value);                                  // release: no word overtakes the odd sequence
+        sequence.store(s + 2, std::memory_order_release);
+        return (s + 2) / 2;
+    }
+
+    // Reader side: any thread. Copies out the current value and returns its generation.
+    uint64_t Read(T& out) const
+    {
+        Word words[WORD_COUNT];
+        for (;;)
+        {
+            uint64_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue; // a publish is halfway through
+
+            // acquire: the second sequence load cannot move above any word
+            for (size_t i = 0; i < WORD_COUNT; i++)
+                words[i] = data[i].load(std::memory_order_acquire);
+
+            if (sequence.load(std::memory_order_relaxed) == before)
+            {
+                memcpy(&out, words, sizeof(T));
+                return before / 2;
+            }
+        }
+    }
+
+    T Read() const
+    {
+        T value;
+        Read(value);
+        return value;
+    }
+
+    // Generation of the last completed publish
+    uint64_t Generation() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+    typedef uint32_t Word;
+    static const size_t WORD_COUNT = (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+    void StoreWords(const T& value)
+    {
+        Word words[WORD_COUNT] = {};
+        memcpy(words, &value, sizeof(T));
+        for (size_t i = 0; i < WORD_COUNT; i++)
+            data[i].store(words[i], std::memory_order_release);
+    }
+
+    alignas(64) std::atomic<uint64_t> sequence{ 0 };
+    std::atomic<Word> data[WORD_COUNT];
+};
+
+#endif //SNAPSHOT_H
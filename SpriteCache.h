@@ -0,0 +1,250 @@
+// SpriteCache.h: retained-mode layers for widgets whose geometry rarely changes.
+//
+// A widget is rasterized once into a sprite sized to its own bounds and the
+// sprite is blitted every frame after that. Single-colour widgets (the
+// crosshair) are kept as a coverage mask, so a colour change, rainbow mode
+// included, never touches the geometry; the mask is recoloured once per
+// colour into premultiplied pixels, which blit in about half the time of
+// tinting the mask on every blit. Multi-colour widgets (the scope) keep
+// premultiplied pixels. Entries are keyed by layer and
+// a hash of the parameters that shape them: a layer holds at most one entry and
+// a new key for that layer replaces the old one.
+//
+// Sprite memory comes from the cache's SurfaceAllocator (Memory.h), whose
+// budget is the cache's: a sprite that doesn't fit evicts the least recently
+// used layers. Replacing a layer hands its block back to the pool, where the
+// next sprite of that size finds it, so rainbow mode recolours into the same
+// two blocks every frame instead of going to the heap.
+
+#ifndef SPRITE_CACHE_H
+#define SPRITE_CACHE_H
+
+#include "Raster.h"
+#include "Memory.h"
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+struct Sprite
+{
+    int width = 0, height = 0;
+    int originX = 0, originY = 0; // top-left corner relative to the anchor point
+    bool isMask = false;          // coverage only, tinted at blit time
+    SurfaceBlock storage;         // a byte per pixel for a mask, premultiplied pixels otherwise
+
+    const uint8_t* Mask() const { return (const uint8_t*)storage.Data(); }
+    const Pixel* Pixels() const { return (const Pixel*)storage.Data(); }
+    size_t Count() const { return (size_t)width * height; }
+    size_t Bytes() const { return storage.Bytes(); }
+    bool IsEmpty() const { return !storage; } // its memory couldn't be had
+};
+
+// Rasterizes into a new sprite with memory from the allocator. draw(surface,
+// anchorX, anchorY) paints as if the anchor were at (anchorX, anchorY) of the
+// destination. The sprite is empty if the allocator is out of budget.
+template <class DrawFn>
+Sprite RenderSprite(SurfaceAllocator& memory, const IntRect& boundsAroundAnchor, bool asMask, DrawFn draw)
+{
+    Sprite sprite;
+    sprite.width = boundsAroundAnchor.Width();
+    sprite.height = boundsAroundAnchor.Height();
+    sprite.originX = boundsAroundAnchor.left;
+    sprite.originY = boundsAroundAnchor.top;
+    sprite.isMask = asMask;
+
+    // A mask is drawn into pixels first, which go back to the pool straight after
+    SurfaceBlock pixels = memory.Allocate(sprite.Count() * sizeof(Pixel));
+    if (!pixels) return sprite;
+    memset(pixels.Data(), 0, sprite.Count() * sizeof(Pixel));
+    Surface surface((Pixel*)pixels.Data(), sprite.width, sprite.height, sprite.width);
+    draw(surface, -sprite.originX, -sprite.originY);
+
+    if (!asMask)
+    {
+        sprite.storage = std::move(pixels);
+        return sprite;
+    }
+
+    // Drawn in opaque white, so the alpha channel is the coverage
+    sprite.storage = memory.Allocate(sprite.Count());
+    if (!sprite.storage) return sprite;
+    uint8_t* mask = (uint8_t*)sprite.storage.Data();
+    const Pixel* drawn = (const Pixel*)pixels.Data();
+    for (size_t i = 0; i < sprite.Count(); i++)
+        mask[i] = (uint8_t)(drawn[i] >> 24);
+    return sprite;
+}
+
+// A mask sprite as premultiplied pixels of one colour: exactly what a blit
+// tinted with that colour would draw over transparent, so blitting it gives
+// the same pixels as the tinted blit
+inline Sprite RecolorSprite(SurfaceAllocator& memory, const Sprite& mask, Pixel color)
+{
+    Sprite sprite;
+    sprite.width = mask.width;
+    sprite.height = mask.height;
+    sprite.originX = mask.originX;
+    sprite.originY = mask.originY;
+    sprite.storage = memory.Allocate(sprite.Count() * sizeof(Pixel));
+    if (sprite.storage)
+    {
+        memset(sprite.storage.Data(), 0, sprite.Count() * sizeof(Pixel));
+        ActiveRasterKernels().blendMaskSpan((Pixel*)sprite.storage.Data(), mask.Mask(), (int)sprite.Count(), color);
+    }
+    return sprite;
+}
+
+// Composites a sprite with its anchor at (x, y). Mask sprites are drawn in tint.
+// A recorded blit refers to the sprite, so a cached one must not be replaced
+// before the recording is replayed.
+inline void BlitSprite(Surface& dst, const Sprite& sprite, int x, int y, Pixel tint = 0)
+{
+    IntRect placed = MakeRect(x + sprite.originX, y + sprite.originY,
+                              x + sprite.originX + sprite.width, y + sprite.originY + sprite.height);
+    if (dst.recorder)
+    {
+        const Sprite* recorded = &sprite;
+        dst.recorder->Record(dst, placed, [=](Surface& t) { BlitSprite(t, *recorded, x, y, tint); });
+        return;
+    }
+
+    IntRect r = RectIntersect(placed, dst.clip);
+    if (r.IsEmpty()) return;
+
+    const RasterKernels& k = ActiveRasterKernels();
+    for (int row = r.top; row < r.bottom; row++)
+    {
+        size_t srcOffset = (size_t)(row - placed.top) * sprite.width + (r.left - placed.left);
+        Pixel* out = dst.Row(row) + r.left;
+        if (sprite.isMask)
+            k.blendMaskSpan(out, sprite.Mask() + srcOffset, r.Width(), tint);
+        else
+            k.blendPixelSpan(out, sprite.Pixels() + srcOffset, r.Width());
+    }
+}
+
+struct SpriteCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+class SpriteCache
+{
+public:
+    static const int MAX_ENTRIES = 16;
+
+    explicit SpriteCache(size_t budgetBytes = 4 * 1024 * 1024) : memory(budgetBytes)
+    {
+        memory.SetReclaim([](void* cache) { return ((SpriteCache*)cache)->EvictForSpace(); }, this);
+    }
+
+    SpriteCache(const SpriteCache&) = delete;
+    SpriteCache& operator=(const SpriteCache&) = delete;
+
+    // Where sprites for this cache get their memory
+    SurfaceAllocator& Memory() { return memory; }
+
+    // Cached sprite for this layer and key, or nullptr on a miss. A returned
+    // pointer stays valid until its own layer is replaced or evicted, or Clear.
+    const Sprite* Find(int layer, uint64_t key)
+    {
+        Entry* e = FindLayer(layer);
+        if (e && e->key == key)
+        {
+            e->lastUse = ++useClock;
+            stats.hits++;
+            return &e->sprite;
+        }
+        stats.misses++;
+        return nullptr;
+    }
+
+    // Stores a sprite made with Memory(), replacing the layer's previous
+    // entry. Returns nullptr for an empty sprite, one that didn't fit the
+    // budget even alone; the caller then draws directly.
+    const Sprite* Insert(int layer, uint64_t key, Sprite&& sprite)
+    {
+        Invalidate(layer);
+        if (sprite.IsEmpty()) return nullptr;
+
+        if (entryCount == MAX_ENTRIES)
+            EvictOldest();
+
+        Entry& e = *FindLayer(-1);
+        entryCount++;
+        e.layer = layer;
+        e.key = key;
+        e.lastUse = ++useClock;
+        e.sprite = std::move(sprite);
+        return &e.sprite;
+    }
+
+    void Invalidate(int layer)
+    {
+        if (Entry* e = FindLayer(layer))
+            Remove(*e);
+    }
+
+    void Clear()
+    {
+        for (Entry& e : entries)
+            if (e.layer >= 0) Remove(e);
+    }
+
+    void SetBudget(size_t budgetBytes) { memory.SetBudget(budgetBytes); }
+
+    const SpriteCacheStats& Stats() const { return stats; }
+    const MemoryStats& MemoryUse() const { return memory.Stats(); }
+
+private:
+    struct Entry
+    {
+        int layer = -1;
+        uint64_t key = 0;
+        uint64_t lastUse = 0;
+        Sprite sprite;
+    };
+
+    // The entry for a layer; layer -1 finds a free slot. Entries never move
+    // between slots, so a sprite one layer returned survives inserts into others.
+    Entry* FindLayer(int layer)
+    {
+        for (Entry& e : entries)
+            if (e.layer == layer)
+                return &e;
+        return nullptr;
+    }
+
+    void Remove(Entry& e)
+    {
+        e = Entry();
+        entryCount--;
+    }
+
+    // Evicts the least recently used entry; keepLatest spares the one used
+    // last, which a caller building a sprite from it may still be reading
+    bool EvictOldest(bool keepLatest = false)
+    {
+        Entry* oldest = nullptr;
+        for (Entry& e : entries)
+            if (e.layer >= 0 && !(keepLatest && e.lastUse == useClock) && (!oldest || e.lastUse < oldest->lastUse))
+                oldest = &e;
+        if (!oldest) return false;
+        Remove(*oldest);
+        stats.evictions++;
+        return true;
+    }
+
+    // The allocator is out of budget
+    bool EvictForSpace() { return EvictOldest(true); }
+
+    SurfaceAllocator memory; // before the entries, so it outlives their sprites
+    Entry entries[MAX_ENTRIES];
+    int entryCount = 0;
+    uint64_t useClock = 0;
+    SpriteCacheStats stats;
+};
+
+#endif //SPRITE_CACHE_H
@@ -0,0 +1,70 @@
+// SpscRing.h: fixed-size lock-free queue for exactly one producer thread and
+// one consumer thread. Push never blocks; when the ring is full the item is
+// dropped and counted, which is the right trade for input and telemetry that
+// must never stall the thread producing it.
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+template <class T, size_t Capacity>
+class SpscRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer side
+    bool Push(const T& item)
+    {
+        size_t head = writeIndex.load(std::memory_order_relaxed);
+        if (head - cachedReadIndex == Capacity)
+        {
+            cachedReadIndex = readIndex.load(std::memory_order_acquire);
+            if (head - cachedReadIndex == Capacity)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        items[head & (Capacity - 1)] = item;
+        writeIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool Pop(T& item)
+    {
+        size_t tail = readIndex.load(std::memory_order_relaxed);
+        if (tail == cachedWriteIndex)
+        {
+            cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+            if (tail == cachedWriteIndex)
+                return false;
+        }
+        item = items[tail & (Capacity - 1)];
+        readIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either side; only a snapshot
+    size_t Size() const
+    {
+        return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_acquire);
+    }
+
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    // Producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<size_t> writeIndex{ 0 };
+    size_t cachedReadIndex = 0;
+    alignas(64) std::atomic<size_t> readIndex{ 0 };
+    size_t cachedWriteIndex = 0;
+    alignas(64) std::atomic<uint64_t> dropped{ 0 };
+    T items[Capacity];
+};
+
+#endif //SPSC_RING_H
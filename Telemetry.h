@@ -0,0 +1,359 @@
+// Telemetry.h: per-frame statistics published for a viewer in another process.
+//
+// The FPS line and the profiler readout are drawn by the overlay itself, so
+// watching them costs frames of their own. Instead, every drawn frame can be
+// published as one fixed-size record into a ring in named shared memory, and
+// bench/TelemetryTail.cpp reads the ring from outside: it aggregates and prints
+// without ever touching the overlay thread.
+//
+// There is one writer and any number of readers, and readers never hold the
+// writer up. Publishing copies a record into the next slot and moves a counter;
+// a reader that falls a whole ring behind finds its records overwritten and
+// counts them as lost. Each slot carries a sequence number that is cleared
+// while the slot is written and set to the record's number after, so a reader
+// can tell a record it copied whole from one the writer was overwriting.
+//
+// SharedMemory maps the region with CreateFileMapping on Windows and shm_open
+// on other platforms, so the writer and reader here run on Linux too; the
+// replay (bench/OverlayReplay.cpp --telemetry) publishes the same records
+// there.
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char TELEMETRY_MAGIC[8] = { 'A', 'S', 'T', 'R', 'T', 'L', 'M', '1' };
+const uint32_t TELEMETRY_VERSION = 1;
+const char* const TELEMETRY_DEFAULT_NAME = "astral_telemetry";
+const uint32_t TELEMETRY_CAPACITY = 1024; // records, a second at 1000 frames per second
+const int TELEMETRY_MAX_STAGES = 16;
+const int TELEMETRY_MAX_REASONS = 16;     // FrameScheduler::MAX_SOURCES
+const int TELEMETRY_NAME_LENGTH = 16;     // including the terminating zero
+
+// One drawn frame
+struct TelemetryRecord
+{
+    uint64_t frame;          // frames published before this one
+    int64_t timeNs;          // when the frame started, on the overlay's clock
+    uint32_t frameNs;        // laying out, drawing and handing the windows over
+    uint32_t reasons;        // why it was drawn: bit i for frame source i, bit 31 for a request
+    uint32_t stageNs[TELEMETRY_MAX_STAGES]; // per profiler stage, 0 where it didn't run or profiling is off
+    uint64_t clearedBytes;   // damage cleared before repainting
+    uint64_t presentedBytes; // dirty rectangles handed to the compositor
+    uint16_t windowsPresented;
+    uint16_t windowsSkipped; // repainted to what was already on screen
+    uint16_t heapAllocations;
+    uint16_t qualityLevel;   // the governor's, 0 for full quality
+    uint32_t reserved[2];
+};
+
+// At the start of the region; the slots follow it
+struct TelemetryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t capacity;
+    uint32_t stageCount;
+    uint32_t reasonCount;
+    uint32_t reserved;
+    uint64_t session; // differs each time a writer starts over
+    char stageNames[TELEMETRY_MAX_STAGES][TELEMETRY_NAME_LENGTH];
+    char reasonNames[TELEMETRY_MAX_REASONS][TELEMETRY_NAME_LENGTH];
+
+    // The writer's counter, on a cache line of its own
+    alignas(64) std::atomic<uint64_t> published; // records ever written
+};
+
+struct TelemetrySlot
+{
+    std::atomic<uint64_t> sequence; // the record's number plus one once written, 0 while it is written
+    TelemetryRecord record;
+};
+
+static_assert(sizeof(TelemetrySlot) == 128, "telemetry slot layout");
+static_assert(sizeof(TelemetryHeader) % 64 == 0, "telemetry header layout");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared counters need lock-free atomics");
+
+const size_t TELEMETRY_REGION_BYTES = sizeof(TelemetryHeader) + TELEMETRY_CAPACITY * sizeof(TelemetrySlot);
+
+// --- Shared memory ---
+
+// A named region of memory mapped into every process that opens it
+class SharedMemory
+{
+public:
+    SharedMemory() = default;
+    ~SharedMemory() { Close(); }
+
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    // Creates the region, or takes over one of the same name, for reading and writing
+    bool Create(const char* name, size_t bytes)
+    {
+        Close();
+#ifdef _WIN32
+        char path[128];
+        snprintf(path, sizeof(path), "Local\\%s", name);
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)bytes >> 32), (DWORD)bytes, path);
+        if (mapping)
+            data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+#else
+        snprintf(path, sizeof(path), "/%s", name);
+        int fd = shm_open(path, O_CREAT | O_RDWR, 0600);
+        if (fd < 0)
+            return false;
+        if (ftruncate(fd, (off_t)bytes) == 0)
+        {
+            void* view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (view != MAP_FAILED)
+                data = (uint8_t*)view;
+        }
+        close(fd);
+        owner = true;
+#endif
+        size = bytes;
+        if (!data)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    // Maps a region some other process created, read-only
+    bool Open(const char* name)
+    {
+        Close();
+#ifdef _WIN32
+        char path[128];
+        snprintf(path, sizeof(path), "Local\\%s", name);
+        mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, path);
+        if (mapping)
+            data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        MEMORY_BASIC_INFORMATION info;
+        if (data && VirtualQuery(data, &info, sizeof(info)))
+            size = info.RegionSize;
+#else
+        snprintf(path, sizeof(path), "/%s", name);
+        int fd = shm_open(path, O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (view != MAP_FAILED)
+            {
+                data = (uint8_t*)view;
+                size = (size_t)st.st_size;
+            }
+        }
+        close(fd);
+#endif
+        if (!data)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    // The region itself goes when the last process lets go of it; on POSIX
+    // systems, when its creator does
+    void Close()
+    {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        if (data) munmap(data, size);
+        if (owner) shm_unlink(path);
+        owner = false;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#else
+    char path[128] = {};
+    bool owner = false;
+#endif
+    uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// --- Writer ---
+
+class TelemetryWriter
+{
+public:
+    // Creates the ring under name and labels its stages and reasons. session
+    // tells readers this writer from an earlier one of the same name.
+    bool Open(const char* name, const char* const* stageNames, int stageCount, const char* const* reasonNames, int reasonCount, uint64_t session)
+    {
+        Close();
+        if (!memory.Create(name, TELEMETRY_REGION_BYTES))
+            return false;
+
+        header = new (memory.Data()) TelemetryHeader();
+        memcpy(header->magic, TELEMETRY_MAGIC, sizeof(header->magic));
+        header->version = TELEMETRY_VERSION;
+        header->recordSize = sizeof(TelemetryRecord);
+        header->capacity = TELEMETRY_CAPACITY;
+        header->stageCount = stageCount < TELEMETRY_MAX_STAGES ? stageCount : TELEMETRY_MAX_STAGES;
+        header->reasonCount = reasonCount < TELEMETRY_MAX_REASONS ? reasonCount : TELEMETRY_MAX_REASONS;
+        header->session = session;
+        for (uint32_t i = 0; i < header->stageCount; i++)
+            snprintf(header->stageNames[i], TELEMETRY_NAME_LENGTH, "%s", stageNames[i]);
+        for (uint32_t i = 0; i < header->reasonCount; i++)
+            snprintf(header->reasonNames[i], TELEMETRY_NAME_LENGTH, "%s", reasonNames[i]);
+
+        slots = (TelemetrySlot*)(memory.Data() + sizeof(TelemetryHeader));
+        for (uint32_t i = 0; i < TELEMETRY_CAPACITY; i++)
+            new (&slots[i]) TelemetrySlot();
+        header->published.store(0, std::memory_order_release);
+        return true;
+    }
+
+    void Close()
+    {
+        memory.Close();
+        header = nullptr;
+        slots = nullptr;
+    }
+
+    bool IsOpen() const { return header != nullptr; }
+
+    // Never waits for a reader. Fills in the record's frame number.
+    void Publish(const TelemetryRecord& r)
+    {
+        if (!header) return;
+        uint64_t n = header->published.load(std::memory_order_relaxed);
+        TelemetrySlot& s = slots[n % TELEMETRY_CAPACITY];
+        s.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&s.record, &r, sizeof(r));
+        s.record.frame = n;
+        s.sequence.store(n + 1, std::memory_order_release);
+        header->published.store(n + 1, std::memory_order_release);
+    }
+
+    uint64_t Published() const { return header ? header->published.load(std::memory_order_relaxed) : 0; }
+
+private:
+    SharedMemory memory;
+    TelemetryHeader* header = nullptr;
+    TelemetrySlot* slots = nullptr;
+};
+
+// --- Reader ---
+
+class TelemetryReader
+{
+public:
+    // Maps the ring under name, if a writer has created it. Reading starts at
+    // the next record published.
+    bool Open(const char* name)
+    {
+        Close();
+        if (!memory.Open(name))
+            return false;
+
+        const TelemetryHeader* h = (const TelemetryHeader*)memory.Data();
+        if (memory.Size() < sizeof(TelemetryHeader) || memcmp(h->magic, TELEMETRY_MAGIC, sizeof(h->magic)) != 0 ||
+            h->version != TELEMETRY_VERSION || h->recordSize != sizeof(TelemetryRecord) || h->capacity == 0 ||
+            memory.Size() < sizeof(TelemetryHeader) + (size_t)h->capacity * sizeof(TelemetrySlot))
+        {
+            Close();
+            return false;
+        }
+        header = h;
+        slots = (const TelemetrySlot*)(memory.Data() + sizeof(TelemetryHeader));
+        next = header->published.load(std::memory_order_acquire);
+        lost = 0;
+        return true;
+    }
+
+    void Close()
+    {
+        memory.Close();
+        header = nullptr;
+        slots = nullptr;
+    }
+
+    bool IsOpen() const { return header != nullptr; }
+
+    // The next record, or false when there is none yet. Records the writer
+    // overwrote before they were read are skipped and counted in Lost.
+    bool Next(TelemetryRecord& r)
+    {
+        if (!header) return false;
+        for (;;)
+        {
+            uint64_t published = header->published.load(std::memory_order_acquire);
+            if (published < next) // the writer started over
+                next = 0;
+            if (next == published)
+                return false;
+            if (published - next > header->capacity)
+            {
+                lost += published - header->capacity - next;
+                next = published - header->capacity;
+            }
+
+            const TelemetrySlot& s = slots[next % header->capacity];
+            uint64_t before = s.sequence.load(std::memory_order_acquire);
+            memcpy(&r, &s.record, sizeof(r));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t after = s.sequence.load(std::memory_order_relaxed);
+            if (before == next + 1 && after == before)
+            {
+                next++;
+                return true;
+            }
+            // Overwritten under us: the writer has lapped this slot
+            lost++;
+            next++;
+        }
+    }
+
+    uint64_t Lost() const { return lost; }
+    uint64_t Session() const { return header ? header->session : 0; }
+    int StageCount() const { return header ? (int)header->stageCount : 0; }
+    int ReasonCount() const { return header ? (int)header->reasonCount : 0; }
+    const char* StageName(int i) const { return header->stageNames[i]; }
+    const char* ReasonName(int i) const { return header->reasonNames[i]; }
+
+private:
+    SharedMemory memory;
+    const TelemetryHeader* header = nullptr;
+    const TelemetrySlot* slots = nullptr;
+    uint64_t next = 0;
+    uint64_t lost = 0;
+};
+
+#endif //TELEMETRY_H
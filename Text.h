@@ -0,0 +1,367 @@
+// Text.h: glyph-atlas text for the overlay surface.
+//
+// Printable ASCII is rasterized once into an 8-bit coverage atlas by a
+// GlyphSource (GDI in the DLL, anything at all headless). Drawing a string
+// copies glyph coverage into a line mask, and the mask is composited together
+// with its drop shadow in a single pass of the blendShadowMaskSpan kernel.
+// A TextLine keeps its formatted string and line mask between frames, so a
+// line bound to a value is formatted and laid out again only when that value
+// changes; the steady state is one kernel call per row of text.
+
+#ifndef TEXT_H
+#define TEXT_H
+
+#include "Raster.h"
+#include "DirtyRegion.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// One glyph as handed over by a GlyphSource
+struct GlyphBitmap
+{
+    int width = 0, height = 0;
+    int left = 0, top = 0;          // bitmap position relative to the pen at the top of the line
+    int advance = 0;
+    std::vector<uint8_t> coverage;  // width * height, 0-255
+};
+
+class GlyphSource
+{
+public:
+    virtual ~GlyphSource() {}
+
+    virtual int LineHeight() = 0;
+    virtual bool Rasterize(char c, GlyphBitmap& glyph) = 0;
+};
+
+class GlyphAtlas
+{
+public:
+    static const int FIRST_CHAR = 32;
+    static const int LAST_CHAR = 126;
+    static const int GLYPH_COUNT = LAST_CHAR - FIRST_CHAR + 1;
+    static const int ATLAS_WIDTH = 256;
+
+    struct Glyph
+    {
+        int x = 0, y = 0;               // position in the atlas
+        int width = 0, height = 0;
+        int left = 0, top = 0;
+        int advance = 0;
+    };
+
+    // Rasterizes every printable character. Empty borders are trimmed and the
+    // glyphs are packed in shelves. Returns false if the source fails.
+    bool Build(GlyphSource& source)
+    {
+        lineHeight = source.LineHeight();
+        GlyphBitmap bitmaps[GLYPH_COUNT];
+        for (int i = 0; i < GLYPH_COUNT; i++)
+        {
+            if (!source.Rasterize((char)(FIRST_CHAR + i), bitmaps[i]))
+                return false;
+            Trim(bitmaps[i]);
+        }
+
+        // Shelf packing, one pixel apart so glyphs never bleed into each other
+        int x = 0, y = 0, shelfHeight = 0;
+        for (int i = 0; i < GLYPH_COUNT; i++)
+        {
+            const GlyphBitmap& b = bitmaps[i];
+            if (x + b.width > ATLAS_WIDTH)
+            {
+                x = 0;
+                y += shelfHeight + 1;
+                shelfHeight = 0;
+            }
+            Glyph& g = glyphs[i];
+            g.x = x;
+            g.y = y;
+            g.width = b.width;
+            g.height = b.height;
+            g.left = b.left;
+            g.top = b.top;
+            g.advance = b.advance;
+            x += b.width + 1;
+            if (b.height > shelfHeight) shelfHeight = b.height;
+        }
+        height = y + shelfHeight;
+
+        pixels.assign((size_t)ATLAS_WIDTH * height, 0);
+        for (int i = 0; i < GLYPH_COUNT; i++)
+        {
+            const Glyph& g = glyphs[i];
+            for (int row = 0; row < g.height; row++)
+                memcpy(&pixels[(size_t)(g.y + row) * ATLAS_WIDTH + g.x], &bitmaps[i].coverage[(size_t)row * g.width], g.width);
+        }
+
+        static uint64_t builds = 0;
+        id = ++builds;
+        return true;
+    }
+
+    bool IsBuilt() const { return id != 0; }
+    uint64_t Id() const { return id; } // changes on every Build, for layout caches
+    int LineHeight() const { return lineHeight; }
+    int Width() const { return ATLAS_WIDTH; }
+    int Height() const { return height; }
+    const uint8_t* Row(int y) const { return &pixels[(size_t)y * ATLAS_WIDTH]; }
+
+    // Characters outside printable ASCII draw as '?'
+    const Glyph& GetGlyph(char c) const
+    {
+        int i = (unsigned char)c;
+        if (i < FIRST_CHAR || i > LAST_CHAR) i = '?';
+        return glyphs[i - FIRST_CHAR];
+    }
+
+    // letterSpacing is added after every character, as GDI's character extra is
+    int MeasureWidth(const char* text, int letterSpacing = 0) const
+    {
+        int width = 0;
+        for (; *text; text++)
+            width += GetGlyph(*text).advance + letterSpacing;
+        return width;
+    }
+
+private:
+    static void Trim(GlyphBitmap& b)
+    {
+        int x0 = b.width, y0 = b.height, x1 = 0, y1 = 0;
+        for (int y = 0; y < b.height; y++)
+            for (int x = 0; x < b.width; x++)
+                if (b.coverage[(size_t)y * b.width + x])
+                {
+                    if (x < x0) x0 = x;
+                    if (y < y0) y0 = y;
+                    if (x + 1 > x1) x1 = x + 1;
+                    if (y + 1 > y1) y1 = y + 1;
+                }
+
+        if (x1 <= x0)
+        {
+            b.width = b.height = 0;
+            b.coverage.clear();
+            return;
+        }
+
+        std::vector<uint8_t> trimmed((size_t)(x1 - x0) * (y1 - y0));
+        for (int y = y0; y < y1; y++)
+            memcpy(&trimmed[(size_t)(y - y0) * (x1 - x0)], &b.coverage[(size_t)y * b.width + x0], x1 - x0);
+        b.coverage.swap(trimmed);
+        b.left += x0;
+        b.top += y0;
+        b.width = x1 - x0;
+        b.height = y1 - y0;
+    }
+
+    Glyph glyphs[GLYPH_COUNT];
+    std::vector<uint8_t> pixels;
+    int height = 0;
+    int lineHeight = 0;
+    uint64_t id = 0;
+};
+
+// A laid-out string: its coverage with a zero border of PAD pixels all round,
+// so the shadow can be read at a negative offset without bounds checks
+struct TextLayout
+{
+    static const int PAD = 4; // largest supported shadow offset
+
+    int width = 0, height = 0; // text extent, without the border
+    int stride = 0;
+    std::vector<uint8_t> mask;
+
+    void Build(const GlyphAtlas& atlas, const char* text, int letterSpacing)
+    {
+        width = atlas.MeasureWidth(text, letterSpacing);
+        height = atlas.LineHeight();
+        stride = width + 2 * PAD;
+        mask.assign((size_t)stride * (height + 2 * PAD), 0);
+
+        int pen = 0;
+        for (; *text; text++)
+        {
+            const GlyphAtlas::Glyph& g = atlas.GetGlyph(*text);
+            for (int row = 0; row < g.height; row++)
+            {
+                int y = g.top + row;
+                if (y < -PAD || y >= height + PAD) continue;
+                const uint8_t* src = atlas.Row(g.y + row) + g.x;
+                uint8_t* dst = Row(y);
+                for (int col = 0; col < g.width; col++)
+                {
+                    int x = pen + g.left + col;
+                    if (x < -PAD || x >= width + PAD) continue;
+                    // Neighbouring glyphs may overlap; keep the stronger coverage
+                    if (src[col] > dst[x]) dst[x] = src[col];
+                }
+            }
+            pen += g.advance + letterSpacing;
+        }
+    }
+
+    // Row y of the text, indexable from -PAD to width + PAD
+    uint8_t* Row(int y) { return &mask[(size_t)(y + PAD) * stride + PAD]; }
+    const uint8_t* Row(int y) const { return &mask[(size_t)(y + PAD) * stride + PAD]; }
+};
+
+// Composites a layout with its top-left at (x, y) and its shadow shadowOffset pixels down and right.
+// A recorded draw refers to the layout, which must not change before the recording is replayed.
+inline void DrawTextLayout(Surface& surface, int x, int y, const TextLayout& layout, Pixel color, int shadowOffset)
+{
+    if (shadowOffset < 0) shadowOffset = 0;
+    if (shadowOffset > TextLayout::PAD) shadowOffset = TextLayout::PAD;
+
+    IntRect placed = MakeRect(x, y, x + layout.width + shadowOffset, y + layout.height + shadowOffset);
+    if (surface.recorder)
+    {
+        const TextLayout* recorded = &layout;
+        surface.recorder->Record(surface, placed, [=](Surface& t) { DrawTextLayout(t, x, y, *recorded, color, shadowOffset); });
+        return;
+    }
+
+    IntRect r = RectIntersect(placed, surface.clip);
+    if (r.IsEmpty()) return;
+
+    Pixel shadowColor = (Pixel)(color & 0xFF000000);
+    const RasterKernels& k = ActiveRasterKernels();
+    for (int row = r.top; row < r.bottom; row++)
+    {
+        int ty = row - y, tx = r.left - x;
+        k.blendShadowMaskSpan(surface.Row(row) + r.left, layout.Row(ty) + tx,
+                              layout.Row(ty - shadowOffset) + tx - shadowOffset, r.Width(), color, shadowColor);
+    }
+}
+
+// A line of text bound to values. Format() only runs the formatter, and the
+// renderer only lays the line out again, when the format or an argument
+// changed since the last call. String arguments are compared by pointer, so
+// pass literals or other strings that live as long as the line.
+class TextLine
+{
+public:
+    static const int MAX_LENGTH = 96;
+
+    template <class... Args>
+    const char* Format(const char* format, Args... args)
+    {
+        uint64_t key = HashArgs(HashCombine(0, (uint64_t)(uintptr_t)format), args...);
+        if (!version || key != formatKey)
+        {
+            snprintf(text, sizeof(text), format, args...);
+            formatKey = key;
+            version++;
+        }
+        return text;
+    }
+
+    // Fixed text, compared by pointer like a string argument
+    const char* Set(const char* value) { return Format("%s", value); }
+
+    const char* Text() const { return text; }
+    uint64_t Version() const { return version; }
+
+    // Layout cache, filled in by the renderer that draws the line
+    TextLayout layout;
+    uint64_t layoutVersion = 0;
+    uint64_t layoutAtlas = 0;
+    int layoutSpacing = 0;
+
+private:
+    static uint64_t HashArgs(uint64_t h) { return h; }
+
+    template <class T, class... Rest>
+    static uint64_t HashArgs(uint64_t h, T value, Rest... rest)
+    {
+        return HashArgs(HashCombine(h, ArgBits(value)), rest...);
+    }
+
+    template <class T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, uint64_t>::type ArgBits(T value)
+    {
+        return (uint64_t)value;
+    }
+
+    static uint64_t ArgBits(double value)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static uint64_t ArgBits(const char* value) { return (uint64_t)(uintptr_t)value; }
+
+    char text[MAX_LENGTH] = {};
+    uint64_t formatKey = 0;
+    uint64_t version = 0;
+};
+
+// Draws strings with a drop shadow
+class TextRenderer
+{
+public:
+    virtual ~TextRenderer() {}
+
+    // Shadow is drawn in black shadowOffset pixels down and to the right.
+    // letterSpacing adds extra pixels after each character.
+    virtual void DrawString(Surface& surface, int x, int y, const char* text, Pixel color,
+                            int shadowOffset = 1, int letterSpacing = 0) = 0;
+
+    // Same, for a line whose layout may be cached between frames
+    virtual void DrawLine(Surface& surface, int x, int y, TextLine& line, Pixel color,
+                          int shadowOffset = 1, int letterSpacing = 0)
+    {
+        DrawString(surface, x, y, line.Text(), color, shadowOffset, letterSpacing);
+    }
+
+    // Rectangle DrawString would touch, shadow included
+    virtual IntRect Measure(int x, int y, const char* text, int shadowOffset = 1, int letterSpacing = 0) = 0;
+};
+
+class AtlasTextRenderer : public TextRenderer
+{
+public:
+    bool Build(GlyphSource& source) { return atlas.Build(source); }
+    const GlyphAtlas& Atlas() const { return atlas; }
+
+    void DrawString(Surface& surface, int x, int y, const char* text, Pixel color, int shadowOffset, int letterSpacing) override
+    {
+        scratch.Build(atlas, text, letterSpacing);
+        if (surface.recorder)
+        {
+            // The scratch layout is reused by the next string, so the recording keeps its own copy
+            TextLayout layout = scratch;
+            IntRect placed = Measure(x, y, text, shadowOffset, letterSpacing);
+            surface.recorder->Record(surface, placed, [=](Surface& t) { DrawTextLayout(t, x, y, layout, color, shadowOffset); });
+            return;
+        }
+        DrawTextLayout(surface, x, y, scratch, color, shadowOffset);
+    }
+
+    void DrawLine(Surface& surface, int x, int y, TextLine& line, Pixel color, int shadowOffset, int letterSpacing) override
+    {
+        if (line.layoutVersion != line.Version() || line.layoutAtlas != atlas.Id() || line.layoutSpacing != letterSpacing)
+        {
+            line.layout.Build(atlas, line.Text(), letterSpacing);
+            line.layoutVersion = line.Version();
+            line.layoutAtlas = atlas.Id();
+            line.layoutSpacing = letterSpacing;
+        }
+        DrawTextLayout(surface, x, y, line.layout, color, shadowOffset);
+    }
+
+    IntRect Measure(int x, int y, const char* text, int shadowOffset, int letterSpacing) override
+    {
+        return MakeRect(x, y, x + atlas.MeasureWidth(text, letterSpacing) + shadowOffset, y + atlas.LineHeight() + shadowOffset);
+    }
+
+private:
+    GlyphAtlas atlas;
+    TextLayout scratch;
+};
+
+#endif //TEXT_H
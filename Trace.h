@@ -0,0 +1,323 @@
+// Trace.h: recorded overlay sessions, for replaying them headless.
+//
+// A trace holds everything from outside that steered the overlay's loop, in
+// the order the loop saw it: when each iteration woke up, the key events it
+// read, the frames the host asked for, monitor size changes, the quality
+// levels the governor picked, the profiles the host applied and the
+// iterations whose frame the host held back for the compositor. With those and
+// a clock that only moves when told to, the loop runs the same way every time.
+// The settings after each change and the sources that fired each frame follow
+// from the rest; they are recorded anyway so a replay can tell whether it has
+// kept in step.
+//
+// The file is a header followed by records, each a type byte and varint
+// fields with times as deltas, so most records take two to four bytes.
+// Settings are written field by field through the menu table rather than as
+// raw struct bytes, so a trace recorded by the DLL reads the same in any
+// build with the same menu rows.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "Widgets.h"
+#include "KeyInput.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+const char TRACE_MAGIC[8] = { 'A', 'S', 'T', 'R', 'T', 'R', 'C', '1' };
+const int TRACE_VERSION = 1;
+
+enum TraceRecordType
+{
+    TRACE_TICK = 1, // a loop iteration woke up
+    TRACE_KEY,      // key event read by the iteration
+    TRACE_REQUEST,  // the host asked for a frame
+    TRACE_MONITOR,  // the monitor changed size
+    TRACE_QUALITY,  // the governor moved to another quality level
+    TRACE_SETTINGS, // settings after a change, for checking
+    TRACE_FRAME,    // sources that fired a frame, for checking
+    TRACE_PROFILE,  // the host applied a settings profile
+    TRACE_HOLD      // the host held the iteration's frame back (FramePacer.h)
+};
+
+struct TraceRecord
+{
+    TraceRecordType type = TRACE_TICK;
+    int64_t timeNs = 0;   // TRACE_TICK: when the iteration woke up
+    KeyEvent key;         // TRACE_KEY
+    int width = 0, height = 0; // TRACE_MONITOR
+    int level = 0;        // TRACE_QUALITY
+    OverlaySettings settings; // TRACE_SETTINGS, TRACE_PROFILE
+    uint32_t fired = 0;   // TRACE_FRAME
+};
+
+class TraceWriter
+{
+public:
+    ~TraceWriter() { Close(); }
+
+    // Starts a trace of a loop whose clock reads startNs, on a monitor of the
+    // given size, with these settings. Returns false if the file can't be created.
+    bool Open(const char* path, int64_t startNs, int monitorWidth, int monitorHeight, const OverlaySettings& settings)
+    {
+        Close();
+#if defined(_MSC_VER)
+        if (fopen_s(&file, path, "wb") != 0) file = nullptr;
+#else
+        file = fopen(path, "wb");
+#endif
+        if (!file) return false;
+
+        buffer.assign(TRACE_MAGIC, TRACE_MAGIC + sizeof(TRACE_MAGIC));
+        PutVarint(TRACE_VERSION);
+        PutVarint(MENU_ITEM_COUNT);
+        PutSigned(startNs);
+        PutVarint((uint64_t)monitorWidth);
+        PutVarint((uint64_t)monitorHeight);
+        PutSettings(settings);
+        lastTickNs = startNs;
+        tickNs = startNs;
+        return true;
+    }
+
+    // Writes out what is buffered and closes the file
+    void Close()
+    {
+        if (!file) return;
+        Flush();
+        fclose(file);
+        file = nullptr;
+    }
+
+    bool IsOpen() const { return file != nullptr; }
+
+    void Tick(int64_t nowNs)
+    {
+        Put(TRACE_TICK);
+        PutVarint((uint64_t)(nowNs - lastTickNs));
+        lastTickNs = tickNs = nowNs;
+    }
+
+    void Key(const KeyEvent& e)
+    {
+        Put(TRACE_KEY);
+        PutVarint(e.key);
+        Put(e.down ? 1 : 0);
+        PutSigned(e.timeNs - tickNs); // captured a little before the iteration read it
+    }
+
+    void Request() { Put(TRACE_REQUEST); }
+
+    void Monitor(int width, int height)
+    {
+        Put(TRACE_MONITOR);
+        PutVarint((uint64_t)width);
+        PutVarint((uint64_t)height);
+    }
+
+    void Quality(int level)
+    {
+        Put(TRACE_QUALITY);
+        PutVarint((uint64_t)level);
+    }
+
+    void Settings(const OverlaySettings& s)
+    {
+        Put(TRACE_SETTINGS);
+        PutSettings(s);
+    }
+
+    void Frame(uint32_t fired)
+    {
+        Put(TRACE_FRAME);
+        PutVarint(fired);
+    }
+
+    void Profile(const OverlaySettings& s)
+    {
+        Put(TRACE_PROFILE);
+        PutSettings(s);
+    }
+
+    void Hold() { Put(TRACE_HOLD); }
+
+private:
+    static const size_t FLUSH_BYTES = 64 * 1024;
+
+    void Flush()
+    {
+        if (!buffer.empty())
+            fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+
+    void Put(int byte)
+    {
+        buffer.push_back((uint8_t)byte);
+        if (buffer.size() >= FLUSH_BYTES)
+            Flush();
+    }
+
+    void PutVarint(uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            Put((int)(v & 0x7F) | 0x80);
+            v >>= 7;
+        }
+        Put((int)v);
+    }
+
+    // Zigzag, so small negative numbers stay short
+    void PutSigned(int64_t v)
+    {
+        PutVarint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+    }
+
+    void PutSettings(const OverlaySettings& s)
+    {
+        PutSigned(s.menuOpen);
+        PutSigned(s.menuSelection);
+        for (int i = 0; i < MENU_ITEM_COUNT; i++)
+            PutSigned(MENU_ITEMS[i].get(s));
+        PutSigned(s.scopeVignetteWidth);
+    }
+
+    FILE* file = nullptr;
+    std::vector<uint8_t> buffer;
+    int64_t lastTickNs = 0;
+    int64_t tickNs = 0;
+};
+
+class TraceReader
+{
+public:
+    // Reads the whole file. Returns false if it can't be read or isn't a trace this build understands.
+    bool Open(const char* path)
+    {
+        FILE* f = nullptr;
+#if defined(_MSC_VER)
+        if (fopen_s(&f, path, "rb") != 0) f = nullptr;
+#else
+        f = fopen(path, "rb");
+#endif
+        if (!f) return false;
+        data.clear();
+        uint8_t chunk[64 * 1024];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+            data.insert(data.end(), chunk, chunk + n);
+        fclose(f);
+
+        pos = 0;
+        failed = false;
+        if (data.size() < sizeof(TRACE_MAGIC) || memcmp(data.data(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0)
+            return false;
+        pos = sizeof(TRACE_MAGIC);
+        if (GetVarint() != TRACE_VERSION || GetVarint() != (uint64_t)MENU_ITEM_COUNT)
+            return false;
+        startNs = GetSigned();
+        monitorWidth = (int)GetVarint();
+        monitorHeight = (int)GetVarint();
+        GetSettings(startSettings);
+        tickNs = startNs;
+        return !failed;
+    }
+
+    int64_t StartNs() const { return startNs; }
+    int MonitorWidth() const { return monitorWidth; }
+    int MonitorHeight() const { return monitorHeight; }
+    const OverlaySettings& StartSettings() const { return startSettings; }
+    size_t Bytes() const { return data.size(); }
+
+    // Next record, or false at the end of the trace or at a record that is cut short
+    bool Next(TraceRecord& r)
+    {
+        if (pos >= data.size() || failed) return false;
+        r = TraceRecord();
+        r.type = (TraceRecordType)Get();
+        switch (r.type)
+        {
+        case TRACE_TICK:
+            tickNs += (int64_t)GetVarint();
+            r.timeNs = tickNs;
+            break;
+        case TRACE_KEY:
+            r.key.key = (uint16_t)GetVarint();
+            r.key.down = Get() != 0;
+            r.key.timeNs = tickNs + GetSigned();
+            break;
+        case TRACE_REQUEST:
+        case TRACE_HOLD:
+            break;
+        case TRACE_MONITOR:
+            r.width = (int)GetVarint();
+            r.height = (int)GetVarint();
+            break;
+        case TRACE_QUALITY:
+            r.level = (int)GetVarint();
+            break;
+        case TRACE_SETTINGS:
+        case TRACE_PROFILE:
+            GetSettings(r.settings);
+            break;
+        case TRACE_FRAME:
+            r.fired = (uint32_t)GetVarint();
+            break;
+        default:
+            failed = true;
+        }
+        return !failed;
+    }
+
+private:
+    int Get()
+    {
+        if (pos >= data.size())
+        {
+            failed = true;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    uint64_t GetVarint()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            int b = Get();
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+        return v;
+    }
+
+    int64_t GetSigned()
+    {
+        uint64_t v = GetVarint();
+        return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+
+    void GetSettings(OverlaySettings& s)
+    {
+        s = OverlaySettings();
+        s.menuOpen = GetSigned() != 0;
+        s.menuSelection = (int)GetSigned();
+        for (int i = 0; i < MENU_ITEM_COUNT; i++)
+            MENU_ITEMS[i].set(s, (int)GetSigned());
+        s.scopeVignetteWidth = (int)GetSigned();
+    }
+
+    std::vector<uint8_t> data;
+    size_t pos = 0;
+    bool failed = false;
+    int64_t startNs = 0;
+    int64_t tickNs = 0;
+    int monitorWidth = 0, monitorHeight = 0;
+    OverlaySettings startSettings;
+};
+
+#endif //TRACE_H
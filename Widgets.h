@@ -0,0 +1,515 @@
+// Widgets.h: the overlay widgets, drawn onto a Surface.
+//
+// Nothing in here touches Windows. Widgets get their inputs as plain values
+// (an OverlaySettings copy, positions, animation time) and draw text through
+// a TextRenderer, so the same code runs in the DLL and in the headless
+// benchmark.
+
+#ifndef WIDGETS_H
+#define WIDGETS_H
+
+#include "Raster.h"
+#include "SpriteCache.h"
+#include "DirtyRegion.h"
+#include "Text.h"
+#include "Crosshair.h"
+#include "Animation.h"
+#include "CpuGovernor.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if !defined(_MSC_VER)
+// MSVC's bounds-checked sprintf, for the array form used by the widgets
+template <size_t N, class... Args>
+int sprintf_s(char (&buffer)[N], const char* format, Args... args)
+{
+    return snprintf(buffer, N, format, args...);
+}
+#endif
+
+// Everything the user can change from the menu
+struct OverlaySettings
+{
+    bool menuOpen = false;
+    int menuSelection = 0; // menu item index
+
+    bool crosshairEnabled = true;
+    int crosshairSize = 15;
+    int crosshairGap = 5;
+    CrosshairShape crosshairShape = SHAPE_PLUS;
+
+    int colorR = 0, colorG = 160, colorB = 255;
+    bool rainbowEnabled = false;
+
+    bool watermarkEnabled = true;
+
+    bool scopeOverlayEnabled = false;
+    int scopeRadius = 100;
+    int scopeOffsetX = 0;
+    int scopeOffsetY = 0;
+    int scopeVignetteWidth = 50;
+
+    bool operator==(const OverlaySettings& o) const
+    {
+        return menuOpen == o.menuOpen && menuSelection == o.menuSelection &&
+               crosshairEnabled == o.crosshairEnabled && crosshairSize == o.crosshairSize &&
+               crosshairGap == o.crosshairGap && crosshairShape == o.crosshairShape &&
+               colorR == o.colorR && colorG == o.colorG && colorB == o.colorB && rainbowEnabled == o.rainbowEnabled &&
+               watermarkEnabled == o.watermarkEnabled &&
+               scopeOverlayEnabled == o.scopeOverlayEnabled && scopeRadius == o.scopeRadius &&
+               scopeOffsetX == o.scopeOffsetX && scopeOffsetY == o.scopeOffsetY && scopeVignetteWidth == o.scopeVignetteWidth;
+    }
+    bool operator!=(const OverlaySettings& o) const { return !(*this == o); }
+};
+
+// --- Menu rows: one descriptor per row drives both drawing and key handling ---
+
+enum MenuItemKind
+{
+    MENU_TOGGLE, // Enter flips it
+    MENU_RANGE,  // Left/Right step it, stopping at the ends
+    MENU_CHOICE  // Left/Right step through named values, wrapping around
+};
+
+struct MenuItem
+{
+    const char* label;
+    MenuItemKind kind;
+    const char* format;             // row text, from the label and the value (or its name)
+    int minValue, maxValue, step;
+    int (*get)(const OverlaySettings&);
+    void (*set)(OverlaySettings&, int);
+    const char* (*valueName)(int);  // null to show the number
+};
+
+template <class T, T OverlaySettings::* Field>
+struct SettingField
+{
+    static int Get(const OverlaySettings& s) { return (int)(s.*Field); }
+    static void Set(OverlaySettings& s, int value) { s.*Field = (T)value; }
+};
+
+inline const char* OnOffName(int value)
+{
+    return value ? "ON" : "OFF";
+}
+
+inline const char* ShapeChoiceName(int value)
+{
+    return CrosshairShapeName((CrosshairShape)value);
+}
+
+template <bool OverlaySettings::* Field>
+constexpr MenuItem ToggleItem(const char* label)
+{
+    return { label, MENU_TOGGLE, "%s: %s", 0, 1, 1, SettingField<bool, Field>::Get, SettingField<bool, Field>::Set, OnOffName };
+}
+
+template <int OverlaySettings::* Field>
+constexpr MenuItem RangeItem(const char* label, int minValue, int maxValue, int step)
+{
+    return { label, MENU_RANGE, "%s: %d", minValue, maxValue, step, SettingField<int, Field>::Get, SettingField<int, Field>::Set, nullptr };
+}
+
+template <class T, T OverlaySettings::* Field>
+constexpr MenuItem ChoiceItem(const char* label, int count, const char* (*valueName)(int))
+{
+    return { label, MENU_CHOICE, "%s: %s", 0, count - 1, 1, SettingField<T, Field>::Get, SettingField<T, Field>::Set, valueName };
+}
+
+const MenuItem MENU_ITEMS[] =
+{
+    ToggleItem<&OverlaySettings::crosshairEnabled>("Crosshair"),
+    RangeItem<&OverlaySettings::crosshairSize>("Crosshair Size", 1, 50, 1),
+    RangeItem<&OverlaySettings::crosshairGap>("Crosshair Gap", 0, 20, 1),
+    ChoiceItem<CrosshairShape, &OverlaySettings::crosshairShape>("Crosshair Shape", SHAPE_COUNT, ShapeChoiceName),
+    RangeItem<&OverlaySettings::colorR>("Color R", 0, 255, 1),
+    RangeItem<&OverlaySettings::colorG>("Color G", 0, 255, 1),
+    RangeItem<&OverlaySettings::colorB>("Color B", 0, 255, 1),
+    ToggleItem<&OverlaySettings::rainbowEnabled>("Rainbow"),
+    ToggleItem<&OverlaySettings::watermarkEnabled>("Watermark"),
+    ToggleItem<&OverlaySettings::scopeOverlayEnabled>("Scope Overlay"),
+    RangeItem<&OverlaySettings::scopeRadius>("Scope Radius", 10, 300, 5),
+    RangeItem<&OverlaySettings::scopeOffsetX>("Scope Offset X", -500, 500, 5),
+    RangeItem<&OverlaySettings::scopeOffsetY>("Scope Offset Y", -500, 500, 5),
+};
+
+const int MENU_ITEM_COUNT = sizeof(MENU_ITEMS) / sizeof(MENU_ITEMS[0]);
+
+// Up/Down: moves the highlight, wrapping around
+inline void MenuMoveSelection(OverlaySettings& s, int delta)
+{
+    s.menuSelection = ((s.menuSelection + delta) % MENU_ITEM_COUNT + MENU_ITEM_COUNT) % MENU_ITEM_COUNT;
+}
+
+// Left/Right: direction -1 or +1 on the highlighted row
+inline void MenuAdjust(OverlaySettings& s, int direction)
+{
+    const MenuItem& item = MENU_ITEMS[s.menuSelection];
+    if (item.kind == MENU_TOGGLE) return;
+
+    int value = item.get(s) + direction * item.step;
+    if (item.kind == MENU_CHOICE)
+    {
+        int count = item.maxValue - item.minValue + 1;
+        value = item.minValue + ((value - item.minValue) % count + count) % count;
+    }
+    else
+    {
+        if (value < item.minValue) value = item.minValue;
+        if (value > item.maxValue) value = item.maxValue;
+    }
+    item.set(s, value);
+}
+
+// Enter on the highlighted row
+inline void MenuActivate(OverlaySettings& s)
+{
+    const MenuItem& item = MENU_ITEMS[s.menuSelection];
+    if (item.kind == MENU_TOGGLE)
+        item.set(s, !item.get(s));
+}
+
+// Palette
+const Pixel blueMain = PremultipliedColor(0, 160, 255);
+const Pixel blueDark = PremultipliedColor(0, 90, 140);
+const Pixel whiteColor = PremultipliedColor(255, 255, 255);
+const Pixel grayColor = PremultipliedColor(128, 128, 128);
+const Pixel redColor = PremultipliedColor(255, 80, 80);
+
+// Panels are drawn see-through so the game stays visible behind them
+const int panelAlpha = 200;
+
+// Text lines each widget keeps between frames so unchanged text is not
+// formatted or laid out again
+struct WidgetText
+{
+    TextLine watermark;
+    TextLine infoPanel[8];
+    TextLine menuTitle;
+    TextLine menuItems[MENU_ITEM_COUNT];
+    TextLine killEffect;
+};
+
+// Panel colour with the panel transparency applied
+inline Pixel PanelColor(Pixel opaque)
+{
+    return ScalePixel(opaque, panelAlpha);
+}
+
+// cornerSize is the corner ellipse size, as with GDI's RoundRect
+inline void DrawPanel(Surface& surface, const IntRect& rect, Pixel opaque, int cornerSize)
+{
+    FillRoundRect(surface, rect, cornerSize / 2.0f, PanelColor(opaque));
+}
+
+// --- Crosshair ---
+
+inline void DrawCrosshair(Surface& surface, int cx, int cy, Pixel color, int size, int gap, CrosshairShape shape)
+{
+    GetCrosshairShape(shape).draw(surface, cx, cy, color, size, gap);
+}
+
+inline IntRect CrosshairBounds(int cx, int cy, int size)
+{
+    // Pen is 2px wide, so pad past the line ends
+    return MakeRect(cx - size - 2, cy - size - 2, cx + size + 3, cy + size + 3);
+}
+
+// --- Scope ---
+
+const int SCOPE_VIGNETTE_WIDTH = 50;
+
+inline ScopeField ScopeStyle(int radius, int vignetteWidth)
+{
+    ScopeField f;
+    f.radius = (float)radius;
+    f.ringHalfWidth = 1.5f;                 // 3px white circle
+    f.vignetteWidth = (float)vignetteWidth; // dark falloff outside it
+    f.vignetteAlpha = 80 / 255.0f;
+    f.lineHalfWidth = 0.5f;                 // 1px cross through the middle pixel
+    return f;
+}
+
+inline void DrawScopeOverlay(Surface& surface, int cx, int cy, int radius, int offsetX = 0, int offsetY = 0,
+                             int vignetteWidth = SCOPE_VIGNETTE_WIDTH)
+{
+    DrawScopeField(surface, cx + offsetX, cy + offsetY, ScopeStyle(radius, vignetteWidth));
+}
+
+inline IntRect ScopeBounds(int cx, int cy, int radius, int offsetX, int offsetY, int vignetteWidth = SCOPE_VIGNETTE_WIDTH)
+{
+    int extent = ScopeFieldExtent(ScopeStyle(radius, vignetteWidth));
+    cx += offsetX;
+    cy += offsetY;
+    return MakeRect(cx - extent, cy - extent, cx + extent + 1, cy + extent + 1);
+}
+
+// --- Cached layers: crosshair and scope are rasterized once per parameter change ---
+
+enum SpriteLayer { LAYER_CROSSHAIR, LAYER_CROSSHAIR_COLORED, LAYER_SCOPE };
+
+inline void DrawCachedCrosshair(SpriteCache& cache, Surface& surface, int cx, int cy, Pixel color, int size, int gap, CrosshairShape shape)
+{
+    // The coverage mask depends only on the geometry, so rainbow mode reuses
+    // it; each colour is one recolour of the mask into the coloured layer
+    uint64_t key = HashCombine(HashCombine(HashCombine(0, size), gap), shape);
+    uint64_t coloredKey = HashCombine(key, color);
+    const Sprite* colored = cache.Find(LAYER_CROSSHAIR_COLORED, coloredKey);
+    if (!colored)
+    {
+        const Sprite* mask = cache.Find(LAYER_CROSSHAIR, key);
+        if (!mask)
+        {
+            IntRect extent = MakeRect(-size - 3, -size - 3, size + 3, size + 3);
+            mask = cache.Insert(LAYER_CROSSHAIR, key, RenderSprite(cache.Memory(), extent, true, [&](Surface& s, int ax, int ay)
+            {
+                DrawCrosshair(s, ax, ay, PremultipliedColor(255, 255, 255), size, gap, shape);
+            }));
+        }
+        if (mask)
+            colored = cache.Insert(LAYER_CROSSHAIR_COLORED, coloredKey, RecolorSprite(cache.Memory(), *mask, color));
+    }
+
+    if (colored)
+        BlitSprite(surface, *colored, cx, cy);
+    else
+        DrawCrosshair(surface, cx, cy, color, size, gap, shape);
+}
+
+inline void DrawCachedScope(SpriteCache& cache, Surface& surface, int cx, int cy, int radius, int offsetX, int offsetY,
+                            int vignetteWidth = SCOPE_VIGNETTE_WIDTH)
+{
+    // Offsets only move the sprite, so they are not part of the key
+    uint64_t key = HashCombine(HashCombine(0, radius), vignetteWidth);
+    const Sprite* sprite = cache.Find(LAYER_SCOPE, key);
+    if (!sprite)
+    {
+        int extent = ScopeFieldExtent(ScopeStyle(radius, vignetteWidth));
+        sprite = cache.Insert(LAYER_SCOPE, key, RenderSprite(cache.Memory(), MakeRect(-extent, -extent, extent + 1, extent + 1), false, [&](Surface& s, int ax, int ay)
+        {
+            DrawScopeOverlay(s, ax, ay, radius, 0, 0, vignetteWidth);
+        }));
+    }
+
+    if (sprite)
+        BlitSprite(surface, *sprite, cx + offsetX, cy + offsetY);
+    else
+        DrawScopeOverlay(surface, cx, cy, radius, offsetX, offsetY, vignetteWidth);
+}
+
+// --- Watermark: sways sideways and pulses, t is seconds since start ---
+
+// Default top-left corners, relative to the monitor
+const int WATERMARK_X = 10, WATERMARK_Y = 10;
+const int INFO_PANEL_X = 10, INFO_PANEL_Y = 40;
+const int MENU_X = 50, MENU_Y = 50;
+
+const int WATERMARK_MAX_SWAY = 5;
+
+inline int WatermarkSway(float t)
+{
+    return (int)(WATERMARK_MAX_SWAY * sinf(t * 2));
+}
+
+inline int WatermarkAlpha(float t)
+{
+    return (int)(165 + 65 * sinf(t * 3));
+}
+
+// Where the watermark is drawn at time t, with (x, y) its resting position
+inline IntRect WatermarkBounds(TextRenderer& text, int x, int y, float t)
+{
+    return text.Measure(x + WatermarkSway(t), y, "Astral");
+}
+
+// Everything the watermark covers over its whole sway
+inline IntRect WatermarkExtent(TextRenderer& text, int x, int y)
+{
+    return RectUnion(text.Measure(x - WATERMARK_MAX_SWAY, y, "Astral"), text.Measure(x + WATERMARK_MAX_SWAY, y, "Astral"));
+}
+
+inline void DrawWatermark(Surface& surface, TextRenderer& text, WidgetText& lines, int x, int y, float t)
+{
+    // Pulsing alpha
+    lines.watermark.Set("Astral");
+    text.DrawLine(surface, x + WatermarkSway(t), y, lines.watermark, PremultipliedColor(0, 160, 255, WatermarkAlpha(t)));
+}
+
+// --- Info panel ---
+
+inline IntRect InfoPanelBounds(int x, int y)
+{
+    return MakeRect(x, y, x + 271, y + 170);
+}
+
+inline void DrawInfoPanel(Surface& surface, TextRenderer& text, WidgetText& lines, const OverlaySettings& s, float fps,
+                          const CpuBudgetStatus& cpu, int x, int y)
+{
+    // The panel fills its bounds, down past the CPU line
+    IntRect bounds = InfoPanelBounds(x, y);
+    DrawPanel(surface, MakeRect(bounds.left, bounds.top, bounds.right - 1, bounds.bottom - 1), PremultipliedColor(0, 0, 0), 10);
+
+    TextLine* line = lines.infoPanel;
+    line[0].Format("FPS: %.1f", fps);
+    text.DrawLine(surface, x + 10, y + 10, line[0], whiteColor);
+
+    line[1].Format("Crosshair: %s", s.crosshairEnabled ? "ON" : "OFF");
+    text.DrawLine(surface, x + 10, y + 30, line[1], s.crosshairEnabled ? blueMain : grayColor);
+
+    line[2].Format("Watermark: %s", s.watermarkEnabled ? "ON" : "OFF");
+    text.DrawLine(surface, x + 10, y + 50, line[2], s.watermarkEnabled ? blueMain : grayColor);
+
+    line[3].Format("Scope Overlay: %s", s.scopeOverlayEnabled ? "ON" : "OFF");
+    text.DrawLine(surface, x + 10, y + 70, line[3], s.scopeOverlayEnabled ? blueMain : grayColor);
+
+    line[4].Format("Scope Radius: %d", s.scopeRadius);
+    text.DrawLine(surface, x + 10, y + 90, line[4], blueMain);
+
+    line[5].Format("Scope Offset X: %d", s.scopeOffsetX);
+    text.DrawLine(surface, x + 10, y + 110, line[5], blueMain);
+
+    line[6].Format("Scope Offset Y: %d", s.scopeOffsetY);
+    text.DrawLine(surface, x + 10, y + 130, line[6], blueMain);
+
+    // Overlay CPU use against its budget, and the quality the governor settled on
+    if (cpu.budget > 0.0)
+        line[7].Format("CPU: %.2f%% / %.2f%% (%s)", cpu.usage * 100.0, cpu.budget * 100.0, cpu.levelName);
+    else
+        line[7].Format("CPU: %.2f%% (no budget)", cpu.usage * 100.0);
+    text.DrawLine(surface, x + 10, y + 150, line[7], cpu.OverBudget() ? redColor : grayColor);
+}
+
+// --- Menu ---
+
+inline IntRect MenuBounds(int x, int y)
+{
+    return MakeRect(x, y, x + 351, y + 401);
+}
+
+// The strip of panel one row of text owns; rows never overlap
+inline IntRect MenuRowBounds(int x, int y, int row)
+{
+    return MakeRect(x + 10, y + 40 + row * 25, x + 340, y + 65 + row * 25);
+}
+
+// Widget ids for ReportMenu: the panel, then one per row
+const int MENU_WIDGET_PANEL = 0;
+const int MENU_WIDGET_FIRST_ROW = 1;
+static_assert(MENU_WIDGET_FIRST_ROW + MENU_ITEM_COUNT <= DirtyRegionTracker::MAX_WIDGETS, "a tracker widget per menu row");
+
+// What a row shows: its value and whether it is highlighted
+inline uint64_t MenuRowKey(const OverlaySettings& s, int row)
+{
+    return HashCombine(HashCombine(0, (uint32_t)MENU_ITEMS[row].get(s)), row == s.menuSelection);
+}
+
+// Reports the menu row by row, so a change only damages the rows it touches
+// and moving the highlight repaints two rows rather than the whole panel
+inline void ReportMenu(DirtyRegionTracker& tracker, const OverlaySettings& s, int x, int y)
+{
+    tracker.Report(MENU_WIDGET_PANEL, MenuBounds(x, y), 1);
+    for (int i = 0; i < MENU_ITEM_COUNT; i++)
+        tracker.Report(MENU_WIDGET_FIRST_ROW + i, MenuRowBounds(x, y, i), MenuRowKey(s, i));
+}
+
+// Draws what overlaps the surface's clip rectangle; rows outside it are skipped
+inline void DrawMenu(Surface& surface, TextRenderer& text, WidgetText& lines, const OverlaySettings& s, int x, int y)
+{
+    DrawPanel(surface, MakeRect(x, y, x + 350, y + 400), blueDark, 15);
+
+    lines.menuTitle.Set("Cheat Menu (Use Arrow Keys + Enter)");
+    text.DrawLine(surface, x + 10, y + 10, lines.menuTitle, whiteColor);
+
+    for (int i = 0; i < MENU_ITEM_COUNT; i++)
+    {
+        if (!RectsOverlap(MenuRowBounds(x, y, i), surface.clip)) continue;
+
+        const MenuItem& item = MENU_ITEMS[i];
+        TextLine& line = lines.menuItems[i];
+        int value = item.get(s);
+        if (item.valueName)
+            line.Format(item.format, item.label, item.valueName(value));
+        else
+            line.Format(item.format, item.label, value);
+
+        Pixel color = (i == s.menuSelection) ? blueMain : whiteColor;
+        text.DrawLine(surface, x + 20, y + 40 + i * 25, line, color);
+    }
+}
+
+// --- Kill effect: "KILL!" floats up and fades out; any number play at once ---
+
+struct KillEffect
+{
+    int x = 0, y = 0; // starting top-left, in the coordinates the pool is drawn in
+};
+
+const int KILL_EFFECT_CAPACITY = 128;
+typedef AnimationPool<KillEffect, KILL_EFFECT_CAPACITY> KillEffectPool;
+
+const int64_t KILL_EFFECT_DURATION_NS = 1500 * NS_PER_MS;
+const int KILL_EFFECT_RISE = 30; // pixels over the whole effect
+
+inline IntRect KillEffectBounds(TextRenderer& text, int x, int y)
+{
+    return text.Measure(x, y, "KILL!", 2, 2);
+}
+
+// Everything one effect covers over its whole rise
+inline IntRect KillEffectExtent(TextRenderer& text, int x, int y)
+{
+    return RectUnion(KillEffectBounds(text, x, y - KILL_EFFECT_RISE), KillEffectBounds(text, x, y));
+}
+
+// progress runs from 0 to 1 over the effect's lifetime
+inline int KillEffectAlpha(float progress)
+{
+    return (int)(255 * (1.0f - progress)); // fade out
+}
+
+inline int KillEffectRise(float progress, Easing easing)
+{
+    return (int)(KILL_EFFECT_RISE * Ease(easing, progress));
+}
+
+inline void DrawKillEffect(Surface& surface, TextRenderer& text, WidgetText& lines, int x, int y, float progress,
+                           Easing easing = EASE_OUT_CUBIC)
+{
+    lines.killEffect.Set("KILL!");
+    text.DrawLine(surface, x, y - KillEffectRise(progress, easing), lines.killEffect,
+                  PremultipliedColor(255, 50, 50, KillEffectAlpha(progress)), 2, 2);
+}
+
+inline IntRect KillEffectsExtent(TextRenderer& text, const KillEffectPool& effects)
+{
+    IntRect extent;
+    for (const KillEffectPool::Instance& e : effects)
+        extent = RectUnion(extent, KillEffectExtent(text, e.value.x, e.value.y));
+    return extent;
+}
+
+// Changes whenever a running effect would look different
+inline uint64_t KillEffectsKey(const KillEffectPool& effects, int64_t nowNs)
+{
+    uint64_t key = HashCombine(0, effects.Count());
+    for (const KillEffectPool::Instance& e : effects)
+    {
+        float progress = e.Progress(nowNs);
+        key = HashCombine(key, (uint64_t)KillEffectAlpha(progress) | (uint64_t)KillEffectRise(progress, e.easing) << 8);
+        key = HashCombine(key, (uint64_t)(uint32_t)e.value.x | (uint64_t)(uint32_t)e.value.y << 32);
+    }
+    return key;
+}
+
+// Draws every running effect as it is at nowNs, oldest first so the newest is on top.
+// (originX, originY) is where the surface's top-left corner is in the pool's coordinates.
+inline void DrawKillEffects(Surface& surface, TextRenderer& text, WidgetText& lines, const KillEffectPool& effects,
+                            int64_t nowNs, int originX, int originY)
+{
+    for (const KillEffectPool::Instance& e : effects)
+        DrawKillEffect(surface, text, lines, e.value.x - originX, e.value.y - originY, e.Progress(nowNs), e.easing);
+}
+
+#endif //WIDGETS_H
@@ -0,0 +1,37 @@
+// BlockGlyphSource.h: a font for running the overlay without Windows.
+
+#ifndef BLOCK_GLYPH_SOURCE_H
+#define BLOCK_GLYPH_SOURCE_H
+
+#include "Text.h"
+
+// Stand-in for the GDI glyph source: every non-space character is a 7x13
+// cell with anti-aliased left and right edges on an 8px advance. The atlas,
+// layout and blit code is the same the DLL runs.
+class BlockGlyphSource : public GlyphSource
+{
+public:
+    static const int ADVANCE = 8;
+    static const int CELL_WIDTH = 7;
+    static const int CELL_HEIGHT = 13;
+
+    int LineHeight() override { return CELL_HEIGHT + 3; }
+
+    bool Rasterize(char c, GlyphBitmap& glyph) override
+    {
+        glyph.advance = ADVANCE;
+        glyph.left = 0;
+        glyph.top = 2;
+        glyph.width = c == ' ' ? 0 : CELL_WIDTH;
+        glyph.height = c == ' ' ? 0 : CELL_HEIGHT;
+        glyph.coverage.assign((size_t)glyph.width * glyph.height, 255);
+        for (int y = 0; y < glyph.height; y++)
+        {
+            glyph.coverage[(size_t)y * glyph.width] = 96;
+            glyph.coverage[(size_t)y * glyph.width + glyph.width - 1] = 96;
+        }
+        return true;
+    }
+};
+
+#endif //BLOCK_GLYPH_SOURCE_H
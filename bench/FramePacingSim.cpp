@@ -0,0 +1,272 @@
+// FramePacingSim.cpp: immediate against compositor frame pacing on a simulated display.
+//
+// Runs the overlay's loop the way the DLL runs it, with FramePacer.h deciding
+// when frames start. It runs on a virtual clock against a display that
+// refreshes at a fixed rate, so it needs no Windows. The same random key
+// presses go through both pacing modes: the menu opens, then selections move
+// and kill effects start. Nothing is drawn. Each frame takes a random time
+// around --draw-us to draw, and its present lands --present-us after that.
+// The wait's timer wakes the loop up to --timer-late-us late, as a Windows
+// timer does, and a key wakes it at once.
+//
+// For each mode it reports:
+// - key down to the refresh that shows it;
+// - frame start to that refresh, whose spread is the jitter a viewer sees in
+//   animation;
+// - frames replaced before any refresh showed them;
+// - frames that missed the refresh the pacer aimed them at.
+// The refresh that shows a frame is the simulated display's, not what the
+// pacer predicted.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -I. bench/FramePacingSim.cpp -o frame_pacing_sim
+//   cl /std:c++17 /O2 /EHsc /I. bench\FramePacingSim.cpp
+//
+// Usage:
+//   frame_pacing_sim [--refresh-hz HZ] [--draw-us US] [--present-us US] [--timer-late-us US]
+//                    [--seconds S] [--seed N] [--json]
+
+#include "Overlay.h"
+#include "FramePacer.h"
+#include "BlockGlyphSource.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct SimOptions
+{
+    double refreshHz = 60.0;
+    double drawUs = 600.0;
+    double presentUs = 200.0;
+    double timerLateUs = 500.0;
+    double seconds = 60.0;
+    uint32_t seed = 1;
+    bool json = false;
+};
+
+// Small and the same everywhere, so a seed gives the same session on any machine
+class SimRandom
+{
+public:
+    explicit SimRandom(uint32_t seed) : state(seed * 2654435761u + 1) {}
+
+    // In [0, 1)
+    double Next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state / 4294967296.0;
+    }
+
+private:
+    uint32_t state;
+};
+
+// Presses at random times: the first opens the menu, the rest move its
+// selection or start a kill effect
+std::vector<KeyEvent> MakeKeys(const SimOptions& options)
+{
+    SimRandom random(options.seed);
+    std::vector<KeyEvent> keys;
+    int64_t endNs = (int64_t)(options.seconds * NS_PER_SEC);
+    int64_t t = 500 * NS_PER_MS;
+    for (int i = 0; t < endNs; i++)
+    {
+        KeyEvent down;
+        double pick = random.Next();
+        down.key = (uint16_t)(i == 0 ? OVERLAY_KEY_INSERT : pick < 0.4 ? OVERLAY_KEY_DOWN : pick < 0.8 ? OVERLAY_KEY_UP : OVERLAY_KEY_KILL);
+        down.down = true;
+        down.timeNs = t;
+        KeyEvent up = down;
+        up.down = false;
+        up.timeNs = t + 80 * NS_PER_MS;
+        keys.push_back(down);
+        keys.push_back(up);
+
+        // Half a second apart on average, never while the last key is held
+        t = up.timeNs + (int64_t)(-std::log(1.0 - random.Next()) * 420 * NS_PER_MS);
+    }
+    return keys;
+}
+
+// Nearest-rank percentile of sorted values
+double Percentile(const std::vector<int64_t>& sorted, double p)
+{
+    if (sorted.empty()) return 0.0;
+    size_t rank = (size_t)(p / 100.0 * sorted.size());
+    return (double)sorted[rank < sorted.size() ? rank : sorted.size() - 1];
+}
+
+struct SimResult
+{
+    std::vector<int64_t> inputNs; // key down to the refresh that showed it
+    std::vector<int64_t> lagNs;   // frame start to the refresh that showed it
+    uint64_t frames = 0;
+    uint64_t unseen = 0;          // replaced before a refresh showed them
+    uint64_t missed = 0;          // shown after the refresh they were aimed at
+    uint64_t iterations = 0;
+
+    double Mean(const std::vector<int64_t>& v) const
+    {
+        double sum = 0.0;
+        for (int64_t x : v) sum += (double)x;
+        return v.empty() ? 0.0 : sum / v.size();
+    }
+
+    double Spread(const std::vector<int64_t>& v) const
+    {
+        double mean = Mean(v), sum = 0.0;
+        for (int64_t x : v) sum += ((double)x - mean) * ((double)x - mean);
+        return v.empty() ? 0.0 : std::sqrt(sum / v.size());
+    }
+};
+
+// --- Loop ---
+
+// The DLL's loop against the simulated display, without drawing
+SimResult Run(PacingMode mode, const SimOptions& options, const std::vector<KeyEvent>& keys, TextRenderer& text)
+{
+    ManualClock clock;
+    FixedRefreshSource display(options.refreshHz, 3100 * NS_PER_US);
+    FramePacer pacer(clock, display);
+    pacer.SetMode(mode);
+    Overlay overlay(clock, text, 0.0);
+    overlay.SetMonitorSize(1920, 1080);
+
+    SimRandom random(options.seed + 1);
+    SimResult result;
+    int64_t endNs = (int64_t)(options.seconds * NS_PER_SEC);
+    int64_t lastShownNs = -1;
+    size_t nextKey = 0;
+    bool keyDown[256] = {};
+    while (clock.NowNs() < endNs)
+    {
+        // WaitForNextFrame: the timer wakes late, a key at once
+        int64_t now = clock.NowNs();
+        int64_t wake = pacer.StartNs(overlay.NextWakeNs());
+        int64_t keyNs = nextKey < keys.size() ? keys[nextKey].timeNs : NO_DEADLINE;
+        if (wake > now && keyNs > now)
+        {
+            int64_t timerNs = wake == NO_DEADLINE ? NO_DEADLINE : wake + (int64_t)(random.Next() * options.timerLateUs * NS_PER_US);
+            int64_t t = timerNs < keyNs ? timerNs : keyNs;
+            if (t == NO_DEADLINE) break;
+            clock.Set(t);
+        }
+        result.iterations++;
+
+        overlay.StartIteration();
+        overlay.ProcessInput([&](KeyEvent& e)
+        {
+            if (nextKey >= keys.size() || keys[nextKey].timeNs > clock.NowNs())
+                return false;
+            e = keys[nextKey++];
+            if (e.down && !keyDown[e.key & 0xFF])
+                pacer.KeyDown(e.timeNs);
+            keyDown[e.key & 0xFF] = e.down;
+            return true;
+        });
+
+        if (pacer.Hold(overlay.NextWakeNs()))
+        {
+            overlay.HoldFrame();
+            continue;
+        }
+        uint32_t fired = overlay.BeginFrame();
+        PacedFrame f = pacer.FrameBegun(fired);
+        if (!fired)
+            continue;
+
+        // Drawn on the overlay thread, then presented on the present thread
+        double drawScale = 0.5 + random.Next();
+        clock.Advance((int64_t)(options.drawUs * drawScale * NS_PER_US));
+        int64_t presentNs = clock.NowNs() + (int64_t)(options.presentUs * NS_PER_US);
+        pacer.Presented(f, presentNs);
+
+        int64_t shownNs = display.NextRefreshNs(presentNs);
+        result.frames++;
+        if (shownNs == lastShownNs)
+            result.unseen++;
+        lastShownNs = shownNs;
+        if (f.inputNs)
+            result.inputNs.push_back(shownNs - f.inputNs);
+        result.lagNs.push_back(shownNs - f.startNs);
+        if (f.targetNs && shownNs > f.targetNs)
+            result.missed++;
+    }
+
+    std::sort(result.inputNs.begin(), result.inputNs.end());
+    std::sort(result.lagNs.begin(), result.lagNs.end());
+    return result;
+}
+
+// --- Report ---
+
+void PrintResult(PacingMode mode, const SimOptions& options, const SimResult& r)
+{
+    const std::vector<int64_t>& in = r.inputNs;
+    const std::vector<int64_t>& lag = r.lagNs;
+    if (options.json)
+    {
+        printf("{\"mode\":\"%s\",\"refresh_hz\":%.2f,\"seconds\":%.1f,\"iterations\":%llu,\"frames\":%llu,\"unseen\":%llu,\"missed\":%llu,"
+               "\"inputs\":%zu,\"input_mean_ms\":%.3f,\"input_p50_ms\":%.3f,\"input_p95_ms\":%.3f,\"input_p99_ms\":%.3f,"
+               "\"lag_mean_ms\":%.3f,\"lag_p50_ms\":%.3f,\"lag_p99_ms\":%.3f,\"jitter_ms\":%.3f}\n",
+               PACING_MODE_NAMES[mode], options.refreshHz, options.seconds, (unsigned long long)r.iterations, (unsigned long long)r.frames,
+               (unsigned long long)r.unseen, (unsigned long long)r.missed, in.size(), r.Mean(in) / 1e6, Percentile(in, 50) / 1e6,
+               Percentile(in, 95) / 1e6, Percentile(in, 99) / 1e6, r.Mean(lag) / 1e6, Percentile(lag, 50) / 1e6, Percentile(lag, 99) / 1e6,
+               r.Spread(lag) / 1e6);
+        return;
+    }
+
+    printf("%s: %llu frames in %llu iterations, %llu never seen, %llu missed their refresh\n", PACING_MODE_NAMES[mode],
+           (unsigned long long)r.frames, (unsigned long long)r.iterations, (unsigned long long)r.unseen, (unsigned long long)r.missed);
+    printf("  key to shown   mean %6.2f ms  p50 %6.2f ms  p95 %6.2f ms  p99 %6.2f ms  (%zu presses)\n", r.Mean(in) / 1e6,
+           Percentile(in, 50) / 1e6, Percentile(in, 95) / 1e6, Percentile(in, 99) / 1e6, in.size());
+    printf("  frame lag      mean %6.2f ms  p50 %6.2f ms  p99 %6.2f ms  jitter %5.2f ms\n", r.Mean(lag) / 1e6, Percentile(lag, 50) / 1e6,
+           Percentile(lag, 99) / 1e6, r.Spread(lag) / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+    SimOptions options;
+    bool valid = true;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--json"))
+            options.json = true;
+        else if (!strcmp(arg, "--refresh-hz") && hasValue)
+            options.refreshHz = atof(argv[++i]);
+        else if (!strcmp(arg, "--draw-us") && hasValue)
+            options.drawUs = atof(argv[++i]);
+        else if (!strcmp(arg, "--present-us") && hasValue)
+            options.presentUs = atof(argv[++i]);
+        else if (!strcmp(arg, "--timer-late-us") && hasValue)
+            options.timerLateUs = atof(argv[++i]);
+        else if (!strcmp(arg, "--seconds") && hasValue)
+            options.seconds = atof(argv[++i]);
+        else if (!strcmp(arg, "--seed") && hasValue)
+            options.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else
+            valid = false;
+    }
+    if (!valid || options.refreshHz <= 0.0 || options.seconds <= 0.0 || options.drawUs < 0.0 || options.presentUs < 0.0 || options.timerLateUs < 0.0)
+    {
+        fprintf(stderr, "usage: %s [--refresh-hz HZ] [--draw-us US] [--present-us US] [--timer-late-us US] [--seconds S] [--seed N] [--json]\n",
+                argv[0]);
+        return 1;
+    }
+
+    BlockGlyphSource glyphs;
+    AtlasTextRenderer text;
+    text.Build(glyphs);
+
+    std::vector<KeyEvent> keys = MakeKeys(options);
+    for (int m = 0; m < PACING_MODE_COUNT; m++)
+        PrintResult((PacingMode)m, options, Run((PacingMode)m, options, keys, text));
+    return 0;
+}
@@ -0,0 +1,74 @@
+// MockPlatformBackend.h: the platform calls without Windows.
+
+#ifndef MOCK_PLATFORM_BACKEND_H
+#define MOCK_PLATFORM_BACKEND_H
+
+#include "Platform.h"
+
+// Stand-in for the DLL's Win32 backend: bitmaps are heap buffers, a DC
+// remembers what is selected into it, and presents, texts and signals only
+// count. Waits return at once, and there is no refresh to pace against. What
+// the tracker sees is the same calls the DLL makes for the same frames.
+class MockPlatformBackend : public PlatformBackend
+{
+public:
+    PlatformHandle CreateBitmap(int width, int height, Pixel** bits) override
+    {
+        Bitmap* b = new Bitmap();
+        b->pixels.assign((size_t)width * height, 0);
+        *bits = b->pixels.data();
+        return b;
+    }
+
+    void DeleteBitmap(PlatformHandle bitmap) override { delete (Bitmap*)bitmap; }
+
+    PlatformHandle CreateContext() override { return new Context(); }
+    void DeleteContext(PlatformHandle dc) override { delete (Context*)dc; }
+
+    PlatformHandle Select(PlatformHandle dc, PlatformHandle object) override
+    {
+        Context* c = (Context*)dc;
+        PlatformHandle previous = c->selected;
+        c->selected = object;
+        return previous;
+    }
+
+    void Text(PlatformHandle, int, int, const char*, int) override { texts++; }
+
+    void Present(PlatformHandle, PlatformHandle dc, int, int, int width, int height, const IntRect& dirty) override
+    {
+        // The DLL presents only with a bitmap selected; so must anything driving the mock
+        if (((Context*)dc)->selected)
+            presentedBytes += (uint64_t)RectIntersect(dirty, MakeRect(0, 0, width, height)).Area() * sizeof(Pixel);
+        else
+            badPresents++;
+        presents++;
+    }
+
+    void ShowWindow(PlatformHandle, bool) override {}
+
+    PlatformHandle CreateSignal() override { return new Object(); }
+    void Signal(PlatformHandle) override { signals++; }
+    void CloseSignal(PlatformHandle signal) override { delete (Object*)signal; }
+    PlatformHandle CreateTimer() override { return new Object(); }
+    void ArmTimer(PlatformHandle, int64_t) override {}
+    void CancelTimer(PlatformHandle) override {}
+    void CloseTimer(PlatformHandle timer) override { delete (Object*)timer; }
+    void Wait(const PlatformHandle*, int, bool) override {}
+
+    // No compositor: pacing starts frames when they come due
+    bool RefreshTiming(int64_t*, int64_t*) override { return false; }
+
+    uint64_t presents = 0;
+    uint64_t badPresents = 0; // with nothing selected into the DC
+    uint64_t presentedBytes = 0;
+    uint64_t texts = 0;
+    uint64_t signals = 0;
+
+private:
+    struct Bitmap { std::vector<Pixel> pixels; };
+    struct Context { PlatformHandle selected = nullptr; };
+    struct Object { int unused = 0; };
+};
+
+#endif //MOCK_PLATFORM_BACKEND_H
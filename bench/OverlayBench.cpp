@@ -0,0 +1,585 @@
+// OverlayBench.cpp: headless benchmark for the overlay widgets.
+//
+// Renders every widget into an offscreen surface at 1080p, 1440p and 4K and
+// reports time per frame, bytes written per frame and throughput. Runs
+// anywhere the widget headers compile; no Windows needed. The compose/ cases
+// record a frame once and replay it through the tile compositor on 1 to 8
+// threads, to measure how it scales.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -I. bench/OverlayBench.cpp -o overlay_bench -pthread
+//   cl /std:c++17 /O2 /EHsc /I. bench\OverlayBench.cpp
+//
+// Usage:
+//   overlay_bench [--json] [--tag NAME] [--filter TEXT] [--isa scalar|sse2|avx2] [--min-ms N]
+//
+// --json prints one JSON object per line (JSON Lines) so runs can be stored
+// and diffed across commits; --tag is copied into every record for that.
+
+#include "Widgets.h"
+#include "Color.h"
+#include "Overlay.h"
+#include "Profiles.h"
+#include "Compositor.h"
+#include "Clock.h"
+#include "Platform.h"
+#include "BlockGlyphSource.h"
+#include "MockPlatformBackend.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Resolution
+{
+    const char* name;
+    int width, height;
+};
+
+struct BenchOptions
+{
+    bool json = false;
+    const char* tag = "";
+    const char* filter = nullptr;
+    int64_t minNs = 100 * NS_PER_MS;
+};
+
+struct BenchContext
+{
+    Resolution resolution;
+    std::vector<Pixel> buffer;
+    Surface surface;
+    SpriteCache cache;
+    AtlasTextRenderer text;
+    WidgetText lines;
+    OverlaySettings settings;
+    CpuBudgetStatus cpu;
+    int cx = 0, cy = 0;
+};
+
+SteadyClock benchClock;
+const Pixel SENTINEL = 0x01020304;
+
+// Pixels that differ from the sentinel background after one run of the case
+long long CountWrittenPixels(BenchContext& ctx, const std::function<void()>& run)
+{
+    std::fill(ctx.buffer.begin(), ctx.buffer.end(), SENTINEL);
+    run();
+    long long written = 0;
+    for (Pixel p : ctx.buffer)
+        written += p != SENTINEL;
+    return written;
+}
+
+// budgetNs, when given, is the most a frame of the case may take; the report says if it was over.
+// bytesPerFrame, when given, replaces the bytes written for cases that read or copy rather than draw.
+void RunCase(BenchContext& ctx, const BenchOptions& options, const std::string& name, const std::function<void()>& run,
+             int64_t budgetNs = 0, double bytesPerFrame = 0)
+{
+    if (options.filter && name.find(options.filter) == std::string::npos)
+        return;
+
+    long long written = CountWrittenPixels(ctx, run);
+
+    // Calibrate a batch to about a tenth of the time budget, then keep the median batch
+    int64_t iterations = 1;
+    for (;;)
+    {
+        int64_t start = benchClock.NowNs();
+        for (int64_t i = 0; i < iterations; i++)
+            run();
+        int64_t elapsed = benchClock.NowNs() - start;
+        if (elapsed >= options.minNs / 10 || iterations >= (1 << 24))
+            break;
+        iterations *= 2;
+    }
+
+    std::vector<double> samples;
+    int64_t budgetStart = benchClock.NowNs();
+    while (samples.size() < 5 || (benchClock.NowNs() - budgetStart < options.minNs && samples.size() < 50))
+    {
+        int64_t start = benchClock.NowNs();
+        for (int64_t i = 0; i < iterations; i++)
+            run();
+        samples.push_back((double)(benchClock.NowNs() - start) / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+    double nsPerFrame = samples[samples.size() / 2];
+
+    // Keep the optimizer from discarding the drawing
+    volatile Pixel sink = ctx.buffer[ctx.buffer.size() / 2];
+    (void)sink;
+
+    double bytes = bytesPerFrame > 0 ? bytesPerFrame : (double)written * sizeof(Pixel);
+    double gbPerSec = nsPerFrame > 0 ? bytes / nsPerFrame : 0;
+    double mpixPerSec = nsPerFrame > 0 ? bytes / sizeof(Pixel) * 1000.0 / nsPerFrame : 0;
+    const char* isa = ActiveRasterKernels().name;
+    bool overBudget = budgetNs > 0 && nsPerFrame > budgetNs;
+
+    if (options.json)
+    {
+        printf("{\"tag\":\"%s\",\"bench\":\"%s\",\"resolution\":\"%s\",\"width\":%d,\"height\":%d,\"isa\":\"%s\","
+               "\"ns_per_frame\":%.1f,\"bytes_per_frame\":%.0f,\"gb_per_s\":%.3f,\"mpix_per_s\":%.1f,\"iterations\":%lld",
+               options.tag, name.c_str(), ctx.resolution.name, ctx.resolution.width, ctx.resolution.height, isa,
+               nsPerFrame, bytes, gbPerSec, mpixPerSec, (long long)(iterations * samples.size()));
+        if (budgetNs > 0)
+            printf(",\"budget_ns\":%lld,\"over_budget\":%s", (long long)budgetNs, overBudget ? "true" : "false");
+        printf("}\n");
+    }
+    else
+    {
+        printf("%-36s %-6s %-7s %12.0f ns %12.0f B %9.2f GB/s %9.1f Mpix/s",
+               name.c_str(), ctx.resolution.name, isa, nsPerFrame, bytes, gbPerSec, mpixPerSec);
+        if (overBudget)
+            printf("  OVER BUDGET (%lld ns)", (long long)budgetNs);
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+// Shape names as they appear in case names: "plus", "circle", ...
+std::string ShapeCaseName(CrosshairShape shape)
+{
+    std::string name = CrosshairShapeName(shape);
+    for (char& c : name)
+        c = (char)tolower((unsigned char)c);
+    return name;
+}
+
+void RunResolution(const Resolution& resolution, const BenchOptions& options)
+{
+    BenchContext ctx;
+    ctx.resolution = resolution;
+    ctx.buffer.assign((size_t)resolution.width * resolution.height, 0);
+    ctx.surface = Surface(ctx.buffer.data(), resolution.width, resolution.height, resolution.width);
+    ctx.cx = resolution.width / 2;
+    ctx.cy = resolution.height / 2;
+    ctx.cpu.usage = 0.0031; // a typical governor readout for the info panel
+    ctx.cpu.budget = 0.005;
+    BlockGlyphSource glyphs;
+    ctx.text.Build(glyphs);
+    Surface& s = ctx.surface;
+    char name[96];
+
+    const int sizes[] = { 5, 15, 30, 50 };
+    const int gaps[] = { 0, 5, 20 };
+    const int radii[] = { 50, 100, 200, 300 };
+    Pixel crosshairColor = PremultipliedColor(ctx.settings.colorR, ctx.settings.colorG, ctx.settings.colorB);
+
+    // Crosshair, rasterized every frame: from the compile-time tables where
+    // the size and gap have one, otherwise built on the fly
+    for (int shape = 0; shape < SHAPE_COUNT; shape++)
+        for (int size : sizes)
+            for (int gap : gaps)
+            {
+                if (gap >= size) continue;
+                sprintf_s(name, "crosshair/%s/size%d/gap%d", ShapeCaseName((CrosshairShape)shape).c_str(), size, gap);
+                RunCase(ctx, options, name, [&]
+                {
+                    DrawCrosshair(s, ctx.cx, ctx.cy, crosshairColor, size, gap, (CrosshairShape)shape);
+                });
+            }
+
+    // The same size and gap, always built on the fly, against its table above
+    for (int shape = 0; shape < SHAPE_COUNT; shape++)
+    {
+        sprintf_s(name, "crosshair_generic/%s/size15/gap5", ShapeCaseName((CrosshairShape)shape).c_str());
+        RunCase(ctx, options, name, [&]
+        {
+            GetCrosshairShape((CrosshairShape)shape).drawGeneric(s, ctx.cx, ctx.cy, crosshairColor, 15, 5);
+        });
+    }
+
+    // Crosshair from the sprite cache, as the overlay draws it
+    for (int shape = 0; shape < SHAPE_COUNT; shape++)
+    {
+        sprintf_s(name, "crosshair_cached/%s/size15/gap5", ShapeCaseName((CrosshairShape)shape).c_str());
+        RunCase(ctx, options, name, [&]
+        {
+            DrawCachedCrosshair(ctx.cache, s, ctx.cx, ctx.cy, crosshairColor, 15, 5, (CrosshairShape)shape);
+        });
+    }
+
+    // Rainbow mode: a new colour every frame from the hue table, so the cached
+    // mask is recoloured before every blit
+    HueTable hues;
+    float hue = 0.0f;
+    for (int shape = 0; shape < SHAPE_COUNT; shape++)
+    {
+        sprintf_s(name, "crosshair_cached/rainbow/%s/size15/gap5", ShapeCaseName((CrosshairShape)shape).c_str());
+        RunCase(ctx, options, name, [&]
+        {
+            hue += 1.0f / 1024;
+            DrawCachedCrosshair(ctx.cache, s, ctx.cx, ctx.cy, hues.At(hue), 15, 5, (CrosshairShape)shape);
+        });
+    }
+
+    // A second of rainbow hues at 1000 frames per second, computed against looked up
+    volatile Pixel colorSink = 0;
+    RunCase(ctx, options, "color/hue_hsv", [&]
+    {
+        Pixel c = 0;
+        for (int i = 0; i < 1000; i++)
+            c ^= HsvToPixel(fmodf(i * 0.0003f, 1.0f), 1.0f, 1.0f);
+        colorSink = c;
+    }, 0, 1000 * sizeof(Pixel));
+
+    RunCase(ctx, options, "color/hue_table", [&]
+    {
+        Pixel c = 0;
+        for (int i = 0; i < 1000; i++)
+            c ^= hues.At(i * 0.0003f);
+        colorSink = c;
+    }, 0, 1000 * sizeof(Pixel));
+    (void)colorSink;
+
+    for (int radius : radii)
+    {
+        sprintf_s(name, "scope/radius%d", radius);
+        RunCase(ctx, options, name, [&]
+        {
+            DrawScopeOverlay(s, ctx.cx, ctx.cy, radius);
+        });
+
+        sprintf_s(name, "scope_cached/radius%d", radius);
+        RunCase(ctx, options, name, [&]
+        {
+            DrawCachedScope(ctx.cache, s, ctx.cx, ctx.cy, radius, 0, 0);
+        });
+    }
+
+    RunCase(ctx, options, "watermark", [&]
+    {
+        DrawWatermark(s, ctx.text, ctx.lines, WATERMARK_X, WATERMARK_Y, 0.25f);
+    });
+
+    RunCase(ctx, options, "info_panel", [&]
+    {
+        DrawInfoPanel(s, ctx.text, ctx.lines, ctx.settings, 143.5f, ctx.cpu, INFO_PANEL_X, INFO_PANEL_Y);
+    });
+
+    RunCase(ctx, options, "menu", [&]
+    {
+        DrawMenu(s, ctx.text, ctx.lines, ctx.settings, MENU_X, MENU_Y);
+    });
+
+    // Holding Down in the open menu, as the overlay repaints it: only the rows
+    // whose highlight moved are cleared and drawn again
+    DirtyRegionTracker menuTracker;
+    menuTracker.Reset(s.width, s.height);
+    OverlaySettings navigating = ctx.settings;
+    auto navigate = [&]
+    {
+        MenuMoveSelection(navigating, 1);
+        menuTracker.BeginFrame();
+        ReportMenu(menuTracker, navigating, MENU_X, MENU_Y);
+        menuTracker.Resolve();
+        ClearDamage(s.pixels, s.stride * (int)sizeof(Pixel), menuTracker);
+        for (int i = 0; i < menuTracker.DamageCount(); i++)
+        {
+            s.SetClip(menuTracker.Damage(i));
+            DrawMenu(s, ctx.text, ctx.lines, navigating, MENU_X, MENU_Y);
+        }
+        s.ResetClip();
+    };
+    navigate(); // the tracker's first frame repaints everything
+    RunCase(ctx, options, "menu/navigate", navigate);
+
+    RunCase(ctx, options, "kill_effect", [&]
+    {
+        DrawKillEffect(s, ctx.text, ctx.lines, ctx.cx + 50, ctx.cy - 50, 0.25f);
+    });
+
+    // A burst of kill effects at once, spread over the middle of the screen at
+    // staggered points in their lifetimes. Budget: a tenth of a 60 Hz frame.
+    const int64_t KILL_BURST_BUDGET_NS = NS_PER_SEC / 600;
+    KillEffectPool burst;
+    for (int i = 0; i < 100; i++)
+    {
+        KillEffect e;
+        e.x = ctx.cx - 300 + (i % 10) * 60;
+        e.y = ctx.cy - 200 + (i / 10) * 40;
+        burst.Start(e, -(i * KILL_EFFECT_DURATION_NS / 100), KILL_EFFECT_DURATION_NS, EASE_OUT_CUBIC);
+    }
+    RunCase(ctx, options, "kill_effect/burst100", [&]
+    {
+        DrawKillEffects(s, ctx.text, ctx.lines, burst, 0, 0, 0);
+    }, KILL_BURST_BUDGET_NS);
+
+    // Text on its own: a cached line, the same string laid out every frame, and
+    // a line whose value changes every frame so it is formatted and laid out each time
+    TextRenderer& text = ctx.text;
+    const char* sample = "Crosshair Size: 15";
+    TextLine cachedLine;
+    cachedLine.Set(sample);
+    RunCase(ctx, options, "text/line_cached", [&]
+    {
+        text.DrawLine(s, 100, 100, cachedLine, whiteColor);
+    });
+
+    RunCase(ctx, options, "text/string_uncached", [&]
+    {
+        text.DrawString(s, 100, 100, sample, whiteColor);
+    });
+
+    TextLine changingLine;
+    int counter = 0;
+    RunCase(ctx, options, "text/line_changing", [&]
+    {
+        changingLine.Format("Crosshair Size: %d", counter++ & 63);
+        text.DrawLine(s, 100, 100, changingLine, whiteColor);
+    });
+
+    RunCase(ctx, options, "text/atlas_build", [&]
+    {
+        AtlasTextRenderer renderer;
+        renderer.Build(glyphs);
+    });
+
+    // Settings profiles: loading a file of eight, checking it for changes as a
+    // change notification does, and switching profiles up to the snapshot the
+    // next frame draws from
+    const char* profilePath = "overlay_bench_profiles.bin";
+    std::vector<ProfileRecord> profileRecords;
+    for (int i = 0; i < 8; i++)
+    {
+        OverlaySettings p;
+        p.crosshairSize = 5 + i * 5;
+        p.colorR = i * 30;
+        p.scopeOverlayEnabled = (i & 1) != 0;
+        char name[PROFILE_NAME_LENGTH];
+        sprintf_s(name, "Bench %d", i + 1);
+        profileRecords.push_back(MakeProfileRecord(name, p));
+    }
+    if (WriteProfileFile(profilePath, profileRecords))
+    {
+        ProfileStore profiles;
+        RunCase(ctx, options, "profile/load", [&]
+        {
+            profiles.Load(profilePath);
+        });
+
+        RunCase(ctx, options, "profile/reload_unchanged", [&]
+        {
+            profiles.ReloadIfChanged();
+        });
+
+        ManualClock clock;
+        Overlay overlay(clock, text, 0.0);
+        RunCase(ctx, options, "profile/switch", [&]
+        {
+            profiles.Step(1);
+            overlay.ApplyProfile(ProfileSettings(profiles.ActiveRecord()));
+            overlay.ProcessInput([](KeyEvent&) { return false; });
+        });
+        remove(profilePath);
+    }
+
+    // Memory (Memory.h): a sprite-sized block from its pool against straight
+    // from the heap, and a frame's worth of closures from the frame arena
+    SurfaceAllocator surfaces(4 * 1024 * 1024);
+    surfaces.Allocate(64 * 64 * sizeof(Pixel));
+    RunCase(ctx, options, "memory/surface_pooled", [&]
+    {
+        SurfaceBlock block = surfaces.Allocate(64 * 64 * sizeof(Pixel));
+        ((volatile Pixel*)block.Data())[0] = 0;
+    });
+
+    RunCase(ctx, options, "memory/surface_heap", [&]
+    {
+        std::unique_ptr<Pixel[]> block(new Pixel[64 * 64]);
+        ((volatile Pixel*)block.get())[0] = 0;
+    });
+
+    FrameArena arena;
+    RunCase(ctx, options, "memory/arena_frame", [&]
+    {
+        for (int i = 0; i < 200; i++)
+            ((volatile char*)arena.Allocate(48))[0] = 0;
+        arena.Reset();
+    });
+
+    // The platform shim (Platform.h): a present as the frame makes it, select,
+    // present, select back and close the frame, through the tracker against
+    // the same calls straight to the backend
+    MockPlatformBackend backend;
+    ResourceTracker resources;
+    SteadyClock shimClock;
+    TrackedPlatform platform(backend, resources, shimClock);
+    Pixel* shimPixels = nullptr;
+    PlatformHandle shimDc = platform.CreateContext();
+    PlatformHandle shimBitmap = platform.CreateBitmap(64, 64, &shimPixels);
+    RunCase(ctx, options, "platform/present_tracked", [&]
+    {
+        PlatformHandle previous = platform.Select(shimDc, shimBitmap);
+        platform.Present(&backend, shimDc, 0, 0, 64, 64, MakeRect(0, 0, 64, 64));
+        platform.Select(shimDc, previous);
+        resources.EndFrame();
+    });
+
+    RunCase(ctx, options, "platform/present_direct", [&]
+    {
+        PlatformHandle previous = backend.Select(shimDc, shimBitmap);
+        backend.Present(&backend, shimDc, 0, 0, 64, 64, MakeRect(0, 0, 64, 64));
+        backend.Select(shimDc, previous);
+    });
+    platform.DeleteBitmap(shimBitmap);
+    platform.DeleteContext(shimDc);
+
+    // Full-surface clear, the worst case of damage clearing
+    RunCase(ctx, options, "frame/clear", [&]
+    {
+        memset(ctx.buffer.data(), 0, ctx.buffer.size() * sizeof(Pixel));
+    });
+
+    // Checking a full-screen repaint for changes before presenting it: the
+    // row hashes PresentFilter takes, against copying the same rows and
+    // blending them over another buffer, the least a present of them costs
+    // (UpdateLayeredWindow copies the dirty rows, then DWM blends them)
+    double frameBytes = (double)ctx.buffer.size() * sizeof(Pixel);
+    std::vector<Pixel> presented(ctx.buffer.size());
+    volatile uint64_t hashSink = 0;
+    RunCase(ctx, options, "present/hash_rows", [&]
+    {
+        uint64_t h = 0;
+        for (int y = 0; y < s.height; y++)
+            h ^= ActiveRasterKernels().hashSpan(s.pixels + (size_t)y * s.stride, s.width, 0);
+        hashSink = h;
+    }, 0, frameBytes);
+
+    RunCase(ctx, options, "present/copy_rows", [&]
+    {
+        memcpy(presented.data(), ctx.buffer.data(), ctx.buffer.size() * sizeof(Pixel));
+    }, 0, frameBytes);
+
+    RunCase(ctx, options, "present/blend_rows", [&]
+    {
+        for (int y = 0; y < s.height; y++)
+            ActiveRasterKernels().blendPixelSpan(presented.data() + (size_t)y * s.width, s.pixels + (size_t)y * s.stride, s.width);
+    }, 0, frameBytes);
+    (void)hashSink;
+
+    // Straight alpha for a full frame, as a PNG of it needs
+    RunCase(ctx, options, "color/unpremultiply", [&]
+    {
+        for (int y = 0; y < s.height; y++)
+            ActiveRasterKernels().unpremultiplySpan(presented.data() + (size_t)y * s.width, s.pixels + (size_t)y * s.stride, s.width);
+    }, 0, frameBytes);
+
+    // Everything visible at once: clear, then every widget in overlay order
+    OverlaySettings all = ctx.settings;
+    all.menuOpen = true;
+    all.scopeOverlayEnabled = true;
+    auto drawAll = [&](Surface& target)
+    {
+        DrawCachedScope(ctx.cache, target, ctx.cx, ctx.cy, all.scopeRadius, all.scopeOffsetX, all.scopeOffsetY);
+        DrawCachedCrosshair(ctx.cache, target, ctx.cx, ctx.cy, crosshairColor, all.crosshairSize, all.crosshairGap, all.crosshairShape);
+        DrawWatermark(target, ctx.text, ctx.lines, WATERMARK_X, WATERMARK_Y, 0.25f);
+        DrawInfoPanel(target, ctx.text, ctx.lines, all, 143.5f, ctx.cpu, INFO_PANEL_X, INFO_PANEL_Y);
+        DrawMenu(target, ctx.text, ctx.lines, all, MENU_X, MENU_Y);
+        DrawKillEffect(target, ctx.text, ctx.lines, ctx.cx + 50, ctx.cy - 50, 0.25f);
+    };
+    RunCase(ctx, options, "frame/compose", [&]
+    {
+        memset(ctx.buffer.data(), 0, ctx.buffer.size() * sizeof(Pixel));
+        drawAll(s);
+    });
+
+    // The same frame recorded into a command list, and the list replayed
+    // through the tile compositor on 1 to 8 threads
+    DrawList frameList;
+    Surface recording = s;
+    recording.recorder = &frameList;
+    RunCase(ctx, options, "compose/frame/record", [&]
+    {
+        frameList.Clear();
+        drawAll(recording);
+    });
+
+    // Many widgets at once: a scope drawn from its distance field every frame,
+    // an info panel and a crosshair in every 480x360 cell of the screen
+    DrawList denseList;
+    recording.recorder = &denseList;
+    for (int y = 0; y + 360 <= s.height; y += 360)
+        for (int x = 0; x + 480 <= s.width; x += 480)
+        {
+            DrawScopeOverlay(recording, x + 320, y + 180, 100);
+            DrawInfoPanel(recording, ctx.text, ctx.lines, all, 143.5f, ctx.cpu, x + 10, y + 10);
+            DrawCrosshair(recording, x + 320, y + 180, crosshairColor, all.crosshairSize, all.crosshairGap, all.crosshairShape);
+        }
+
+    RunCase(ctx, options, "compose/dense/direct", [&]
+    {
+        memset(ctx.buffer.data(), 0, ctx.buffer.size() * sizeof(Pixel));
+        denseList.Replay(s);
+    });
+
+    const int threadCounts[] = { 1, 2, 4, 8 };
+    for (int threads : threadCounts)
+    {
+        TileCompositor compositor(benchClock, threads);
+        sprintf_s(name, "compose/frame/threads%d", threads);
+        RunCase(ctx, options, name, [&]
+        {
+            memset(ctx.buffer.data(), 0, ctx.buffer.size() * sizeof(Pixel));
+            compositor.Compose(frameList, s);
+        });
+
+        sprintf_s(name, "compose/dense/threads%d", threads);
+        RunCase(ctx, options, name, [&]
+        {
+            memset(ctx.buffer.data(), 0, ctx.buffer.size() * sizeof(Pixel));
+            compositor.Compose(denseList, s);
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--json"))
+            options.json = true;
+        else if (!strcmp(arg, "--tag") && hasValue)
+            options.tag = argv[++i];
+        else if (!strcmp(arg, "--filter") && hasValue)
+            options.filter = argv[++i];
+        else if (!strcmp(arg, "--min-ms") && hasValue)
+            options.minNs = atoi(argv[++i]) * NS_PER_MS;
+        else if (!strcmp(arg, "--isa") && hasValue)
+        {
+            const char* isa = argv[++i];
+            if (!strcmp(isa, "scalar")) SelectRasterIsa(RASTER_ISA_SCALAR);
+            else if (!strcmp(isa, "sse2")) SelectRasterIsa(RASTER_ISA_SSE2);
+            else if (!strcmp(isa, "avx2")) SelectRasterIsa(RASTER_ISA_AVX2);
+            else
+            {
+                fprintf(stderr, "unknown isa: %s\n", isa);
+                return 1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--json] [--tag NAME] [--filter TEXT] [--isa scalar|sse2|avx2] [--min-ms N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const Resolution resolutions[] =
+    {
+        { "1080p", 1920, 1080 },
+        { "1440p", 2560, 1440 },
+        { "4k", 3840, 2160 },
+    };
+    for (const Resolution& r : resolutions)
+        RunResolution(r, options);
+    return 0;
+}
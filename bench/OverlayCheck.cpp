@@ -0,0 +1,1002 @@
+// OverlayCheck.cpp: headless checks of what the overlay computes.
+//
+// Each check runs code the DLL runs, on a virtual clock where time matters,
+// and compares it with what it should produce. A check prints one line,
+// "ok NAME" or "FAIL NAME: what differed", and the program exits with status
+// 1 if any check failed, so it can gate a change the same way on any machine.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -I. bench/OverlayCheck.cpp -o overlay_check -pthread
+//   cl /std:c++17 /O2 /EHsc /I. bench\OverlayCheck.cpp
+//
+// Usage:
+//   overlay_check [--filter TEXT]
+
+#include "Overlay.h"
+#include "SpscRing.h"
+#include "BlockGlyphSource.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// --- Heap allocations ---
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC inlines these into the standard library and then takes free() to be
+// paired with a new it can't see was replaced
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// Every operator new in the process, as bench/OverlayReplay.cpp counts them
+std::atomic<uint64_t> heapAllocations(0);
+
+void* operator new(size_t bytes)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(bytes ? bytes : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// A failed check's first few differences, then how many there were in all
+class CheckResult
+{
+public:
+    static const int MAX_REPORTED = 4;
+
+    template <class... Args>
+    void Fail(const char* format, Args... args)
+    {
+        if (failures++ < MAX_REPORTED)
+        {
+            char line[256];
+            snprintf(line, sizeof(line), format, args...);
+            if (!detail.empty()) detail += "; ";
+            detail += line;
+        }
+    }
+
+    bool Passed() const { return failures == 0; }
+    int Failures() const { return failures; }
+    const std::string& Detail() const { return detail; }
+
+private:
+    int failures = 0;
+    std::string detail;
+};
+
+struct CheckContext
+{
+    const char* filter = nullptr;
+    int run = 0;
+    int failed = 0;
+};
+
+template <class CheckFn>
+void RunCheck(CheckContext& ctx, const char* name, CheckFn check)
+{
+    if (ctx.filter && !strstr(name, ctx.filter))
+        return;
+    CheckResult result;
+    check(result);
+    ctx.run++;
+    if (result.Passed())
+        printf("ok %s\n", name);
+    else
+    {
+        ctx.failed++;
+        printf("FAIL %s: %s (%d in all)\n", name, result.Detail().c_str(), result.Failures());
+    }
+}
+
+// --- Animation ---
+
+// Runs the overlay's loop on a manual clock until endNs, waking whenever it
+// asks to or a key event in keys (in time order) comes in, and calls
+// onFrame() after every frame
+template <class FrameFn>
+void RunOverlayLoop(Overlay& overlay, ManualClock& clock, int64_t endNs, const std::vector<KeyEvent>& keys, FrameFn onFrame)
+{
+    size_t next = 0;
+    while (clock.NowNs() < endNs)
+    {
+        int64_t wake = overlay.NextWakeNs();
+        if (next < keys.size() && keys[next].timeNs < wake)
+            wake = keys[next].timeNs;
+        if (wake == NO_DEADLINE)
+            break;
+        if (wake > clock.NowNs())
+            clock.Set(wake);
+        overlay.StartIteration();
+        overlay.ProcessInput([&](KeyEvent& e)
+        {
+            if (next >= keys.size() || keys[next].timeNs > clock.NowNs())
+                return false;
+            e = keys[next++];
+            return true;
+        });
+        if (overlay.BeginFrame())
+            onFrame();
+    }
+}
+
+// Looping animations run on the time since the overlay was made: the rainbow
+// hue keeps going round the wheel, through the FPS readout's once-a-second
+// ticks, instead of starting over at each one
+void CheckAnimationTime(CheckResult& result, TextRenderer& text)
+{
+    ManualClock clock(5 * NS_PER_SEC);
+    Overlay overlay(clock, text, 0.0);
+    overlay.SetMonitorSize(1920, 1080);
+    OverlaySettings settings;
+    settings.rainbowEnabled = true;
+    overlay.RestoreSettings(settings);
+
+    const int64_t originNs = clock.NowNs();
+    HueTable hues;
+    float last = -1.0f, furthest = 0.0f;
+    RunOverlayLoop(overlay, clock, originNs + 4 * NS_PER_SEC, {}, [&]
+    {
+        float t = overlay.AnimationTime();
+        float expected = AnimationSeconds(clock.NowNs(), originNs);
+        if (t != expected)
+            result.Fail("at %.3f s animation time %.3f, expected %.3f", expected, t, expected);
+        if (t < last)
+            result.Fail("animation time went back from %.3f to %.3f", last, t);
+        if (overlay.CrosshairColor() != hues.At(expected * 0.3f))
+            result.Fail("at %.3f s crosshair %08x, expected hue %.3f", expected, overlay.CrosshairColor(), expected * 0.3f);
+        last = t;
+        furthest = t > furthest ? t : furthest;
+    });
+    if (furthest < 3.9f)
+        result.Fail("animation time reached only %.3f s of 4", furthest);
+}
+
+// --- Damage ---
+
+// A frame of the tracker: report(tracker) reports its widgets, then the
+// damage comes back sorted top to bottom, left to right
+template <class ReportFn>
+std::vector<IntRect> TrackFrame(DirtyRegionTracker& tracker, ReportFn report)
+{
+    tracker.BeginFrame();
+    report(tracker);
+    tracker.Resolve();
+    std::vector<IntRect> damage;
+    for (int i = 0; i < tracker.DamageCount(); i++)
+        damage.push_back(tracker.Damage(i));
+    std::sort(damage.begin(), damage.end(), [](const IntRect& a, const IntRect& b)
+    {
+        return a.top != b.top ? a.top < b.top : a.left < b.left;
+    });
+    return damage;
+}
+
+void ExpectDamage(CheckResult& result, const char* what, const DirtyRegionTracker& tracker, const std::vector<IntRect>& damage,
+                  std::vector<IntRect> expected)
+{
+    std::sort(expected.begin(), expected.end(), [](const IntRect& a, const IntRect& b)
+    {
+        return a.top != b.top ? a.top < b.top : a.left < b.left;
+    });
+    if (damage != expected)
+    {
+        std::string got, want;
+        for (const IntRect& r : damage)
+            got += " " + std::to_string(r.left) + "," + std::to_string(r.top) + "-" + std::to_string(r.right) + "," + std::to_string(r.bottom);
+        for (const IntRect& r : expected)
+            want += " " + std::to_string(r.left) + "," + std::to_string(r.top) + "-" + std::to_string(r.right) + "," + std::to_string(r.bottom);
+        result.Fail("%s: damage%s, expected%s", what, got.empty() ? " none" : got.c_str(), want.empty() ? " none" : want.c_str());
+    }
+    IntRect bounds;
+    for (const IntRect& r : expected)
+        bounds = RectUnion(bounds, r);
+    if (!(tracker.DamageBounds() == bounds))
+        result.Fail("%s: damage bounds don't cover exactly the damage", what);
+}
+
+// A widget that moves damages where it was and where it is; one that changes
+// in place damages its rectangle; one that hides damages where it was
+void CheckDamageMoveAndHide(CheckResult& result)
+{
+    DirtyRegionTracker tracker;
+    tracker.Reset(400, 300);
+    const IntRect a = MakeRect(10, 10, 50, 50), b = MakeRect(200, 100, 240, 140);
+    auto at = [](IntRect r, uint64_t key) { return [=](DirtyRegionTracker& t) { t.Report(0, r, key); }; };
+
+    ExpectDamage(result, "first frame", tracker, TrackFrame(tracker, at(a, 1)), { tracker.SurfaceBounds() });
+    ExpectDamage(result, "unchanged", tracker, TrackFrame(tracker, at(a, 1)), {});
+    ExpectDamage(result, "moved", tracker, TrackFrame(tracker, at(b, 1)), { a, b });
+    ExpectDamage(result, "new key in place", tracker, TrackFrame(tracker, at(b, 2)), { b });
+    ExpectDamage(result, "hidden", tracker, TrackFrame(tracker, [](DirtyRegionTracker&) {}), { b });
+    ExpectDamage(result, "still hidden", tracker, TrackFrame(tracker, [](DirtyRegionTracker&) {}), {});
+    ExpectDamage(result, "shown off the edge", tracker, TrackFrame(tracker, at(MakeRect(380, 290, 420, 330), 1)),
+                 { MakeRect(380, 290, 400, 300) });
+    ExpectDamage(result, "empty report", tracker, TrackFrame(tracker, at(IntRect(), 1)), { MakeRect(380, 290, 400, 300) });
+}
+
+// Damage rectangles that overlap or touch merge into their union, through
+// chains of them, while ones apart stay apart
+void CheckDamageMerge(CheckResult& result)
+{
+    DirtyRegionTracker tracker;
+    tracker.Reset(400, 300);
+    TrackFrame(tracker, [](DirtyRegionTracker&) {});
+
+    const IntRect left = MakeRect(10, 10, 50, 50), overlap = MakeRect(40, 40, 80, 80), far = MakeRect(300, 200, 340, 240);
+    auto still = [&](DirtyRegionTracker& t)
+    {
+        t.Report(0, left, 1);
+        t.Report(1, overlap, 1);
+        t.Report(2, far, 1);
+    };
+    ExpectDamage(result, "overlapping", tracker, TrackFrame(tracker, still), { MakeRect(10, 10, 80, 80), far });
+
+    // 100 and 140 are apart until 120 bridges them
+    ExpectDamage(result, "bridged", tracker, TrackFrame(tracker, [&](DirtyRegionTracker& t)
+    {
+        still(t);
+        t.Report(3, MakeRect(100, 150, 119, 160), 1);
+        t.Report(4, MakeRect(141, 150, 160, 160), 1);
+        t.Report(5, MakeRect(118, 155, 142, 158), 1);
+    }), { MakeRect(100, 150, 160, 160) });
+
+    // Edge to edge, and the three above hiding
+    ExpectDamage(result, "touching", tracker, TrackFrame(tracker, [&](DirtyRegionTracker& t)
+    {
+        still(t);
+        t.Report(6, MakeRect(200, 10, 220, 20), 1);
+        t.Report(7, MakeRect(220, 10, 240, 20), 1);
+    }), { MakeRect(100, 150, 160, 160), MakeRect(200, 10, 240, 20) });
+}
+
+// With more separate rectangles than slots, the one left over folds into the
+// rectangle whose union with it grows the least
+void CheckDamageOverflow(CheckResult& result)
+{
+    DirtyRegionTracker tracker;
+    tracker.Reset(1000, 1000);
+    TrackFrame(tracker, [](DirtyRegionTracker&) {});
+
+    std::vector<IntRect> spots;
+    for (int i = 0; i < DirtyRegionTracker::MAX_DAMAGE_RECTS; i++)
+        spots.push_back(MakeRect(100 * i, 100 * (i % 3), 100 * i + 20, 100 * (i % 3) + 20));
+    const int near = 3;
+    const IntRect extra = MakeRect(spots[near].right + 5, spots[near].top, spots[near].right + 25, spots[near].bottom);
+
+    std::vector<IntRect> expected = spots;
+    expected[near] = RectUnion(spots[near], extra);
+    ExpectDamage(result, "one more than the slots", tracker, TrackFrame(tracker, [&](DirtyRegionTracker& t)
+    {
+        for (size_t i = 0; i < spots.size(); i++)
+            t.Report((int)i, spots[i], 1);
+        t.Report((int)spots.size(), extra, 1);
+    }), expected);
+    if (tracker.DamageCount() > DirtyRegionTracker::MAX_DAMAGE_RECTS)
+        result.Fail("%d damage rectangles, at most %d", tracker.DamageCount(), DirtyRegionTracker::MAX_DAMAGE_RECTS);
+}
+
+// Reset damages the whole surface once, whatever widgets report, and forgets them
+void CheckDamageReset(CheckResult& result)
+{
+    DirtyRegionTracker tracker;
+    tracker.Reset(400, 300);
+    auto widget = [](DirtyRegionTracker& t) { t.Report(0, MakeRect(10, 10, 50, 50), 1); };
+    TrackFrame(tracker, widget);
+    ExpectDamage(result, "settled", tracker, TrackFrame(tracker, widget), {});
+
+    tracker.Reset(400, 300);
+    ExpectDamage(result, "after Reset", tracker, TrackFrame(tracker, widget), { MakeRect(0, 0, 400, 300) });
+    ExpectDamage(result, "the frame after", tracker, TrackFrame(tracker, widget), {});
+
+    tracker.Reset(30, 20);
+    ExpectDamage(result, "after Reset to a new size", tracker, TrackFrame(tracker, widget), { MakeRect(0, 0, 30, 20) });
+    ExpectDamage(result, "the frame after that", tracker, TrackFrame(tracker, widget), {});
+}
+
+// --- Scheduling ---
+
+// Sources fire on their own periods, in phase even when the loop wakes late,
+// and a late wake catches up with one frame rather than every one missed
+void CheckSchedulerDeadlines(CheckResult& result)
+{
+    ManualClock clock(NS_PER_SEC);
+    FrameScheduler scheduler(clock);
+    int fast = scheduler.AddSource("fast", 10.0);
+    int slow = scheduler.AddSource("slow", 4.0);
+    const int64_t t0 = clock.NowNs();
+    scheduler.SetActive(fast, true, 100 * NS_PER_MS);
+    scheduler.SetActive(slow, true, 250 * NS_PER_MS);
+    if (scheduler.BeginFrame() != FrameScheduler::FRAME_REQUESTED)
+        result.Fail("the first frame was not the requested one");
+
+    // Woken on time: fast at every 100 ms, slow at every 250 ms
+    struct Due { int64_t ms; uint32_t fired; };
+    const uint32_t F = 1u << fast, S = 1u << slow;
+    const Due onTime[] = { { 100, F }, { 200, F }, { 250, S }, { 300, F }, { 400, F }, { 500, F | S } };
+    for (const Due& d : onTime)
+    {
+        int64_t deadline = scheduler.NextDeadline();
+        if (deadline != t0 + d.ms * NS_PER_MS)
+            result.Fail("deadline at %.1f ms, expected %lld ms", (deadline - t0) / 1e6, (long long)d.ms);
+        clock.Set(deadline);
+        uint32_t fired = scheduler.BeginFrame();
+        if (fired != d.fired)
+            result.Fail("at %lld ms fired %x, expected %x", (long long)d.ms, fired, d.fired);
+    }
+
+    // 30 ms late: fast keeps its phase and is next due at 700 ms
+    clock.Set(t0 + 630 * NS_PER_MS);
+    if (scheduler.BeginFrame() != F || scheduler.NextDeadline() != t0 + 700 * NS_PER_MS)
+        result.Fail("after a late wake the next deadline is %.1f ms, expected 700 ms", (scheduler.NextDeadline() - t0) / 1e6);
+
+    // Three periods late: one frame, then a whole period on from now
+    clock.Set(t0 + 1010 * NS_PER_MS);
+    uint32_t fired = scheduler.BeginFrame();
+    if (fired != (F | S) || scheduler.BeginFrame() != 0)
+        result.Fail("a wake three periods late fired %x, then more", fired);
+    if (scheduler.NextDeadline() != t0 + 1110 * NS_PER_MS)
+        result.Fail("after a missed stretch the next deadline is %.1f ms, expected 1110 ms", (scheduler.NextDeadline() - t0) / 1e6);
+}
+
+// Any number of requests before a frame make one frame
+void CheckSchedulerRequests(CheckResult& result)
+{
+    ManualClock clock(NS_PER_SEC);
+    FrameScheduler scheduler(clock);
+    scheduler.BeginFrame();
+    clock.Advance(10 * NS_PER_MS);
+    for (int i = 0; i < 5; i++)
+        scheduler.RequestFrame();
+    if (scheduler.NextDeadline() != clock.NowNs())
+        result.Fail("a requested frame is due at %+.1f ms, not now", (scheduler.NextDeadline() - clock.NowNs()) / 1e6);
+    uint64_t before = scheduler.FramesRendered();
+    uint32_t first = scheduler.BeginFrame(), second = scheduler.BeginFrame();
+    if (first != FrameScheduler::FRAME_REQUESTED || second != 0 || scheduler.FramesRendered() != before + 1)
+        result.Fail("five requests fired %x then %x, %llu frames", first, second, (unsigned long long)(scheduler.FramesRendered() - before));
+    if (scheduler.NextDeadline() != NO_DEADLINE)
+        result.Fail("still a deadline after the requested frame");
+}
+
+// A frame hold spaces animation frames out but not requested ones, and
+// releasing it puts sources back on their own period
+void CheckSchedulerHold(CheckResult& result)
+{
+    ManualClock clock(NS_PER_SEC);
+    FrameScheduler scheduler(clock);
+    int source = scheduler.AddSource("source", 100.0);
+    scheduler.SetActive(source, true);
+    scheduler.BeginFrame();
+    const int64_t hold = 50 * NS_PER_MS;
+    scheduler.SetFrameHold(hold);
+
+    int64_t lastNs = clock.NowNs();
+    for (int i = 0; i < 5; i++)
+    {
+        int64_t deadline = scheduler.NextDeadline();
+        if (deadline != lastNs + hold)
+            result.Fail("held frame %d due %.1f ms after the last, expected 50 ms", i, (deadline - lastNs) / 1e6);
+        clock.Set(deadline - NS_PER_MS);
+        if (scheduler.BeginFrame())
+            result.Fail("held frame %d fired early", i);
+        clock.Set(deadline);
+        if (!scheduler.BeginFrame())
+            result.Fail("held frame %d did not fire when due", i);
+        lastNs = deadline;
+    }
+
+    clock.Advance(NS_PER_MS);
+    scheduler.RequestFrame();
+    if (scheduler.BeginFrame() != FrameScheduler::FRAME_REQUESTED)
+        result.Fail("a requested frame was held");
+
+    scheduler.SetFrameHold(0);
+    int64_t now = clock.NowNs(), deadline = scheduler.NextDeadline();
+    if (deadline - now > 10 * NS_PER_MS)
+        result.Fail("released, the next frame is %.1f ms off, expected at most 10 ms", (deadline - now) / 1e6);
+}
+
+// With nothing animating, the overlay stops waking and renders nothing
+void CheckOverlayIdle(CheckResult& result, TextRenderer& text)
+{
+    ManualClock clock(NS_PER_SEC);
+    Overlay overlay(clock, text, 0.0);
+    overlay.SetMonitorSize(1920, 1080);
+    OverlaySettings settings;
+    settings.watermarkEnabled = false;
+    settings.rainbowEnabled = false;
+    overlay.RestoreSettings(settings);
+
+    // The first frames, and the FPS readout's last tick to show zero
+    int frames = 0;
+    RunOverlayLoop(overlay, clock, clock.NowNs() + 5 * NS_PER_SEC, {}, [&] { frames++; });
+    if (overlay.NextWakeNs() != NO_DEADLINE)
+        result.Fail("still waking %.1f ms out after %d frames", (overlay.NextWakeNs() - clock.NowNs()) / 1e6, frames);
+
+    for (int i = 0; i < 10; i++)
+    {
+        clock.Advance(NS_PER_SEC);
+        overlay.StartIteration();
+        overlay.ProcessInput([](KeyEvent&) { return false; });
+        if (uint32_t fired = overlay.BeginFrame())
+            result.Fail("idle overlay rendered a frame for %x at %d s", fired, i + 1);
+    }
+    if (overlay.NextWakeNs() != NO_DEADLINE)
+        result.Fail("idle overlay asked to wake");
+}
+
+// --- Allocation ---
+
+// A widget window as the DLL keeps one, with its buffer allocated up front:
+// the DLL's are DIB sections, which come from the OS rather than the heap
+struct CheckWindow
+{
+    IntRect rect;
+    DirtyRegionTracker tracker;
+    std::vector<Pixel> buffer;
+    Surface surface;
+};
+
+template <class ReportFn, class DrawFn>
+void UpdateCheckWindow(CheckWindow& w, const IntRect& rect, ReportFn report, DrawFn draw)
+{
+    if (rect.IsEmpty())
+    {
+        w.rect = IntRect();
+        return;
+    }
+    if (rect.Width() != w.rect.Width() || rect.Height() != w.rect.Height())
+    {
+        w.tracker.Reset(rect.Width(), rect.Height());
+        w.surface = Surface(w.buffer.data(), rect.Width(), rect.Height(), rect.Width());
+    }
+    w.rect = rect;
+
+    int dx = -rect.left, dy = -rect.top;
+    w.tracker.BeginFrame();
+    report(w.tracker, dx, dy);
+    w.tracker.Resolve();
+    ClearDamage(w.buffer.data(), w.surface.stride * 4, w.tracker);
+    Surface target = w.surface;
+    for (int i = 0; i < w.tracker.DamageCount(); i++)
+    {
+        target.SetClip(w.tracker.Damage(i));
+        draw(target, w.tracker.Damage(i), dx, dy);
+    }
+}
+
+// Key events for a tap of key at atNs, held for 40 ms
+void Tap(std::vector<KeyEvent>& keys, int key, int64_t& atNs, int64_t holdNs = 40 * NS_PER_MS)
+{
+    KeyEvent e;
+    e.key = (uint16_t)key;
+    e.down = true;
+    e.timeNs = atNs;
+    keys.push_back(e);
+    e.down = false;
+    e.timeNs = atNs + holdNs;
+    keys.push_back(e);
+    atNs += holdNs + 60 * NS_PER_MS;
+}
+
+// Opens the menu and walks every row, changing each value and changing it
+// back, starts kill effects, holds Down long enough to repeat and closes the
+// menu again, with the rainbow running throughout
+void AddWidgetTour(std::vector<KeyEvent>& keys, int64_t& atNs)
+{
+    Tap(keys, OVERLAY_KEY_INSERT, atNs);
+    for (int row = 0; row < MENU_ITEM_COUNT; row++)
+    {
+        Tap(keys, OVERLAY_KEY_RIGHT, atNs);
+        Tap(keys, OVERLAY_KEY_LEFT, atNs);
+        Tap(keys, OVERLAY_KEY_RETURN, atNs);
+        Tap(keys, OVERLAY_KEY_RETURN, atNs);
+        Tap(keys, OVERLAY_KEY_DOWN, atNs);
+    }
+    for (int i = 0; i < 3; i++)
+        Tap(keys, OVERLAY_KEY_KILL, atNs);
+    Tap(keys, OVERLAY_KEY_DOWN, atNs, 700 * NS_PER_MS);
+    Tap(keys, OVERLAY_KEY_INSERT, atNs);
+    atNs += KILL_EFFECT_DURATION_NS;
+}
+
+// Once a tour has drawn every widget, touring them all again goes to the heap
+// in no frame: frames draw from what the first tour left allocated
+void CheckSteadyStateAllocations(CheckResult& result, TextRenderer& text)
+{
+    ManualClock clock(NS_PER_SEC);
+    Overlay overlay(clock, text, 0.0);
+    overlay.SetMonitorSize(1920, 1080);
+    OverlaySettings settings;
+    settings.rainbowEnabled = true;
+    settings.scopeOverlayEnabled = true;
+    overlay.RestoreSettings(settings);
+
+    CheckWindow windows[WINDOW_COUNT];
+    for (CheckWindow& w : windows)
+        w.buffer.resize((size_t)overlay.MonitorWidth() * overlay.MonitorHeight());
+
+    std::vector<KeyEvent> keys;
+    int64_t t = clock.NowNs() + 100 * NS_PER_MS;
+    AddWidgetTour(keys, t);
+    const int64_t warmNs = t;
+    for (int i = 0; i < 2; i++)
+        AddWidgetTour(keys, t);
+
+    uint64_t frames = 0, steadyFrames = 0, last = heapAllocations.load(std::memory_order_relaxed);
+    RunOverlayLoop(overlay, clock, t, keys, [&]
+    {
+        overlay.LayoutWindows([&](OverlayWindowId id, const IntRect& rect, auto report, auto draw)
+        {
+            UpdateCheckWindow(windows[id], rect, report, draw);
+        });
+        frames++;
+        uint64_t now = heapAllocations.load(std::memory_order_relaxed);
+        if (clock.NowNs() > warmNs)
+        {
+            steadyFrames++;
+            if (now != last)
+                result.Fail("frame %llu at %.3f s allocated %llu times", (unsigned long long)frames,
+                            (clock.NowNs() - warmNs) / (double)NS_PER_SEC, (unsigned long long)(now - last));
+        }
+        last = now;
+    });
+    if (steadyFrames < 100)
+        result.Fail("only %llu frames after warm-up", (unsigned long long)steadyFrames);
+}
+
+// --- Input ---
+
+// Fills to capacity and no further, empties in order, and keeps order as its
+// indices wrap round the buffer many times
+void CheckRingSingleThread(CheckResult& result)
+{
+    SpscRing<int, 8> ring{};
+    int item = -1;
+    if (ring.Pop(item))
+        result.Fail("popped %d from a new ring", item);
+    for (int i = 0; i < 8; i++)
+        if (!ring.Push(i))
+            result.Fail("push %d of 8 refused", i);
+    if (ring.Push(8))
+        result.Fail("a full ring took a ninth item");
+    if (ring.Size() != 8 || ring.Dropped() != 1)
+        result.Fail("full ring has size %zu and %llu dropped, expected 8 and 1", ring.Size(), (unsigned long long)ring.Dropped());
+    for (int i = 0; i < 8; i++)
+        if (!ring.Pop(item) || item != i)
+            result.Fail("pop %d gave %d", i, item);
+    if (ring.Pop(item) || ring.Size() != 0)
+        result.Fail("an emptied ring still gave %d", item);
+
+    int next = 100, expected = 100;
+    for (int round = 0; round < 100; round++)
+    {
+        for (int i = 0; i < 5; i++)
+            ring.Push(next++);
+        for (int i = 0; i < 5; i++)
+            if (!ring.Pop(item) || item != expected++)
+                result.Fail("round %d: popped %d, expected %d", round, item, expected - 1);
+    }
+    if (ring.Dropped() != 1)
+        result.Fail("%llu dropped after wrapping, expected 1", (unsigned long long)ring.Dropped());
+}
+
+// A producer and a consumer thread: every item arrives once, in order. The
+// producer retries a full ring instead of dropping, so nothing goes missing.
+void CheckRingTwoThreads(CheckResult& result)
+{
+    const uint64_t ITEMS = 200000;
+    SpscRing<uint64_t, 64> ring;
+    std::thread producer([&]
+    {
+        for (uint64_t i = 1; i <= ITEMS; i++)
+            while (!ring.Push(i))
+                std::this_thread::yield();
+    });
+    uint64_t expected = 1, item = 0;
+    while (expected <= ITEMS)
+    {
+        if (!ring.Pop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item != expected)
+            result.Fail("popped %llu, expected %llu", (unsigned long long)item, (unsigned long long)expected);
+        expected = item + 1;
+    }
+    producer.join();
+    if (ring.Pop(item))
+        result.Fail("popped %llu after the last item", (unsigned long long)item);
+}
+
+// Presses a KeyRepeater makes, and when the consumer saw each
+struct KeyPress
+{
+    int key;
+    int64_t atNs;
+};
+
+// Reads the events captured by nowNs the way Overlay::ProcessInput does:
+// repeats due before each event, the event, then repeats due by nowNs
+void ReadKeys(KeyRepeater& repeater, const std::vector<KeyEvent>& events, size_t& next, int64_t nowNs, std::vector<KeyPress>& presses)
+{
+    for (; next < events.size() && events[next].timeNs <= nowNs; next++)
+    {
+        const KeyEvent& e = events[next];
+        repeater.EmitRepeats(e.timeNs, [&](int key) { presses.push_back({ key, e.timeNs }); });
+        if (repeater.OnEvent(e))
+            presses.push_back({ e.key, e.timeNs });
+    }
+    repeater.EmitRepeats(nowNs, [&](int key) { presses.push_back({ key, nowNs }); });
+}
+
+KeyEvent MakeKey(int key, bool down, int64_t timeNs)
+{
+    KeyEvent e;
+    e.key = (uint16_t)key;
+    e.down = down;
+    e.timeNs = timeNs;
+    return e;
+}
+
+const int CHECK_KEY = 0x27;
+const int64_t CHECK_DELAY_NS = 300 * NS_PER_MS;
+const int64_t CHECK_INTERVAL_NS = 100 * NS_PER_MS;
+
+// Reads events and repeats every millisecond from 0 to endNs, skipping reads
+// in [stallNs, resumeNs)
+std::vector<KeyPress> RunKeys(const std::vector<KeyEvent>& events, int64_t endNs, int64_t stallNs = -1, int64_t resumeNs = -1)
+{
+    KeyRepeater repeater;
+    repeater.SetRepeat(CHECK_KEY, CHECK_DELAY_NS, CHECK_INTERVAL_NS);
+    std::vector<KeyPress> presses;
+    size_t next = 0;
+    for (int64_t now = 0; now <= endNs; now += NS_PER_MS)
+        if (now < stallNs || now >= resumeNs)
+            ReadKeys(repeater, events, next, now, presses);
+    return presses;
+}
+
+void ExpectPresses(CheckResult& result, const char* what, const std::vector<KeyPress>& presses, const std::vector<int64_t>& expectedNs)
+{
+    if (presses.size() != expectedNs.size())
+        result.Fail("%s: %zu presses, expected %zu", what, presses.size(), expectedNs.size());
+    for (size_t i = 0; i < presses.size() && i < expectedNs.size(); i++)
+        if (presses[i].atNs != expectedNs[i])
+            result.Fail("%s: press %zu at %.1f ms, expected %.1f ms", what, i, presses[i].atNs / 1e6, expectedNs[i] / 1e6);
+}
+
+// Only down transitions press: the OS's auto-repeat downs of a held key are
+// ignored, and a key with no repeat set never repeats
+void CheckKeyEdges(CheckResult& result)
+{
+    KeyRepeater repeater;
+    repeater.SetRepeat(CHECK_KEY, CHECK_DELAY_NS, CHECK_INTERVAL_NS);
+    if (!repeater.OnEvent(MakeKey(CHECK_KEY, true, 0)))
+        result.Fail("first down did not press");
+    for (int i = 1; i <= 5; i++)
+        if (repeater.OnEvent(MakeKey(CHECK_KEY, true, i * 33 * NS_PER_MS)))
+            result.Fail("OS auto-repeat down %d pressed", i);
+    if (repeater.OnEvent(MakeKey(CHECK_KEY, false, 200 * NS_PER_MS)) || repeater.IsDown(CHECK_KEY))
+        result.Fail("key up pressed or left the key down");
+    if (!repeater.OnEvent(MakeKey(CHECK_KEY, true, 250 * NS_PER_MS)))
+        result.Fail("down after up did not press");
+    if (repeater.OnEvent(MakeKey(KeyRepeater::MAX_KEYS, true, 0)))
+        result.Fail("a key past MAX_KEYS pressed");
+
+    std::vector<KeyEvent> events = { MakeKey(CHECK_KEY + 1, true, 0), MakeKey(CHECK_KEY + 1, false, 2 * NS_PER_SEC) };
+    KeyRepeater plain;
+    std::vector<KeyPress> presses;
+    size_t next = 0;
+    for (int64_t now = 0; now <= 2 * NS_PER_SEC; now += 10 * NS_PER_MS)
+        ReadKeys(plain, events, next, now, presses);
+    if (presses.size() != 1 || plain.NextRepeatDeadline() != INT64_MAX)
+        result.Fail("a key without repeat pressed %zu times", presses.size());
+}
+
+// A held key presses on its down, once after the delay, then every interval
+// until its up, each seen the moment it falls due
+void CheckKeyRepeatTiming(CheckResult& result)
+{
+    const int64_t downNs = 50 * NS_PER_MS, upNs = downNs + 1000 * NS_PER_MS;
+    std::vector<KeyEvent> events = { MakeKey(CHECK_KEY, true, downNs), MakeKey(CHECK_KEY, true, downNs + 500 * NS_PER_MS),
+                                     MakeKey(CHECK_KEY, false, upNs) };
+    std::vector<int64_t> expected = { downNs };
+    for (int64_t t = downNs + CHECK_DELAY_NS; t <= upNs; t += CHECK_INTERVAL_NS)
+        expected.push_back(t);
+    ExpectPresses(result, "held 1 s", RunKeys(events, 2 * NS_PER_SEC), expected);
+
+    KeyRepeater repeater;
+    repeater.SetRepeat(CHECK_KEY, CHECK_DELAY_NS, CHECK_INTERVAL_NS);
+    repeater.OnEvent(MakeKey(CHECK_KEY, true, downNs));
+    if (repeater.NextRepeatDeadline() != downNs + CHECK_DELAY_NS)
+        result.Fail("first repeat deadline %.1f ms, expected %.1f ms", repeater.NextRepeatDeadline() / 1e6, (downNs + CHECK_DELAY_NS) / 1e6);
+}
+
+// A consumer that reads late gets the repeats a key earned between its down
+// and up, and one repeat rather than a burst for a stretch it missed
+void CheckKeyLateConsumer(CheckResult& result)
+{
+    // Down and up read together, after the first repeat fell due
+    std::vector<KeyEvent> tap = { MakeKey(CHECK_KEY, true, 0), MakeKey(CHECK_KEY, false, 350 * NS_PER_MS) };
+    ExpectPresses(result, "down and up in one read", RunKeys(tap, NS_PER_SEC, 1, 400 * NS_PER_MS), { 0, 350 * NS_PER_MS });
+
+    // Held through a one-second stall: one repeat when reading resumes, the
+    // next an interval later
+    const int64_t resumeNs = 1500 * NS_PER_MS;
+    std::vector<KeyEvent> held = { MakeKey(CHECK_KEY, true, 0), MakeKey(CHECK_KEY, false, 1750 * NS_PER_MS) };
+    ExpectPresses(result, "held through a stall", RunKeys(held, 2 * NS_PER_SEC, 450 * NS_PER_MS, resumeNs),
+                  { 0, 300 * NS_PER_MS, 400 * NS_PER_MS, resumeNs, resumeNs + CHECK_INTERVAL_NS, resumeNs + 2 * CHECK_INTERVAL_NS });
+
+    // Held and released within a stall: one repeat, at the up
+    std::vector<KeyEvent> missed = { MakeKey(CHECK_KEY, true, 0), MakeKey(CHECK_KEY, false, 900 * NS_PER_MS) };
+    ExpectPresses(result, "held within a stall", RunKeys(missed, 2 * NS_PER_SEC, 1, resumeNs), { 0, 900 * NS_PER_MS });
+}
+
+// The same through the overlay: menu steps from Down presses the loop reads
+// late, as a batch or after a stall
+void CheckOverlayLateReads(CheckResult& result, TextRenderer& text)
+{
+    ManualClock clock(NS_PER_SEC);
+    Overlay overlay(clock, text, 0.0);
+    overlay.SetMonitorSize(1920, 1080);
+    const int64_t t0 = clock.NowNs();
+    auto read = [&](int64_t nowNs, std::vector<KeyEvent> events)
+    {
+        clock.Set(t0 + nowNs);
+        overlay.StartIteration();
+        size_t i = 0;
+        overlay.ProcessInput([&](KeyEvent& e)
+        {
+            if (i == events.size()) return false;
+            e = events[i++];
+            e.timeNs += t0;
+            return true;
+        });
+        return overlay.Settings().menuSelection;
+    };
+    auto steps = [](int from, int to) { return ((to - from) % MENU_ITEM_COUNT + MENU_ITEM_COUNT) % MENU_ITEM_COUNT; };
+
+    int start = read(10 * NS_PER_MS, { MakeKey(OVERLAY_KEY_INSERT, true, 0), MakeKey(OVERLAY_KEY_INSERT, false, 5 * NS_PER_MS) });
+    if (!overlay.Settings().menuOpen)
+        result.Fail("Insert did not open the menu");
+
+    // Held 400 ms, read in one go: the press and the repeat at 300 ms
+    int batched = read(1000 * NS_PER_MS, { MakeKey(OVERLAY_KEY_DOWN, true, 500 * NS_PER_MS), MakeKey(OVERLAY_KEY_DOWN, false, 900 * NS_PER_MS) });
+    if (steps(start, batched) != 2)
+        result.Fail("down and up in one read moved the menu %d rows, expected 2", steps(start, batched));
+
+    // Held through a two-second stall: the press, then one repeat, not seventeen
+    read(2000 * NS_PER_MS, { MakeKey(OVERLAY_KEY_DOWN, true, 2000 * NS_PER_MS) });
+    int stalled = read(4000 * NS_PER_MS, {});
+    read(4010 * NS_PER_MS, { MakeKey(OVERLAY_KEY_DOWN, false, 4005 * NS_PER_MS) });
+    if (steps(batched, stalled) != 2)
+        result.Fail("a key held through a stall moved the menu %d rows, expected 2", steps(batched, stalled));
+}
+
+// --- Raster ---
+
+// The ISAs to compare with scalar that this CPU runs
+std::vector<RasterIsa> VectorIsas()
+{
+    std::vector<RasterIsa> isas;
+    for (int i = RASTER_ISA_SSE2; i <= DetectRasterIsa(); i++)
+        isas.push_back((RasterIsa)i);
+    return isas;
+}
+
+// A premultiplied background that differs in every pixel, so kernels that
+// blend onto it have something to get wrong
+void FillCheckBackground(std::vector<Pixel>& pixels)
+{
+    uint32_t state = 0x9E3779B9u;
+    for (Pixel& p : pixels)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        uint32_t a = state >> 24;
+        uint32_t r = (state & 0xFF) * a / 255, g = (state >> 8 & 0xFF) * a / 255, b = (state >> 16 & 0xFF) * a / 255;
+        p = a << 24 | r << 16 | g << 8 | b;
+    }
+}
+
+struct ScopeCase
+{
+    int radius, offsetX, offsetY, vignetteWidth;
+};
+
+// The scope drawn by every ISA gives scalar's pixels exactly, and touches
+// nothing outside ScopeBounds. Cases cover a bare ring, thin and wide
+// vignettes, odd offsets that start spans off any vector alignment, and scopes
+// hanging off every edge of the surface or missing it altogether.
+void CheckScopeKernels(CheckResult& result)
+{
+    const int W = 237, H = 181, CX = W / 2, CY = H / 2;
+    const ScopeCase cases[] = {
+        { 1, 0, 0, 0 },       { 3, 0, 0, 1 },      { 7, -3, 5, 2 },      { 20, 1, -1, 13 },
+        { 40, 17, 9, 50 },    { 64, -5, 3, 0 },    { 100, 0, 0, 50 },    { 60, 90, -70, 25 },
+        { 45, -110, 60, 30 }, { 30, -CX, -CY, 7 }, { 25, W, H, 50 },     { 50, 400, 0, 50 },
+    };
+
+    std::vector<Pixel> background((size_t)W * H), scalar((size_t)W * H), drawn((size_t)W * H);
+    FillCheckBackground(background);
+    RasterIsa active = ActiveRasterKernels().isa;
+    for (const ScopeCase& c : cases)
+    {
+        scalar = background;
+        Surface s(scalar.data(), W, H, W);
+        SelectRasterIsa(RASTER_ISA_SCALAR);
+        DrawScopeOverlay(s, CX, CY, c.radius, c.offsetX, c.offsetY, c.vignetteWidth);
+
+        // Clipped to its bounds the scope draws the same pixels, and nothing beyond them
+        IntRect bounds = RectIntersect(ScopeBounds(CX, CY, c.radius, c.offsetX, c.offsetY, c.vignetteWidth), s.Bounds());
+        int changed = 0;
+        for (int y = 0; y < H; y++)
+            for (int x = 0; x < W; x++)
+            {
+                size_t i = (size_t)y * W + x;
+                bool inside = x >= bounds.left && x < bounds.right && y >= bounds.top && y < bounds.bottom;
+                changed += scalar[i] != background[i];
+                if (!inside && scalar[i] != background[i])
+                    result.Fail("radius %d offset %d,%d vignette %d drew (%d,%d) outside its bounds", c.radius, c.offsetX, c.offsetY,
+                                c.vignetteWidth, x, y);
+            }
+        if (!bounds.IsEmpty() && !changed)
+            result.Fail("radius %d offset %d,%d vignette %d drew nothing", c.radius, c.offsetX, c.offsetY, c.vignetteWidth);
+
+        for (RasterIsa isa : VectorIsas())
+        {
+            SelectRasterIsa(isa);
+            const char* name = ActiveRasterKernels().name;
+            for (int clipped = 0; clipped < 2; clipped++)
+            {
+                drawn = background;
+                Surface t(drawn.data(), W, H, W);
+                if (clipped)
+                    t.SetClip(bounds);
+                DrawScopeOverlay(t, CX, CY, c.radius, c.offsetX, c.offsetY, c.vignetteWidth);
+                for (size_t i = 0; i < drawn.size(); i++)
+                    if (drawn[i] != scalar[i])
+                    {
+                        result.Fail("%s%s radius %d offset %d,%d vignette %d: (%d,%d) %08x, scalar %08x", name, clipped ? " clipped" : "",
+                                    c.radius, c.offsetX, c.offsetY, c.vignetteWidth, (int)(i % W), (int)(i / W), drawn[i], scalar[i]);
+                        break;
+                    }
+            }
+        }
+    }
+    SelectRasterIsa(active);
+    if (VectorIsas().empty())
+        printf("  (no SSE2 or AVX2 on this CPU, only scalar's bounds checked)\n");
+}
+
+// --- Colour ---
+
+// Every looked-up hue is within one per channel of HsvToPixel's colour for
+// the same hue, across the wheel, at its segment edges and past whole turns
+void CheckHueTable(CheckResult& result)
+{
+    HueTable table;
+    const int SAMPLES = 100000;
+    for (int i = -SAMPLES; i < 3 * SAMPLES; i++)
+    {
+        float hue = (float)i / SAMPLES;
+        Pixel looked = table.At(hue);
+        Pixel computed = HsvToPixel(hue - floorf(hue), 1.0f, 1.0f);
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            int d = (int)(looked >> shift & 0xFF) - (int)(computed >> shift & 0xFF);
+            if (d < -1 || d > 1)
+            {
+                result.Fail("hue %.5f: table %08x, HsvToPixel %08x", hue, looked, computed);
+                break;
+            }
+        }
+    }
+}
+
+// Straight colours through PremultipliedColor and back with every ISA's
+// unpremultiply kernel: each ISA gives scalar's bytes, in spans of every
+// length up to a few vectors. Scalar's round trip is exact where it can be:
+// premultiplying what it gives back yields the same pixel at every alpha,
+// and at full alpha it is the colour itself. Below that premultiplying lost
+// bits, so the colour only comes back to within that rounding
+void CheckUnpremultiply(CheckResult& result)
+{
+    std::vector<Pixel> straight, premultiplied;
+    for (int a = 0; a < 256; a++)
+        for (int c = 0; c < 256; c++)
+        {
+            int r = c, g = 255 - c, b = c * 37 & 0xFF;
+            straight.push_back((Pixel)a << 24 | r << 16 | g << 8 | b);
+            premultiplied.push_back(PremultipliedColor(r, g, b, a));
+        }
+
+    const int count = (int)premultiplied.size();
+    std::vector<Pixel> scalar(count), back(count);
+    MakeRasterKernels(RASTER_ISA_SCALAR).unpremultiplySpan(scalar.data(), premultiplied.data(), count);
+    for (int i = 0; i < count; i++)
+    {
+        int a = straight[i] >> 24;
+        if (scalar[i] >> 24 != (uint32_t)a)
+            result.Fail("%08x: alpha came back as %u", premultiplied[i], scalar[i] >> 24);
+        if (PremultipliedColor(scalar[i] >> 16 & 0xFF, scalar[i] >> 8 & 0xFF, scalar[i] & 0xFF, a) != premultiplied[i])
+            result.Fail("%08x came back as %08x, which premultiplies to something else", premultiplied[i], scalar[i]);
+        if ((a == 255 && scalar[i] != straight[i]) || (a == 0 && scalar[i] != 0))
+            result.Fail("%08x from %08x came back as %08x", premultiplied[i], straight[i], scalar[i]);
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            int d = (int)(scalar[i] >> shift & 0xFF) - (int)(a ? straight[i] >> shift & 0xFF : 0);
+            if (2 * (d < 0 ? -d : d) * (a ? a : 1) > 255 + a)
+            {
+                result.Fail("%08x from %08x came back as %08x", premultiplied[i], straight[i], scalar[i]);
+                break;
+            }
+        }
+    }
+
+    for (RasterIsa isa : VectorIsas())
+    {
+        RasterKernels k = MakeRasterKernels(isa);
+        std::fill(back.begin(), back.end(), 0);
+        for (int i = 0, length = 1; i < count; i += length, length = length % 37 + 1)
+            k.unpremultiplySpan(back.data() + i, premultiplied.data() + i, i + length < count ? length : count - i);
+        for (int i = 0; i < count; i++)
+            if (back[i] != scalar[i])
+                result.Fail("%s: %08x came back as %08x, scalar %08x", k.name, premultiplied[i], back[i], scalar[i]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    CheckContext ctx;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+            ctx.filter = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: %s [--filter TEXT]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    BlockGlyphSource glyphs;
+    AtlasTextRenderer text;
+    text.Build(glyphs);
+
+    RunCheck(ctx, "animation/time_since_start", [&](CheckResult& r) { CheckAnimationTime(r, text); });
+    RunCheck(ctx, "damage/move_and_hide", CheckDamageMoveAndHide);
+    RunCheck(ctx, "damage/merge", CheckDamageMerge);
+    RunCheck(ctx, "damage/overflow", CheckDamageOverflow);
+    RunCheck(ctx, "damage/reset", CheckDamageReset);
+    RunCheck(ctx, "scheduler/deadlines", CheckSchedulerDeadlines);
+    RunCheck(ctx, "scheduler/requests_coalesce", CheckSchedulerRequests);
+    RunCheck(ctx, "scheduler/hold", CheckSchedulerHold);
+    RunCheck(ctx, "scheduler/overlay_idle", [&](CheckResult& r) { CheckOverlayIdle(r, text); });
+    RunCheck(ctx, "alloc/steady_state", [&](CheckResult& r) { CheckSteadyStateAllocations(r, text); });
+    RunCheck(ctx, "input/ring", CheckRingSingleThread);
+    RunCheck(ctx, "input/ring_threads", CheckRingTwoThreads);
+    RunCheck(ctx, "input/key_edges", CheckKeyEdges);
+    RunCheck(ctx, "input/key_repeat_timing", CheckKeyRepeatTiming);
+    RunCheck(ctx, "input/key_late_consumer", CheckKeyLateConsumer);
+    RunCheck(ctx, "input/overlay_late_reads", [&](CheckResult& r) { CheckOverlayLateReads(r, text); });
+    RunCheck(ctx, "color/hue_table", CheckHueTable);
+    RunCheck(ctx, "color/unpremultiply_isas", CheckUnpremultiply);
+    RunCheck(ctx, "raster/scope_isas", CheckScopeKernels);
+
+    printf("%d checks, %d failed\n", ctx.run, ctx.failed);
+    return ctx.failed ? 1 : 0;
+}
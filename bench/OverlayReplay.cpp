@@ -0,0 +1,625 @@
+// OverlayReplay.cpp: replays a recorded overlay session headless.
+//
+// Press F11 in a profiling build of the DLL to start recording a session to
+// astral_session.trace and again to stop. This reruns the overlay's loop
+// against that trace on a virtual clock: every iteration wakes at the time it
+// woke up live, reads the same keys and sees the same frame requests, monitor
+// changes and quality levels, and holds back the frames the DLL held for the
+// compositor (FramePacer.h). Windows are drawn into offscreen buffers the
+// way the DLL draws them, repainting only their damage, and laid over one
+// monitor-sized image in stacking order after each frame.
+//
+// For every frame it prints how long the overlay took to draw it and a hash of
+// the monitor image, and at the end how many window presents the DLL would have
+// made and skipped (PresentFilter.h). Nothing in the loop reads the real time,
+// so two runs of one trace give the same hashes on any machine with the same
+// raster ISA; a change that alters the hashes changed what the overlay draws.
+// The timings are what to compare for performance. The trace also holds the
+// settings after each change and the sources behind each frame, and a replay
+// that does not arrive at the same ones is reported as out of step.
+//
+// A trace replays from a fresh overlay with the settings it started with, so
+// one started while effects were running or the FPS readout was counting
+// can fall out of step with the live session for its first second.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -I. bench/OverlayReplay.cpp -o overlay_replay -pthread
+//   cl /std:c++17 /O2 /EHsc /I. bench\OverlayReplay.cpp
+//
+// Usage:
+//   overlay_replay TRACE [--json] [--png DIR] [--threads N] [--isa scalar|sse2|avx2]
+//                        [--no-alloc-after MS] [--telemetry NAME] [--realtime]
+//
+// --json prints one JSON object per frame and one for the summary (JSON
+// Lines). --png writes every frame to DIR/frame_NNNNNN.png. --threads draws
+// through the tile compositor on N threads, which must not change a hash.
+//
+// Each frame also reports how many times its iteration went to the heap
+// (Memory.h). Once every widget has been drawn that should be none, and
+// --no-alloc-after fails the run with status 3 if any frame more than MS into
+// the trace allocates.
+//
+// --telemetry publishes every frame to shared memory under NAME the way the
+// DLL does (Telemetry.h), for bench/TelemetryTail.cpp to read. Its profiler
+// stages read 0: they are timed on the overlay's clock, which is the trace's.
+// --realtime waits out the time between iterations instead of skipping it,
+// so a reader sees the session at the pace it was recorded.
+//
+// Window buffers and presents go through the platform shim (Platform.h) over
+// a mock backend, making the calls the DLL would. Each frame reports how many
+// it made, and a replay that ends with any object still alive lists the
+// leaks and exits with status 4.
+
+#include "Overlay.h"
+#include "Compositor.h"
+#include "PresentFilter.h"
+#include "Telemetry.h"
+#include "Platform.h"
+#include "BlockGlyphSource.h"
+#include "MockPlatformBackend.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ReplayOptions
+{
+    const char* tracePath = nullptr;
+    bool json = false;
+    const char* pngDir = nullptr;
+    int threads = 0;
+    double noAllocAfterMs = -1.0; // below 0 for no check
+    const char* telemetryName = nullptr;
+    bool realtime = false;
+};
+
+// --- Heap allocations ---
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC inlines these into the standard library and then takes free() to be
+// paired with a new it can't see was replaced
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// Every operator new in the process, the compositor's threads included
+std::atomic<uint64_t> heapAllocations(0);
+
+void* operator new(size_t bytes)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(bytes ? bytes : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// One widget window, offscreen: a single buffer, since nothing presents it
+// behind the loop's back
+struct ReplayWindow
+{
+    IntRect rect; // in monitor coordinates, empty while hidden
+    DirtyRegionTracker tracker;
+    PresentFilter presentFilter;
+    PlatformHandle bitmap = nullptr; // freed while hidden, as the DLL frees its buffers
+    Pixel* pixels = nullptr;
+    Surface surface;
+    bool shown = false;
+    uint64_t clearedBytes = 0;
+};
+
+// Where the DLL's present thread would show the window
+void PresentReplayWindow(ReplayWindow& w, TrackedPlatform& platform, PlatformHandle dc, const IntRect& dirty)
+{
+    PlatformHandle previous = platform.Select(dc, w.bitmap);
+    platform.Present(&w, dc, w.rect.left, w.rect.top, w.surface.width, w.surface.height, dirty);
+    platform.Select(dc, previous);
+    if (!w.shown)
+        platform.ShowWindow(&w, true);
+    w.shown = true;
+}
+
+void HideReplayWindow(ReplayWindow& w, TrackedPlatform& platform)
+{
+    w.rect = IntRect();
+    if (w.shown)
+        platform.ShowWindow(&w, false);
+    w.shown = false;
+    if (w.bitmap)
+        platform.DeleteBitmap(w.bitmap);
+    w.bitmap = nullptr;
+    w.pixels = nullptr;
+    w.surface = Surface();
+}
+
+// The DLL's UpdateOverlayWindow without the present thread. What would be
+// presented is counted into stats and shown through the platform.
+template <class ReportFn, class DrawFn>
+void UpdateReplayWindow(ReplayWindow& w, const IntRect& rect, ReportFn report, DrawFn draw, TileCompositor* compositor, DrawList& commands,
+                        PresentStats& stats, TrackedPlatform& platform, PlatformHandle dc)
+{
+    if (rect.IsEmpty())
+    {
+        HideReplayWindow(w, platform);
+        return;
+    }
+    if (rect.Width() != w.rect.Width() || rect.Height() != w.rect.Height())
+    {
+        w.tracker.Reset(rect.Width(), rect.Height());
+        w.presentFilter.Reset();
+        if (w.bitmap)
+            platform.DeleteBitmap(w.bitmap);
+        w.bitmap = platform.CreateBitmap(rect.Width(), rect.Height(), &w.pixels);
+        w.surface = Surface(w.pixels, rect.Width(), rect.Height(), rect.Width());
+    }
+    bool moved = rect.left != w.rect.left || rect.top != w.rect.top;
+    w.rect = rect;
+
+    int dx = -rect.left, dy = -rect.top;
+    w.tracker.BeginFrame();
+    report(w.tracker, dx, dy);
+    w.tracker.Resolve();
+    if (!w.tracker.HasDamage())
+    {
+        if (moved)
+        {
+            stats.presented++;
+            PresentReplayWindow(w, platform, dc, w.tracker.SurfaceBounds());
+        }
+        return;
+    }
+
+    ClearDamage(w.pixels, w.surface.stride * 4, w.tracker);
+    for (int i = 0; i < w.tracker.DamageCount(); i++)
+        w.clearedBytes += (uint64_t)w.tracker.Damage(i).Area() * sizeof(Pixel);
+    Surface target = w.surface;
+    if (compositor)
+    {
+        commands.Clear();
+        target.recorder = &commands;
+    }
+    for (int i = 0; i < w.tracker.DamageCount(); i++)
+    {
+        const IntRect& damage = w.tracker.Damage(i);
+        target.SetClip(damage);
+        draw(target, damage, dx, dy);
+    }
+    if (compositor)
+        compositor->Compose(commands, w.surface);
+
+    IntRect dirty = w.tracker.DamageBounds();
+    if (w.presentFilter.ShouldPresent(w.surface, dirty, moved, stats))
+        PresentReplayWindow(w, platform, dc, dirty);
+}
+
+// Lays every shown window over a cleared monitor image, bottom to top
+void ComposeMonitor(std::vector<Pixel>& monitor, int width, int height, const ReplayWindow* windows)
+{
+    monitor.assign((size_t)width * height, 0);
+    const RasterKernels& k = ActiveRasterKernels();
+    for (int i = 0; i < WINDOW_COUNT; i++)
+    {
+        const ReplayWindow& w = windows[i];
+        IntRect r = RectIntersect(w.rect, MakeRect(0, 0, width, height));
+        if (r.IsEmpty()) continue;
+        for (int y = r.top; y < r.bottom; y++)
+            k.blendPixelSpan(&monitor[(size_t)y * width + r.left], &w.pixels[(size_t)(y - w.rect.top) * w.surface.stride + (r.left - w.rect.left)], r.Width());
+    }
+}
+
+// --- PNG output: RGBA, stored (uncompressed) deflate blocks ---
+
+uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+    static uint32_t table[256];
+    if (!table[1])
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+void PutBigEndian(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back((uint8_t)(v >> 24));
+    out.push_back((uint8_t)(v >> 16));
+    out.push_back((uint8_t)(v >> 8));
+    out.push_back((uint8_t)v);
+}
+
+void PutChunk(FILE* f, const char* type, const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> chunk;
+    PutBigEndian(chunk, (uint32_t)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    PutBigEndian(chunk, Crc32(0, chunk.data() + 4, chunk.size() - 4));
+    fwrite(chunk.data(), 1, chunk.size(), f);
+}
+
+bool WritePng(const char* path, const std::vector<Pixel>& pixels, int width, int height)
+{
+    FILE* f = nullptr;
+#if defined(_MSC_VER)
+    if (fopen_s(&f, path, "wb") != 0) f = nullptr;
+#else
+    f = fopen(path, "wb");
+#endif
+    if (!f) return false;
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(signature, 1, sizeof(signature), f);
+
+    std::vector<uint8_t> header;
+    PutBigEndian(header, (uint32_t)width);
+    PutBigEndian(header, (uint32_t)height);
+    header.push_back(8); // bits per channel
+    header.push_back(6); // RGBA
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    PutChunk(f, "IHDR", header);
+
+    // Rows of straight-alpha RGBA, each behind a "no filter" byte
+    std::vector<uint8_t> raw;
+    raw.reserve((size_t)(width * 4 + 1) * height);
+    std::vector<Pixel> straight((size_t)width);
+    for (int y = 0; y < height; y++)
+    {
+        ActiveRasterKernels().unpremultiplySpan(straight.data(), pixels.data() + (size_t)y * width, width);
+        raw.push_back(0);
+        for (Pixel p : straight)
+        {
+            raw.push_back((uint8_t)(p >> 16));
+            raw.push_back((uint8_t)(p >> 8));
+            raw.push_back((uint8_t)p);
+            raw.push_back((uint8_t)(p >> 24));
+        }
+    }
+
+    std::vector<uint8_t> z = { 0x78, 0x01 };
+    uint32_t s1 = 1, s2 = 0; // Adler-32
+    for (size_t pos = 0; pos < raw.size(); )
+    {
+        size_t n = raw.size() - pos < 65535 ? raw.size() - pos : 65535;
+        z.push_back(pos + n == raw.size() ? 1 : 0);
+        z.push_back((uint8_t)n);
+        z.push_back((uint8_t)(n >> 8));
+        z.push_back((uint8_t)~n);
+        z.push_back((uint8_t)(~n >> 8));
+        z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + n);
+        for (size_t i = pos; i < pos + n; i++)
+        {
+            s1 = (s1 + raw[i]) % 65521;
+            s2 = (s2 + s1) % 65521;
+        }
+        pos += n;
+    }
+    PutBigEndian(z, s2 << 16 | s1);
+    PutChunk(f, "IDAT", z);
+    PutChunk(f, "IEND", std::vector<uint8_t>());
+
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+// --- Replay ---
+
+int Replay(const ReplayOptions& options)
+{
+    TraceReader trace;
+    if (!trace.Open(options.tracePath))
+    {
+        fprintf(stderr, "can't read trace %s\n", options.tracePath);
+        return 1;
+    }
+
+    // Overlay time comes from the trace; only the frame timings read the real clock
+    ManualClock clock(trace.StartNs());
+    SteadyClock realClock;
+
+    BlockGlyphSource glyphs;
+    AtlasTextRenderer text;
+    text.Build(glyphs);
+
+    // No budget: the quality levels come from the trace
+    Overlay overlay(clock, text, 0.0);
+    overlay.SetMonitorSize(trace.MonitorWidth(), trace.MonitorHeight());
+    overlay.RestoreSettings(trace.StartSettings());
+
+    TileCompositor* compositor = options.threads > 0 ? new TileCompositor(realClock, options.threads) : nullptr;
+    FrameArena frameArena;
+    DrawList commands(&frameArena);
+    ReplayWindow windows[WINDOW_COUNT];
+    std::vector<Pixel> monitor;
+
+    MockPlatformBackend mockBackend;
+    ResourceTracker resources;
+    TrackedPlatform platform(mockBackend, resources, realClock);
+    PlatformHandle presentDc = platform.CreateContext();
+
+    std::vector<TraceRecord> records;
+    TraceRecord r;
+    while (trace.Next(r))
+        records.push_back(r);
+
+    TelemetryWriter telemetry;
+    if (options.telemetryName)
+    {
+        const char* sourceNames[FrameScheduler::MAX_SOURCES];
+        FrameScheduler& scheduler = overlay.Scheduler();
+        for (int i = 0; i < scheduler.SourceCount(); i++)
+            sourceNames[i] = scheduler.SourceName(i);
+        if (!telemetry.Open(options.telemetryName, PROFILE_STAGE_NAMES, STAGE_COUNT, sourceNames, scheduler.SourceCount(), (uint64_t)realClock.NowNs()))
+        {
+            fprintf(stderr, "can't create telemetry %s\n", options.telemetryName);
+            delete compositor;
+            return 1;
+        }
+    }
+    PresentStats telemetryPresentStats;
+    uint64_t telemetryClearedBytes = 0;
+    int64_t realStartNs = realClock.NowNs();
+
+    const char* isa = ActiveRasterKernels().name;
+    LatencyHistogram frameTimes;
+    PresentStats presentStats; // window presents the DLL would have made
+    uint64_t sessionHash = 0;
+    uint64_t iterations = 0, frames = 0, outOfStep = 0;
+    uint64_t frameAllocations = 0, allocatingFrames = 0, lateAllocations = 0;
+    int64_t totalNs = 0;
+
+    size_t next = 0;
+    while (next < records.size())
+    {
+        // One loop iteration: its tick and everything recorded up to the next
+        if (records[next].type != TRACE_TICK)
+        {
+            next++;
+            continue;
+        }
+        size_t end = next + 1;
+        while (end < records.size() && records[end].type != TRACE_TICK)
+            end++;
+
+        if (options.realtime)
+        {
+            int64_t due = realStartNs + (records[next].timeNs - trace.StartNs());
+            int64_t now = realClock.NowNs();
+            if (due > now)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+        }
+        clock.Set(records[next].timeNs);
+        iterations++;
+        uint64_t allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+        overlay.StartIteration();
+        commands.Clear();
+        frameArena.Reset();
+
+        size_t i = next + 1;
+        for (; i < end && records[i].type != TRACE_KEY && records[i].type != TRACE_SETTINGS && records[i].type != TRACE_FRAME &&
+               records[i].type != TRACE_HOLD; i++)
+        {
+            if (records[i].type == TRACE_QUALITY)
+                overlay.SetQualityLevel(records[i].level);
+            else if (records[i].type == TRACE_REQUEST)
+                overlay.RequestFrame();
+            else if (records[i].type == TRACE_MONITOR)
+                overlay.SetMonitorSize(records[i].width, records[i].height);
+            else if (records[i].type == TRACE_PROFILE)
+                overlay.ApplyProfile(records[i].settings);
+        }
+
+        // The DLL switches profiles on keys it reads itself, in among the overlay's
+        overlay.ProcessInput([&](KeyEvent& e)
+        {
+            for (; i < end && records[i].type == TRACE_PROFILE; i++)
+                overlay.ApplyProfile(records[i].settings);
+            if (i >= end || records[i].type != TRACE_KEY)
+                return false;
+            e = records[i++].key;
+            return true;
+        });
+
+        uint32_t expectedFired = 0;
+        bool held = false;
+        for (; i < end; i++)
+        {
+            if (records[i].type == TRACE_SETTINGS && records[i].settings != overlay.Settings())
+                outOfStep++;
+            if (records[i].type == TRACE_FRAME)
+                expectedFired = records[i].fired;
+            if (records[i].type == TRACE_HOLD)
+                held = true;
+        }
+
+        // The DLL held this frame back for the compositor, and drew it in a later iteration
+        if (held)
+            overlay.HoldFrame();
+        uint32_t fired = held ? 0 : overlay.BeginFrame();
+        if (fired != expectedFired)
+            outOfStep++;
+        next = end;
+        if (!fired)
+            continue;
+
+        int64_t start = realClock.NowNs();
+        overlay.LayoutWindows([&](OverlayWindowId id, const IntRect& rect, auto report, auto draw)
+        {
+            UpdateReplayWindow(windows[id], rect, report, draw, compositor, commands, presentStats, platform, presentDc);
+        });
+        int64_t frameNs = realClock.NowNs() - start;
+        frameTimes.Record((uint64_t)frameNs);
+        totalNs += frameNs;
+
+        int width = overlay.MonitorWidth(), height = overlay.MonitorHeight();
+        ComposeMonitor(monitor, width, height, windows);
+        uint64_t hash = ActiveRasterKernels().hashSpan(monitor.data(), (int)monitor.size(), (uint64_t)width << 32 | (uint32_t)height);
+        sessionHash = HashCombine(sessionHash, hash);
+
+        // Up to here the iteration did what the DLL's does; printing and PNGs are the replay's own
+        resources.EndFrame();
+        uint32_t osCalls = resources.LastFrame().TotalCalls();
+        uint64_t allocations = heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+        double ms = (clock.NowNs() - trace.StartNs()) / (double)NS_PER_MS;
+        frameAllocations += allocations;
+        if (allocations)
+        {
+            allocatingFrames++;
+            if (options.noAllocAfterMs >= 0.0 && ms > options.noAllocAfterMs)
+                lateAllocations += allocations;
+        }
+
+        if (telemetry.IsOpen())
+        {
+            TelemetryRecord t = {};
+            t.timeNs = clock.NowNs();
+            t.frameNs = (uint32_t)frameNs;
+            t.reasons = fired;
+            uint64_t cleared = 0;
+            for (const ReplayWindow& w : windows)
+                cleared += w.clearedBytes;
+            t.clearedBytes = cleared - telemetryClearedBytes;
+            t.presentedBytes = presentStats.presentedBytes - telemetryPresentStats.presentedBytes;
+            t.windowsPresented = (uint16_t)(presentStats.presented - telemetryPresentStats.presented);
+            t.windowsSkipped = (uint16_t)(presentStats.skipped - telemetryPresentStats.skipped);
+            t.heapAllocations = (uint16_t)allocations;
+            t.qualityLevel = (uint16_t)overlay.Governor().Level();
+            telemetry.Publish(t);
+            telemetryPresentStats = presentStats;
+            telemetryClearedBytes = cleared;
+        }
+
+        if (options.json)
+            printf("{\"frame\":%llu,\"time_ms\":%.3f,\"fired\":%u,\"draw_ns\":%lld,\"allocs\":%llu,\"os_calls\":%u,\"hash\":\"%016llx\"}\n",
+                   (unsigned long long)frames, ms, fired, (long long)frameNs, (unsigned long long)allocations, osCalls, (unsigned long long)hash);
+        else
+            printf("frame %6llu  t=%10.3f ms  fired=%04x  draw %8.1f us  allocs %4llu  os %3u  %016llx\n",
+                   (unsigned long long)frames, ms, fired, frameNs / 1000.0, (unsigned long long)allocations, osCalls, (unsigned long long)hash);
+
+        if (options.pngDir)
+        {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/frame_%06llu.png", options.pngDir, (unsigned long long)frames);
+            if (!WritePng(path, monitor, width, height))
+                fprintf(stderr, "can't write %s\n", path);
+        }
+        frames++;
+    }
+
+    // Everything the replay created goes back, so what is still alive leaked
+    for (ReplayWindow& w : windows)
+        HideReplayWindow(w, platform);
+    platform.DeleteContext(presentDc);
+    uint64_t osCalls = 0, objectsCreated = 0;
+    for (int c = 0; c < CALL_COUNT; c++)
+        osCalls += resources.Calls((PlatformCall)c);
+    for (int k = 0; k < OBJECT_COUNT; k++)
+        objectsCreated += resources.CreatedCount((PlatformObject)k);
+    int leaked = resources.LiveCount();
+    uint64_t strays = resources.Strays();
+    resources.WriteLeaks(stderr);
+
+    double meanUs = frames ? totalNs / 1000.0 / frames : 0.0;
+    double callsPerFrame = frames ? (double)osCalls / frames : 0.0;
+    const MemoryStats& sprites = overlay.Sprites().MemoryUse();
+    if (options.json)
+        printf("{\"summary\":true,\"trace\":\"%s\",\"bytes\":%llu,\"isa\":\"%s\",\"threads\":%d,\"iterations\":%llu,\"frames\":%llu,"
+               "\"out_of_step\":%llu,\"draw_mean_us\":%.2f,\"draw_p50_us\":%.2f,\"draw_p99_us\":%.2f,\"presented\":%llu,\"skipped\":%llu,"
+               "\"hashed_bytes\":%llu,\"frame_allocs\":%llu,\"allocating_frames\":%llu,\"late_allocs\":%llu,\"sprite_peak_bytes\":%llu,"
+               "\"pool_hit_rate\":%.4f,\"arena_bytes\":%llu,\"os_calls\":%llu,\"os_calls_per_frame\":%.2f,\"os_objects\":%llu,"
+               "\"leaked\":%d,\"stray_frees\":%llu,\"session_hash\":\"%016llx\"}\n",
+               options.tracePath, (unsigned long long)trace.Bytes(), isa, options.threads, (unsigned long long)iterations,
+               (unsigned long long)frames, (unsigned long long)outOfStep, meanUs,
+               frameTimes.Percentile(50) / 1000.0, frameTimes.Percentile(99) / 1000.0, (unsigned long long)presentStats.presented,
+               (unsigned long long)presentStats.skipped, (unsigned long long)presentStats.hashedBytes, (unsigned long long)frameAllocations,
+               (unsigned long long)allocatingFrames, (unsigned long long)lateAllocations, (unsigned long long)sprites.peakBytes,
+               sprites.PoolHitRate(), (unsigned long long)frameArena.Stats().pooledBytes, (unsigned long long)osCalls, callsPerFrame,
+               (unsigned long long)objectsCreated, leaked, (unsigned long long)strays, (unsigned long long)sessionHash);
+    else
+        printf("%s: %llu bytes, isa %s, %d threads\n"
+               "%llu iterations, %llu frames, %llu out of step\n"
+               "draw mean %.2f us, p50 %.2f us, p99 %.2f us\n"
+               "window presents %llu, skipped as unchanged %llu, %llu bytes hashed\n"
+               "heap allocations %llu in %llu frames, %llu late; sprites peak %llu KB, pool hits %.1f%%, arena %llu KB\n"
+               "os calls %llu (%.1f per frame), objects created %llu, leaked %d, stray frees %llu\n"
+               "session hash %016llx\n",
+               options.tracePath, (unsigned long long)trace.Bytes(), isa, options.threads,
+               (unsigned long long)iterations, (unsigned long long)frames, (unsigned long long)outOfStep,
+               meanUs, frameTimes.Percentile(50) / 1000.0, frameTimes.Percentile(99) / 1000.0,
+               (unsigned long long)presentStats.presented, (unsigned long long)presentStats.skipped,
+               (unsigned long long)presentStats.hashedBytes, (unsigned long long)frameAllocations,
+               (unsigned long long)allocatingFrames, (unsigned long long)lateAllocations, (unsigned long long)sprites.peakBytes / 1024,
+               sprites.PoolHitRate() * 100.0, (unsigned long long)frameArena.Stats().pooledBytes / 1024,
+               (unsigned long long)osCalls, callsPerFrame, (unsigned long long)objectsCreated, leaked, (unsigned long long)strays,
+               (unsigned long long)sessionHash);
+
+    delete compositor;
+    if (outOfStep)
+        return 2;
+    if (lateAllocations)
+        return 3;
+    return leaked || strays ? 4 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    ReplayOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--json"))
+            options.json = true;
+        else if (!strcmp(arg, "--png") && hasValue)
+            options.pngDir = argv[++i];
+        else if (!strcmp(arg, "--threads") && hasValue)
+            options.threads = atoi(argv[++i]);
+        else if (!strcmp(arg, "--no-alloc-after") && hasValue)
+            options.noAllocAfterMs = atof(argv[++i]);
+        else if (!strcmp(arg, "--telemetry") && hasValue)
+            options.telemetryName = argv[++i];
+        else if (!strcmp(arg, "--realtime"))
+            options.realtime = true;
+        else if (!strcmp(arg, "--isa") && hasValue)
+        {
+            const char* isa = argv[++i];
+            if (!strcmp(isa, "scalar")) SelectRasterIsa(RASTER_ISA_SCALAR);
+            else if (!strcmp(isa, "sse2")) SelectRasterIsa(RASTER_ISA_SSE2);
+            else if (!strcmp(isa, "avx2")) SelectRasterIsa(RASTER_ISA_AVX2);
+            else
+            {
+                fprintf(stderr, "unknown isa: %s\n", isa);
+                return 1;
+            }
+        }
+        else if (arg[0] != '-' && !options.tracePath)
+            options.tracePath = arg;
+        else
+        {
+            options.tracePath = nullptr;
+            break;
+        }
+    }
+    if (!options.tracePath)
+    {
+        fprintf(stderr, "usage: %s TRACE [--json] [--png DIR] [--threads N] [--isa scalar|sse2|avx2] [--no-alloc-after MS] [--telemetry NAME] [--realtime]\n", argv[0]);
+        return 1;
+    }
+    return Replay(options);
+}
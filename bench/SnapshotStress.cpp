@@ -0,0 +1,141 @@
+// SnapshotStress.cpp: one writer and several readers hammering a SnapshotCell.
+//
+// The writer publishes values as fast as it can. Every word of a value is
+// derived from its publish number, so a reader can tell a whole value from one
+// put together from two publishes. Each reader checks every copy it gets:
+// - its words all belong to the same publish (no tearing);
+// - that publish is the generation Read returned;
+// - generations never go back, from Read or from Generation().
+// It prints the counts and exits with status 1 on any failure. Build it with
+// -fsanitize=thread too: the cell is meant to give a race detector nothing to
+// report.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -I. bench/SnapshotStress.cpp -o snapshot_stress -pthread
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -I. bench/SnapshotStress.cpp -o snapshot_stress_tsan -pthread
+//   cl /std:c++17 /O2 /EHsc /I. bench\SnapshotStress.cpp
+//
+// Usage:
+//   snapshot_stress [--readers N] [--publishes N]
+
+#include "Snapshot.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// About the size of OverlaySettings, and not a whole number of words
+struct StressValue
+{
+    uint64_t publish;
+    uint32_t words[29];
+    uint16_t tail;
+};
+
+StressValue MakeValue(uint64_t publish)
+{
+    StressValue v;
+    memset(&v, 0, sizeof(v));
+    v.publish = publish;
+    for (uint32_t i = 0; i < 29; i++)
+        v.words[i] = (uint32_t)(publish * 2654435761u) ^ i * 0x9E3779B9u;
+    v.tail = (uint16_t)~publish;
+    return v;
+}
+
+struct ReaderResult
+{
+    uint64_t reads = 0;
+    uint64_t changes = 0;   // reads that saw a newer generation than the last
+    uint64_t torn = 0;
+    uint64_t mismatched = 0; // value from another publish than the generation returned
+    uint64_t backwards = 0;
+};
+
+void Reader(const SnapshotCell<StressValue>& cell, const std::atomic<bool>& done, ReaderResult& r)
+{
+    uint64_t last = 0, lastSeen = 0;
+    StressValue v;
+    while (!done.load(std::memory_order_acquire))
+    {
+        uint64_t generation = cell.Read(v);
+        r.reads++;
+        StressValue expected = MakeValue(v.publish);
+        if (memcmp(&v, &expected, sizeof(v)))
+            r.torn++;
+        if (v.publish != generation)
+            r.mismatched++;
+        if (generation < last)
+            r.backwards++;
+        if (generation > last)
+            r.changes++;
+        last = generation;
+
+        uint64_t seen = cell.Generation();
+        if (seen < lastSeen || seen < generation)
+            r.backwards++;
+        lastSeen = seen;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int readers = 4;
+    uint64_t publishes = 200000;
+    bool valid = true;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--readers") && hasValue)
+            readers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--publishes") && hasValue)
+            publishes = strtoull(argv[++i], nullptr, 10);
+        else
+            valid = false;
+    }
+    if (!valid || readers < 1 || !publishes)
+    {
+        fprintf(stderr, "usage: %s [--readers N] [--publishes N]\n", argv[0]);
+        return 1;
+    }
+
+    // Generation 0 holds publish 0's value, as if it had been published
+    SnapshotCell<StressValue> cell(MakeValue(0));
+    std::atomic<bool> done{ false };
+    std::vector<ReaderResult> results(readers);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readers; i++)
+        threads.emplace_back(Reader, std::cref(cell), std::cref(done), std::ref(results[i]));
+
+    // The writer yields now and then so readers get to run between publishes
+    // even with fewer cores than threads
+    uint64_t wrongGeneration = 0;
+    for (uint64_t p = 1; p <= publishes; p++)
+    {
+        if (cell.Publish(MakeValue(p)) != p)
+            wrongGeneration++;
+        if (p % 256 == 0)
+            std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release);
+    for (std::thread& t : threads)
+        t.join();
+
+    ReaderResult all;
+    for (const ReaderResult& r : results)
+    {
+        all.reads += r.reads;
+        all.changes += r.changes;
+        all.torn += r.torn;
+        all.mismatched += r.mismatched;
+        all.backwards += r.backwards;
+    }
+    printf("%llu publishes, %d readers: %llu reads, %llu saw a new generation\n", (unsigned long long)publishes, readers,
+           (unsigned long long)all.reads, (unsigned long long)all.changes);
+    printf("torn %llu, wrong generation %llu, generation went back %llu, writer's generation wrong %llu\n",
+           (unsigned long long)all.torn, (unsigned long long)all.mismatched, (unsigned long long)all.backwards,
+           (unsigned long long)wrongGeneration);
+    return all.torn || all.mismatched || all.backwards || wrongGeneration ? 1 : 0;
+}
@@ -0,0 +1,233 @@
+// TelemetryTail.cpp: follows the overlay's frame telemetry from outside the game.
+//
+// The DLL publishes every frame it draws to shared memory (Telemetry.h). This
+// maps that memory read-only and, like tail -f, prints a report every interval
+// over the most recent frames. A report gives the frame rate, percentiles of
+// the frame time and of every profiler stage that ran, the bytes cleared and
+// presented per second, the window presents skipped as unchanged, and what
+// share of frames each source asked for. The overlay never waits for the
+// reader: a reader that falls more than a ring behind reports the frames it
+// lost.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -I. bench/TelemetryTail.cpp -o telemetry_tail
+//   cl /std:c++17 /O2 /EHsc /I. bench\TelemetryTail.cpp
+//
+// Usage:
+//   telemetry_tail [--name NAME] [--window FRAMES] [--interval MS] [--reports N] [--json]
+//
+// --window sets how many of the latest frames a report covers (600). --reports
+// stops after N reports. --json prints each report as one JSON object (JSON
+// Lines). On Linux, bench/OverlayReplay.cpp --telemetry NAME --realtime
+// publishes a recorded session the same way.
+
+#include "Telemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct TailOptions
+{
+    const char* name = TELEMETRY_DEFAULT_NAME;
+    size_t window = 600;
+    int intervalMs = 1000;
+    int reports = 0; // 0 for no end
+    bool json = false;
+};
+
+// Nearest-rank percentile of values, which it sorts
+uint32_t Percentile(std::vector<uint32_t>& values, double p)
+{
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)(p / 100.0 * values.size());
+    return values[rank < values.size() ? rank : values.size() - 1];
+}
+
+// --- Report ---
+
+void PrintReport(const TailOptions& options, const TelemetryReader& reader, const std::vector<TelemetryRecord>& frames)
+{
+    const TelemetryRecord& first = frames.front();
+    const TelemetryRecord& last = frames.back();
+    double spanSeconds = (last.timeNs - first.timeNs) / 1e9;
+    double fps = spanSeconds > 0.0 ? (frames.size() - 1) / spanSeconds : 0.0;
+
+    std::vector<uint32_t> values;
+    values.reserve(frames.size());
+    for (const TelemetryRecord& r : frames)
+        values.push_back(r.frameNs);
+    uint32_t p50 = Percentile(values, 50), p95 = Percentile(values, 95), p99 = Percentile(values, 99);
+    uint32_t maxNs = values.back();
+
+    uint64_t cleared = 0, presented = 0, windowsPresented = 0, windowsSkipped = 0, allocations = 0;
+    uint64_t reasonCounts[TELEMETRY_MAX_REASONS] = {}, requested = 0;
+    for (const TelemetryRecord& r : frames)
+    {
+        cleared += r.clearedBytes;
+        presented += r.presentedBytes;
+        windowsPresented += r.windowsPresented;
+        windowsSkipped += r.windowsSkipped;
+        allocations += r.heapAllocations;
+        for (int i = 0; i < reader.ReasonCount(); i++)
+            if (r.reasons & (1u << i))
+                reasonCounts[i]++;
+        if (r.reasons & (1u << 31))
+            requested++;
+    }
+    double perSecond = spanSeconds > 0.0 ? 1.0 / spanSeconds : 0.0;
+    double share = 100.0 / frames.size();
+
+    if (options.json)
+    {
+        printf("{\"frame\":%llu,\"frames\":%zu,\"lost\":%llu,\"fps\":%.2f,\"frame_p50_us\":%.2f,\"frame_p95_us\":%.2f,\"frame_p99_us\":%.2f,"
+               "\"frame_max_us\":%.2f,\"cleared_bps\":%.0f,\"presented_bps\":%.0f,\"windows_presented\":%llu,\"windows_skipped\":%llu,"
+               "\"heap_allocations\":%llu,\"quality\":%u,\"stages\":{",
+               (unsigned long long)last.frame, frames.size(), (unsigned long long)reader.Lost(), fps, p50 / 1000.0, p95 / 1000.0,
+               p99 / 1000.0, maxNs / 1000.0, cleared * perSecond, presented * perSecond, (unsigned long long)windowsPresented,
+               (unsigned long long)windowsSkipped, (unsigned long long)allocations, (unsigned)last.qualityLevel);
+        bool firstStage = true;
+        for (int s = 0; s < reader.StageCount(); s++)
+        {
+            values.clear();
+            for (const TelemetryRecord& r : frames)
+                if (r.stageNs[s])
+                    values.push_back(r.stageNs[s]);
+            if (values.empty()) continue;
+            printf("%s\"%s\":{\"frames\":%zu,\"p50_us\":%.2f,\"p99_us\":%.2f}", firstStage ? "" : ",", reader.StageName(s), values.size(),
+                   Percentile(values, 50) / 1000.0, Percentile(values, 99) / 1000.0);
+            firstStage = false;
+        }
+        printf("},\"reasons\":{\"request\":%.1f", requested * share);
+        for (int i = 0; i < reader.ReasonCount(); i++)
+            printf(",\"%s\":%.1f", reader.ReasonName(i), reasonCounts[i] * share);
+        printf("}}\n");
+        fflush(stdout);
+        return;
+    }
+
+    printf("frame %llu: %zu frames, %.1f fps, %llu lost, quality %u\n", (unsigned long long)last.frame, frames.size(), fps,
+           (unsigned long long)reader.Lost(), (unsigned)last.qualityLevel);
+    printf("  %-12s p50 %8.1f us  p95 %8.1f us  p99 %8.1f us  max %8.1f us\n", "frame", p50 / 1000.0, p95 / 1000.0, p99 / 1000.0, maxNs / 1000.0);
+    for (int s = 0; s < reader.StageCount(); s++)
+    {
+        values.clear();
+        for (const TelemetryRecord& r : frames)
+            if (r.stageNs[s])
+                values.push_back(r.stageNs[s]);
+        if (values.empty()) continue;
+        printf("  %-12s p50 %8.1f us  p99 %8.1f us  in %zu frames\n", reader.StageName(s), Percentile(values, 50) / 1000.0,
+               Percentile(values, 99) / 1000.0, values.size());
+    }
+    printf("  cleared %.2f MB/s, presented %.2f MB/s, window presents %llu, skipped as unchanged %llu, heap allocations %llu\n",
+           cleared * perSecond / (1024.0 * 1024.0), presented * perSecond / (1024.0 * 1024.0), (unsigned long long)windowsPresented,
+           (unsigned long long)windowsSkipped, (unsigned long long)allocations);
+    printf("  drawn for: request %.1f%%", requested * share);
+    for (int i = 0; i < reader.ReasonCount(); i++)
+        if (reasonCounts[i])
+            printf(", %s %.1f%%", reader.ReasonName(i), reasonCounts[i] * share);
+    printf("\n");
+    fflush(stdout);
+}
+
+// --- Tail ---
+
+int Tail(const TailOptions& options)
+{
+    TelemetryReader reader;
+    bool waiting = false;
+    while (!reader.Open(options.name))
+    {
+        if (!waiting)
+            fprintf(stderr, "waiting for telemetry %s\n", options.name);
+        waiting = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    // The latest frames, oldest first once the window has filled
+    std::vector<TelemetryRecord> frames;
+    frames.reserve(options.window);
+    size_t oldest = 0;
+
+    const auto poll = std::chrono::milliseconds(10);
+    auto nextReport = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.intervalMs);
+    auto lastRecord = std::chrono::steady_clock::now();
+    int reports = 0;
+    for (;;)
+    {
+        TelemetryRecord r;
+        while (reader.Next(r))
+        {
+            if (frames.size() < options.window)
+                frames.push_back(r);
+            else
+            {
+                frames[oldest] = r;
+                oldest = (oldest + 1) % options.window;
+            }
+            lastRecord = std::chrono::steady_clock::now();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextReport)
+        {
+            nextReport += std::chrono::milliseconds(options.intervalMs);
+            if (!frames.empty())
+            {
+                std::rotate(frames.begin(), frames.begin() + oldest, frames.end());
+                oldest = 0;
+                PrintReport(options, reader, frames);
+                if (options.reports && ++reports == options.reports)
+                    return 0;
+            }
+        }
+
+        // Quiet for a while: the writer may have gone and another taken the name over
+        if (now - lastRecord > std::chrono::seconds(2))
+        {
+            TelemetryReader probe;
+            if (probe.Open(options.name) && probe.Session() != reader.Session())
+            {
+                reader.Open(options.name);
+                frames.clear();
+                oldest = 0;
+            }
+            lastRecord = now;
+        }
+        std::this_thread::sleep_for(poll);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    TailOptions options;
+    bool valid = true;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--json"))
+            options.json = true;
+        else if (!strcmp(arg, "--name") && hasValue)
+            options.name = argv[++i];
+        else if (!strcmp(arg, "--window") && hasValue)
+            options.window = (size_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--interval") && hasValue)
+            options.intervalMs = atoi(argv[++i]);
+        else if (!strcmp(arg, "--reports") && hasValue)
+            options.reports = atoi(argv[++i]);
+        else
+            valid = false;
+    }
+    if (!valid || options.window < 2 || options.intervalMs <= 0)
+    {
+        fprintf(stderr, "usage: %s [--name NAME] [--window FRAMES] [--interval MS] [--reports N] [--json]\n", argv[0]);
+        return 1;
+    }
+    return Tail(options);
+}
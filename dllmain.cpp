@@ -1,700 +1,1174 @@
-#include <Windows.h>
-#include "pch.h"
-#include <string>
-#include <chrono>
-#include <cmath>
-
-#pragma comment(lib, "user32.lib")
-
-// Globals
-HWND hwndOverlay = nullptr;
-bool running = true;
-
-bool menuOpen = false;
-
-bool crosshairEnabled = true;
-int crosshairSize = 15;
-int crosshairGap = 5;
-
-enum CrosshairShape { SHAPE_PLUS, SHAPE_CIRCLE, SHAPE_DOT, SHAPE_CROSS };
-CrosshairShape crosshairShape = SHAPE_PLUS;
-
-int colorR = 0, colorG = 160, colorB = 255;
-bool rainbowEnabled = false;
-
-bool watermarkEnabled = true;
-
-// --- NEW: Scope Overlay Options ---
-bool scopeOverlayEnabled = false;
-int scopeRadius = 100;
-int scopeOffsetX = 0;
-int scopeOffsetY = 0;
-
-// --- NEW: Kill Effect ---
-struct KillEffect
-{
-    bool active = false;
-    DWORD startTime = 0;
-    int duration = 1500; // milliseconds
-    int x = 0, y = 0; // position with offset
-
-    void Start(int posX, int posY)
-    {
-        active = true;
-        startTime = GetTickCount();
-        x = posX;
-        y = posY;
-    }
-
-    void Draw(HDC hdc)
-    {
-        if (!active) return;
-
-        DWORD now = GetTickCount();
-        DWORD elapsed = now - startTime;
-        if (elapsed > duration)
-        {
-            active = false;
-            return;
-        }
-
-        float progress = elapsed / (float)duration;
-        BYTE alpha = (BYTE)(255 * (1.0f - progress)); // fade out
-
-        SetBkMode(hdc, TRANSPARENT);
-
-        // Draw shadow
-        SetTextColor(hdc, RGB(0, 0, 0));
-        SetTextCharacterExtra(hdc, 2);
-        TextOutA(hdc, x + 2, y + 2, "KILL!", 5);
-
-        // Draw main text with alpha-like effect (GDI can't do real alpha text, so just solid)
-        COLORREF mainColor = RGB(255, 50, 50);
-        SetTextColor(hdc, mainColor);
-        TextOutA(hdc, x, y, "KILL!", 5);
-    }
-} killEffect;
-
-COLORREF blueMain = RGB(0, 160, 255);
-COLORREF blueDark = RGB(0, 90, 140);
-COLORREF whiteColor = RGB(255, 255, 255);
-COLORREF grayColor = RGB(128, 128, 128);
-
-SHORT lastInsertState = 0;
-SHORT lastUpState = 0;
-SHORT lastDownState = 0;
-SHORT lastLeftState = 0;
-SHORT lastRightState = 0;
-SHORT lastEnterState = 0;
-SHORT lastKState = 0;
-
-int menuSelection = 0; // menu item index
-const int MENU_ITEM_COUNT = 12;
-
-int width = 2560;
-int height = 1440;
-
-// FPS tracking
-DWORD lastTick = 0;
-int frameCount = 0;
-float currentFPS = 0.0f;
-
-// Drawing buffer
-HDC hMemDC = nullptr;
-HBITMAP hBitmap = nullptr;
-BYTE* pBits = nullptr;
-
-// Helpers
-
-COLORREF HSVtoRGB(float h, float s, float v)
-{
-    float r, g, b;
-    int i = (int)(h * 6);
-    float f = h * 6 - i;
-    float p = v * (1 - s);
-    float q = v * (1 - f * s);
-    float t = v * (1 - (1 - f) * s);
-    switch (i % 6)
-    {
-    case 0: r = v, g = t, b = p; break;
-    case 1: r = q, g = v, b = p; break;
-    case 2: r = p, g = v, b = t; break;
-    case 3: r = p, g = q, b = v; break;
-    case 4: r = t, g = p, b = v; break;
-    case 5: r = v, g = p, b = q; break;
-    }
-    return RGB((BYTE)(r * 255), (BYTE)(g * 255), (BYTE)(b * 255));
-}
-
-void DrawTextWithShadow(HDC hdc, int x, int y, const char* text, COLORREF color)
-{
-    SetBkMode(hdc, TRANSPARENT);
-    SetTextColor(hdc, RGB(0, 0, 0));
-    TextOutA(hdc, x + 1, y + 1, text, (int)strlen(text));
-    SetTextColor(hdc, color);
-    TextOutA(hdc, x, y, text, (int)strlen(text));
-}
-
-void DrawRoundedRect(HDC hdc, RECT rect, COLORREF color, int radius)
-{
-    HBRUSH brush = CreateSolidBrush(color);
-    RoundRect(hdc, rect.left, rect.top, rect.right, rect.bottom, radius, radius);
-    DeleteObject(brush);
-}
-
-void DrawCrosshair(HDC hdc, int cx, int cy, COLORREF color, int size, int gap, CrosshairShape shape)
-{
-    HPEN pen = CreatePen(PS_SOLID, 2, color);
-    HPEN oldPen = (HPEN)SelectObject(hdc, pen);
-
-    switch (shape)
-    {
-    case SHAPE_PLUS:
-        MoveToEx(hdc, cx - size, cy, nullptr);
-        LineTo(hdc, cx - gap, cy);
-        MoveToEx(hdc, cx + gap, cy, nullptr);
-        LineTo(hdc, cx + size, cy);
-        MoveToEx(hdc, cx, cy - size, nullptr);
-        LineTo(hdc, cx, cy - gap);
-        MoveToEx(hdc, cx, cy + gap, nullptr);
-        LineTo(hdc, cx, cy + size);
-        break;
-    case SHAPE_CIRCLE:
-        SelectObject(hdc, GetStockObject(NULL_BRUSH));
-        Ellipse(hdc, cx - size, cy - size, cx + size, cy + size);
-        break;
-    case SHAPE_DOT:
-    {
-        HBRUSH brush = CreateSolidBrush(color);
-        HBRUSH oldBrush = (HBRUSH)SelectObject(hdc, brush);
-        Ellipse(hdc, cx - size / 4, cy - size / 4, cx + size / 4, cy + size / 4);
-        SelectObject(hdc, oldBrush);
-        DeleteObject(brush);
-        break;
-    }
-    case SHAPE_CROSS:
-        MoveToEx(hdc, cx - size, cy - size, nullptr);
-        LineTo(hdc, cx - gap, cy - gap);
-        MoveToEx(hdc, cx + gap, cy + gap, nullptr);
-        LineTo(hdc, cx + size, cy + size);
-        MoveToEx(hdc, cx - size, cy + size, nullptr);
-        LineTo(hdc, cx - gap, cy + gap);
-        MoveToEx(hdc, cx + gap, cy - gap, nullptr);
-        LineTo(hdc, cx + size, cy - size);
-        break;
-    }
-
-    SelectObject(hdc, oldPen);
-    DeleteObject(pen);
-}
-
-// --- NEW: Draw Scope Overlay ---
-void DrawScopeOverlay(HDC hdc, int cx, int cy, int radius, int offsetX = 0, int offsetY = 0)
-{
-    cx += offsetX;
-    cy += offsetY;
-
-    // Draw dark vignette rings around scope (approximation)
-    int vignetteThickness = 50;
-    for (int i = 0; i < vignetteThickness; i += 10)
-    {
-        int alpha = 80 - i * 1; // decreasing alpha
-        if (alpha < 0) alpha = 0;
-        HBRUSH brush = CreateSolidBrush(RGB(0, 0, 0));
-        BLENDFUNCTION blend = { AC_SRC_OVER, 0, (BYTE)alpha, AC_SRC_ALPHA };
-
-        // GDI doesn't support alpha brush natively, so we fake by drawing transparent circle on DIB buffer directly
-        // Since we're drawing on a layered window with UpdateLayeredWindow with per-pixel alpha, this approximation is good enough
-
-        // Draw concentric circles with decreasing size and alpha (just dark circles)
-        SelectObject(hdc, brush);
-        SelectObject(hdc, GetStockObject(NULL_PEN));
-        Ellipse(hdc, cx - radius - i, cy - radius - i, cx + radius + i, cy + radius + i);
-        DeleteObject(brush);
-    }
-
-    // Draw white scope circle
-    HPEN pen = CreatePen(PS_SOLID, 3, RGB(255, 255, 255));
-    HPEN oldPen = (HPEN)SelectObject(hdc, pen);
-    SelectObject(hdc, GetStockObject(NULL_BRUSH));
-    Ellipse(hdc, cx - radius, cy - radius, cx + radius, cy + radius);
-    SelectObject(hdc, oldPen);
-    DeleteObject(pen);
-
-    // Draw cross lines inside scope
-    HPEN linePen = CreatePen(PS_SOLID, 1, RGB(255, 255, 255));
-    HPEN oldLinePen = (HPEN)SelectObject(hdc, linePen);
-
-    MoveToEx(hdc, cx, cy - radius, nullptr);
-    LineTo(hdc, cx, cy + radius);
-
-    MoveToEx(hdc, cx - radius, cy, nullptr);
-    LineTo(hdc, cx + radius, cy);
-
-    SelectObject(hdc, oldLinePen);
-    DeleteObject(linePen);
-}
-
-void DrawWatermark(HDC hdc)
-{
-    static DWORD start = 0;
-    if (!start) start = GetTickCount();
-    float t = (GetTickCount() - start) / 1000.0f;
-
-    // Pulsing alpha
-    BYTE alpha = (BYTE)(165 + 65 * sinf(t * 3));
-
-    int sway = (int)(5 * sinf(t * 2));
-
-    COLORREF color = RGB(0, 160, 255);
-
-    SetBkMode(hdc, TRANSPARENT);
-    SetTextColor(hdc, RGB(0, 0, 0));
-    TextOutA(hdc, 11 + sway, 11, "Astral", 6);
-    SetTextColor(hdc, color);
-    TextOutA(hdc, 10 + sway, 10, "Astral", 6);
-}
-
-void DrawInfoPanel(HDC hdc)
-{
-    RECT panelRect = { 10, 40, 280, 170 };
-    DrawRoundedRect(hdc, panelRect, RGB(0, 0, 0), 10);
-
-    char buf[64];
-    sprintf_s(buf, "FPS: %.1f", currentFPS);
-    DrawTextWithShadow(hdc, 20, 50, buf, whiteColor);
-
-    sprintf_s(buf, "Crosshair: %s", crosshairEnabled ? "ON" : "OFF");
-    DrawTextWithShadow(hdc, 20, 70, buf, crosshairEnabled ? blueMain : grayColor);
-
-    sprintf_s(buf, "Watermark: %s", watermarkEnabled ? "ON" : "OFF");
-    DrawTextWithShadow(hdc, 20, 90, buf, watermarkEnabled ? blueMain : grayColor);
-
-    sprintf_s(buf, "Scope Overlay: %s", scopeOverlayEnabled ? "ON" : "OFF");
-    DrawTextWithShadow(hdc, 20, 110, buf, scopeOverlayEnabled ? blueMain : grayColor);
-
-    sprintf_s(buf, "Scope Radius: %d", scopeRadius);
-    DrawTextWithShadow(hdc, 20, 130, buf, blueMain);
-
-    sprintf_s(buf, "Scope Offset X: %d", scopeOffsetX);
-    DrawTextWithShadow(hdc, 20, 150, buf, blueMain);
-
-    sprintf_s(buf, "Scope Offset Y: %d", scopeOffsetY);
-    DrawTextWithShadow(hdc, 20, 170, buf, blueMain);
-}
-
-void ProcessInput()
-{
-    SHORT insertState = GetAsyncKeyState(VK_INSERT);
-    SHORT upState = GetAsyncKeyState(VK_UP);
-    SHORT downState = GetAsyncKeyState(VK_DOWN);
-    SHORT leftState = GetAsyncKeyState(VK_LEFT);
-    SHORT rightState = GetAsyncKeyState(VK_RIGHT);
-    SHORT enterState = GetAsyncKeyState(VK_RETURN);
-    SHORT kState = GetAsyncKeyState('K');
-
-    if ((insertState & 0x8000) && !(lastInsertState & 0x8000))
-    {
-        menuOpen = !menuOpen;
-        Sleep(150);
-    }
-
-    // Trigger kill effect demo when pressing K (only on key down)
-    if ((kState & 0x8000) && !(lastKState & 0x8000))
-    {
-        int cx = width / 2;
-        int cy = height / 2;
-        killEffect.Start(cx + 50, cy - 50); // Demo position offset
-    }
-    lastKState = kState;
-
-    if (!menuOpen) {
-        lastInsertState = insertState;
-        lastUpState = upState;
-        lastDownState = downState;
-        lastLeftState = leftState;
-        lastRightState = rightState;
-        lastEnterState = enterState;
-        return;
-    }
-
-    if ((upState & 0x8000) && !(lastUpState & 0x8000))
-    {
-        menuSelection--;
-        if (menuSelection < 0) menuSelection = MENU_ITEM_COUNT - 1;
-        Sleep(120);
-    }
-
-    if ((downState & 0x8000) && !(lastDownState & 0x8000))
-    {
-        menuSelection++;
-        if (menuSelection >= MENU_ITEM_COUNT) menuSelection = 0;
-        Sleep(120);
-    }
-
-    switch (menuSelection)
-    {
-    case 0:
-        if ((enterState & 0x8000) && !(lastEnterState & 0x8000))
-        {
-            crosshairEnabled = !crosshairEnabled;
-            Sleep(150);
-        }
-        break;
-
-    case 1:
-        if ((leftState & 0x8000) && !(lastLeftState & 0x8000) && crosshairSize > 1)
-        {
-            crosshairSize--;
-            Sleep(80);
-        }
-        if ((rightState & 0x8000) && !(lastRightState & 0x8000) && crosshairSize < 50)
-        {
-            crosshairSize++;
-            Sleep(80);
-        }
-        break;
-
-    case 2:
-        if ((leftState & 0x8000) && !(lastLeftState & 0x8000) && crosshairGap > 0)
-        {
-            crosshairGap--;
-            Sleep(80);
-        }
-        if ((rightState & 0x8000) && !(lastRightState & 0x8000) && crosshairGap < 20)
-        {
-            crosshairGap++;
-            Sleep(80);
-        }
-        break;
-
-    case 3:
-        if ((leftState & 0x8000) && !(lastLeftState & 0x8000))
-        {
-            crosshairShape = (CrosshairShape)(((int)crosshairShape + 3) % 4);
-            Sleep(80);
-        }
-        if ((rightState & 0x8000) && !(lastRightState & 0x8000))
-        {
-            crosshairShape = (CrosshairShape)(((int)crosshairShape + 1) % 4);
-            Sleep(80);
-        }
-        break;
-
-    case 4:
-        if ((leftState & 0x8000) && !(lastLeftState & 0x8000) && colorR > 0)
-        {
-            colorR--;
-            Sleep(60);
-        }
-        if ((rightState & 0x8000) && !(lastRightState & 0x8000) && colorR < 255)
-        {
-            colorR++;
-            Sleep(60);
-        }
-        break;
-
-    case 5:
-        if ((leftState & 0x8000) && !(lastLeftState & 0x8000) && colorG > 0)
-        {
-            colorG--;
-            Sleep(60);
-        }
-        if ((rightState & 0x8000) && !(lastRightState & 0x8000) && colorG < 255)
-        {
-            colorG++;
-            Sleep(60);
-        }
-        break;
-
-    case 6:
-        if ((leftState & 0x8000) && !(lastLeftState & 0x8000) && colorB > 0)
-        {
-            colorB--;
-            Sleep(60);
-        }
-        if ((rightState & 0x8000) && !(lastRightState & 0x8000) && colorB < 255)
-        {
-            colorB++;
-            Sleep(60);
-        }
-        break;
-
-    case 7:
-        if ((enterState & 0x8000) && !(lastEnterState & 0x8000))
-        {
-            rainbowEnabled = !rainbowEnabled;
-            Sleep(150);
-        }
-        break;
-
-    case 8:
-        if ((enterState & 0x8000) && !(lastEnterState & 0x8000))
-        {
-            watermarkEnabled = !watermarkEnabled;
-            Sleep(150);
-        }
-        break;
-
-    case 9:
-        if ((enterState & 0x8000) && !(lastEnterState & 0x8000))
-        {
-            scopeOverlayEnabled = !scopeOverlayEnabled;
-            Sleep(150);
-        }
-        break;
-
-    case 10:
-        if ((leftState & 0x8000) && !(lastLeftState & 0x8000) && scopeRadius > 10)
-        {
-            scopeRadius -= 5;
-            Sleep(80);
-        }
-        if ((rightState & 0x8000) && !(lastRightState & 0x8000) && scopeRadius < 300)
-        {
-            scopeRadius += 5;
-            Sleep(80);
-        }
-        break;
-
-    case 11:
-        if ((leftState & 0x8000) && !(lastLeftState & 0x8000))
-        {
-            scopeOffsetX -= 5;
-            Sleep(80);
-        }
-        if ((rightState & 0x8000) && !(lastRightState & 0x8000))
-        {
-            scopeOffsetX += 5;
-            Sleep(80);
-        }
-        break;
-
-    case 12:
-        if ((leftState & 0x8000) && !(lastLeftState & 0x8000))
-        {
-            scopeOffsetY -= 5;
-            Sleep(80);
-        }
-        if ((rightState & 0x8000) && !(lastRightState & 0x8000))
-        {
-            scopeOffsetY += 5;
-            Sleep(80);
-        }
-        break;
-    }
-
-    lastInsertState = insertState;
-    lastUpState = upState;
-    lastDownState = downState;
-    lastLeftState = leftState;
-    lastRightState = rightState;
-    lastEnterState = enterState;
-}
-
-void DrawMenu(HDC hdc)
-{
-    RECT menuRect = { 50, 50, 400, 450 };
-    DrawRoundedRect(hdc, menuRect, blueDark, 15);
-
-    const char* crosshairShapeNames[] = { "Plus", "Circle", "Dot", "Cross" };
-    char buf[64];
-
-    SetBkMode(hdc, TRANSPARENT);
-    DrawTextWithShadow(hdc, 60, 60, "Cheat Menu (Use Arrow Keys + Enter)", whiteColor);
-
-    for (int i = 0; i < MENU_ITEM_COUNT; i++)
-    {
-        COLORREF color = (i == menuSelection) ? blueMain : whiteColor;
-        switch (i)
-        {
-        case 0:
-            sprintf_s(buf, "Crosshair: %s", crosshairEnabled ? "ON" : "OFF");
-            break;
-        case 1:
-            sprintf_s(buf, "Crosshair Size: %d", crosshairSize);
-            break;
-        case 2:
-            sprintf_s(buf, "Crosshair Gap: %d", crosshairGap);
-            break;
-        case 3:
-            sprintf_s(buf, "Crosshair Shape: %s", crosshairShapeNames[(int)crosshairShape]);
-            break;
-        case 4:
-            sprintf_s(buf, "Color R: %d", colorR);
-            break;
-        case 5:
-            sprintf_s(buf, "Color G: %d", colorG);
-            break;
-        case 6:
-            sprintf_s(buf, "Color B: %d", colorB);
-            break;
-        case 7:
-            sprintf_s(buf, "Rainbow: %s", rainbowEnabled ? "ON" : "OFF");
-            break;
-        case 8:
-            sprintf_s(buf, "Watermark: %s", watermarkEnabled ? "ON" : "OFF");
-            break;
-        case 9:
-            sprintf_s(buf, "Scope Overlay: %s", scopeOverlayEnabled ? "ON" : "OFF");
-            break;
-        case 10:
-            sprintf_s(buf, "Scope Radius: %d", scopeRadius);
-            break;
-        case 11:
-            sprintf_s(buf, "Scope Offset X: %d", scopeOffsetX);
-            break;
-        case 12:
-            sprintf_s(buf, "Scope Offset Y: %d", scopeOffsetY);
-            break;
-        }
-        DrawTextWithShadow(hdc, 70, 90 + i * 25, buf, color);
-    }
-}
-
-// Window procedure to do nothing (we don't use WM_PAINT anymore)
-LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
-{
-    if (msg == WM_DESTROY)
-    {
-        running = false;
-        PostQuitMessage(0);
-        return 0;
-    }
-    return DefWindowProc(hwnd, msg, wParam, lParam);
-}
-
-DWORD WINAPI OverlayThread(LPVOID)
-{
-    WNDCLASS wc = { 0 };
-    wc.lpfnWndProc = WndProc;
-    wc.hInstance = GetModuleHandle(nullptr);
-    wc.lpszClassName = L"AstralOverlayClass";
-    wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
-    RegisterClass(&wc);
-
-    hwndOverlay = CreateWindowEx(
-        WS_EX_LAYERED | WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_TRANSPARENT,
-        wc.lpszClassName,
-        L"AstralOverlay",
-        WS_POPUP,
-        0, 0, width, height,
-        nullptr, nullptr,
-        wc.hInstance,
-        nullptr);
-
-    if (!hwndOverlay)
-        return 1;
-
-    // Initialize memory DC and bitmap
-    HDC hdcScreen = GetDC(nullptr);
-    hMemDC = CreateCompatibleDC(hdcScreen);
-    ReleaseDC(nullptr, hdcScreen);
-
-    BITMAPINFO bmi = { 0 };
-    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bmi.bmiHeader.biWidth = width;
-    bmi.bmiHeader.biHeight = -height; // top-down
-    bmi.bmiHeader.biPlanes = 1;
-    bmi.bmiHeader.biBitCount = 32;
-    bmi.bmiHeader.biCompression = BI_RGB;
-
-    hBitmap = CreateDIBSection(hMemDC, &bmi, DIB_RGB_COLORS, (void**)&pBits, nullptr, 0);
-    SelectObject(hMemDC, hBitmap);
-
-    SetWindowPos(hwndOverlay, HWND_TOPMOST, 0, 0, width, height, SWP_SHOWWINDOW);
-
-    lastTick = GetTickCount();
-
-    while (running)
-    {
-        // Clear to transparent
-        ZeroMemory(pBits, width * height * 4);
-
-        RECT rc = { 0, 0, width, height };
-        int cx = width / 2;
-        int cy = height / 2;
-
-        // Calculate FPS
-        DWORD now = GetTickCount();
-        frameCount++;
-        if (now - lastTick >= 1000)
-        {
-            currentFPS = frameCount * 1000.0f / (now - lastTick);
-            lastTick = now;
-            frameCount = 0;
-        }
-
-        // Crosshair color
-        COLORREF drawColor;
-        if (rainbowEnabled)
-        {
-            static DWORD startTime = GetTickCount();
-            float seconds = (GetTickCount() - startTime) / 1000.0f;
-            float hue = fmodf(seconds * 0.3f, 1.0f);
-            drawColor = HSVtoRGB(hue, 1.0f, 1.0f);
-        }
-        else
-        {
-            drawColor = RGB(colorR, colorG, colorB);
-        }
-
-        // Draw scope overlay if enabled
-        if (scopeOverlayEnabled)
-            DrawScopeOverlay(hMemDC, cx, cy, scopeRadius, scopeOffsetX, scopeOffsetY);
-
-        if (crosshairEnabled)
-            DrawCrosshair(hMemDC, cx, cy, drawColor, crosshairSize, crosshairGap, crosshairShape);
-
-        if (watermarkEnabled)
-            DrawWatermark(hMemDC);
-
-        DrawInfoPanel(hMemDC);
-
-        if (menuOpen)
-            DrawMenu(hMemDC);
-
-        // Draw kill effect text
-        killEffect.Draw(hMemDC);
-
-        POINT ptWinPos = { 0, 0 };
-        SIZE sizeWin = { width, height };
-        POINT ptSrc = { 0, 0 };
-
-        BLENDFUNCTION blend = { 0 };
-        blend.BlendOp = AC_SRC_OVER;
-        blend.BlendFlags = 0;
-        blend.SourceConstantAlpha = 255;
-        blend.AlphaFormat = AC_SRC_ALPHA;
-
-        UpdateLayeredWindow(hwndOverlay, nullptr, &ptWinPos, &sizeWin, hMemDC, &ptSrc, 0, &blend, ULW_ALPHA);
-
-        // Input and message processing
-        MSG msg;
-        while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
-        {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
-        }
-
-        ProcessInput();
-
-        Sleep(10);
-    }
-
-    DeleteObject(hBitmap);
-    DeleteDC(hMemDC);
-    DestroyWindow(hwndOverlay);
-
-    return 0;
-}
-
-BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID)
-{
-    if (reason == DLL_PROCESS_ATTACH)
-    {
-        DisableThreadLibraryCalls(hModule);
-        CreateThread(nullptr, 0, OverlayThread, nullptr, 0, nullptr);
-    }
-    return TRUE;
-}
+#include <Windows.h>
+#include <dwmapi.h>
+#include "pch.h"
+#include <string>
+#include <chrono>
+#include <cmath>
+#include "DirtyRegion.h"
+#include "Raster.h"
+#include "SpriteCache.h"
+#include "FrameScheduler.h"
+#include "SpscRing.h"
+#include "KeyInput.h"
+#include "FrameProfiler.h"
+#include "FrameMailbox.h"
+#include "Snapshot.h"
+#include "CpuGovernor.h"
+#include "Compositor.h"
+#include "PresentFilter.h"
+#include "Overlay.h"
+#include "Profiles.h"
+#include "Telemetry.h"
+#include "Platform.h"
+#include "FramePacer.h"
+
+#pragma comment(lib, "user32.lib")
+#pragma comment(lib, "dwmapi.lib")
+
+// Build options: the overlay's CPU budget as a share of one core (0 turns the
+// governor off), the cores its render and present threads may run on (0
+// leaves them wherever Windows puts them), their scheduling priority, and how
+// many threads draw large repaints through the tile compositor (0 draws every
+// repaint directly on the render thread), whether each frame is published
+// to shared memory for bench/TelemetryTail.cpp, and how frames are paced
+// (FramePacer.h; F8 switches at run time)
+#ifndef ASTRAL_CPU_BUDGET
+#define ASTRAL_CPU_BUDGET 0.005
+#endif
+#ifndef ASTRAL_THREAD_AFFINITY
+#define ASTRAL_THREAD_AFFINITY 0
+#endif
+#ifndef ASTRAL_THREAD_PRIORITY
+#define ASTRAL_THREAD_PRIORITY THREAD_PRIORITY_NORMAL
+#endif
+#ifndef ASTRAL_RENDER_THREADS
+#define ASTRAL_RENDER_THREADS 0
+#endif
+#ifndef ASTRAL_TELEMETRY
+#define ASTRAL_TELEMETRY 1
+#endif
+#ifndef ASTRAL_PACING
+#define ASTRAL_PACING PACING_COMPOSITOR
+#endif
+
+// Globals
+bool running = true;
+
+// Input: the keyboard hook thread queues timestamped key events for the overlay thread
+SpscRing<KeyEvent, 256> keyQueue;
+HANDLE keyEventSignal = nullptr;
+HHOOK keyboardHook = nullptr;
+DWORD inputThreadId = 0;
+
+// Primary monitor in virtual-screen coordinates; widgets are laid out relative to its top-left
+IntRect monitorRect;
+
+SteadyClock overlayClock;
+
+// The GDI, USER and kernel calls the overlay makes every frame, behind the
+// shim in Platform.h so each one is counted and every object it creates is
+// tracked until it is destroyed
+class Win32Backend : public PlatformBackend
+{
+public:
+    PlatformHandle CreateBitmap(int width, int height, Pixel** bits) override
+    {
+        BITMAPINFO bmi = { 0 };
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = width;
+        bmi.bmiHeader.biHeight = -height; // top-down
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+        return CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, (void**)bits, nullptr, 0);
+    }
+
+    void DeleteBitmap(PlatformHandle bitmap) override { DeleteObject((HBITMAP)bitmap); }
+
+    PlatformHandle CreateContext() override { return CreateCompatibleDC(nullptr); }
+    void DeleteContext(PlatformHandle dc) override { DeleteDC((HDC)dc); }
+    PlatformHandle Select(PlatformHandle dc, PlatformHandle object) override { return SelectObject((HDC)dc, (HGDIOBJ)object); }
+    void Text(PlatformHandle dc, int x, int y, const char* text, int length) override { TextOutA((HDC)dc, x, y, text, length); }
+
+    void Present(PlatformHandle window, PlatformHandle dc, int x, int y, int width, int height, const IntRect& dirty) override
+    {
+        POINT position = { x, y };
+        SIZE sizeWin = { width, height };
+        POINT ptSrc = { 0, 0 };
+
+        BLENDFUNCTION blend = { 0 };
+        blend.BlendOp = AC_SRC_OVER;
+        blend.BlendFlags = 0;
+        blend.SourceConstantAlpha = 255;
+        blend.AlphaFormat = AC_SRC_ALPHA;
+
+        // Tell the compositor which part of the window actually changed
+        RECT dirtyRect = { dirty.left, dirty.top, dirty.right, dirty.bottom };
+
+        UPDATELAYEREDWINDOWINFO info = { 0 };
+        info.cbSize = sizeof(info);
+        info.hdcSrc = (HDC)dc;
+        info.pptDst = &position;
+        info.psize = &sizeWin;
+        info.pptSrc = &ptSrc;
+        info.pblend = &blend;
+        info.dwFlags = ULW_ALPHA;
+        info.prcDirty = &dirtyRect;
+        UpdateLayeredWindowIndirect((HWND)window, &info);
+    }
+
+    void ShowWindow(PlatformHandle window, bool show) override { ShowWindowAsync((HWND)window, show ? SW_SHOWNOACTIVATE : SW_HIDE); }
+
+    PlatformHandle CreateSignal() override { return CreateEvent(nullptr, FALSE, FALSE, nullptr); }
+    void Signal(PlatformHandle signal) override { SetEvent(signal); }
+    void CloseSignal(PlatformHandle signal) override { CloseHandle(signal); }
+
+    // High-resolution timer where available (Windows 10 1803+), plain waitable timer otherwise
+    PlatformHandle CreateTimer() override
+    {
+        HANDLE timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        return timer ? timer : CreateWaitableTimer(nullptr, FALSE, nullptr);
+    }
+
+    void ArmTimer(PlatformHandle timer, int64_t dueNs) override
+    {
+        // Negative due time is relative, in 100ns units
+        LARGE_INTEGER due;
+        due.QuadPart = -(LONGLONG)(dueNs / 100);
+        SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE);
+    }
+
+    void CancelTimer(PlatformHandle timer) override { CancelWaitableTimer(timer); }
+    void CloseTimer(PlatformHandle timer) override { CloseHandle(timer); }
+
+    void Wait(const PlatformHandle* handles, int count, bool messages) override
+    {
+        if (messages)
+            MsgWaitForMultipleObjects((DWORD)count, (const HANDLE*)handles, FALSE, INFINITE, QS_ALLINPUT);
+        else
+            WaitForMultipleObjects((DWORD)count, (const HANDLE*)handles, FALSE, INFINITE);
+    }
+
+    // DWM reports its refreshes in performance counter ticks; fails with composition off (Windows 7 basic)
+    bool RefreshTiming(int64_t* sinceVblankNs, int64_t* periodNs) override
+    {
+        DWM_TIMING_INFO info = { 0 };
+        info.cbSize = sizeof(info);
+        if (FAILED(DwmGetCompositionTimingInfo(nullptr, &info)) || !info.qpcRefreshPeriod)
+            return false;
+
+        LARGE_INTEGER now, frequency;
+        QueryPerformanceCounter(&now);
+        QueryPerformanceFrequency(&frequency);
+        *sinceVblankNs = (now.QuadPart - (LONGLONG)info.qpcVBlank) * NS_PER_SEC / frequency.QuadPart;
+        *periodNs = (int64_t)info.qpcRefreshPeriod * NS_PER_SEC / frequency.QuadPart;
+        return true;
+    }
+};
+
+Win32Backend win32Backend;
+ResourceTracker resources;
+TrackedPlatform platform(win32Backend, resources, overlayClock);
+const char* const LEAK_REPORT_PATH = "astral_leaks.txt"; // written at shutdown if anything leaked
+
+// The compositor's refreshes, read through the platform and put in the overlay clock's time
+class CompositorRefresh : public RefreshSource
+{
+public:
+    bool Sample(RefreshTiming& timing) override
+    {
+        int64_t sinceVblankNs = 0;
+        if (!platform.RefreshTiming(&sinceVblankNs, &timing.periodNs))
+            return false;
+        timing.vblankNs = overlayClock.NowNs() - sinceVblankNs;
+        return true;
+    }
+};
+
+// Starts frames just before the refresh that will show them, and measures
+// key down to that refresh. F8 switches between the pacing modes.
+CompositorRefresh compositorRefresh;
+FramePacer pacer(overlayClock, compositorRefresh);
+PacedFrame pacedFrame;         // the frame being drawn, overlay thread
+bool pacingKeyDown = false;
+bool inputKeyDown[256] = {};   // keys down as of the last event read, for counting presses only
+
+// Glyphs for the text atlas: each character is drawn white on black with
+// TextOutA and read back, so any GDI font works, the stock raster fonts included
+class GdiGlyphSource : public GlyphSource
+{
+public:
+    GdiGlyphSource()
+    {
+        dc = (HDC)platform.CreateContext();
+        GetTextMetricsA(dc, &metrics);
+        cellWidth = metrics.tmMaxCharWidth + metrics.tmOverhang;
+
+        bitmap = platform.CreateBitmap(cellWidth, metrics.tmHeight, (Pixel**)&bits);
+        platform.Select(dc, bitmap);
+
+        SetBkMode(dc, TRANSPARENT);
+        SetTextColor(dc, RGB(255, 255, 255));
+    }
+
+    ~GdiGlyphSource()
+    {
+        platform.DeleteContext(dc);
+        platform.DeleteBitmap(bitmap);
+    }
+
+    int LineHeight() override { return metrics.tmHeight; }
+
+    bool Rasterize(char c, GlyphBitmap& glyph) override
+    {
+        if (!bits) return false;
+
+        int pixelCount = cellWidth * metrics.tmHeight;
+        memset(bits, 0, pixelCount * 4);
+        platform.Text(dc, 0, 0, &c, 1);
+        GdiFlush();
+
+        SIZE extent = { 0 };
+        GetTextExtentPoint32A(dc, &c, 1, &extent);
+        glyph.advance = extent.cx;
+        glyph.left = 0;
+        glyph.top = 0;
+        glyph.width = cellWidth;
+        glyph.height = metrics.tmHeight;
+
+        // Brightest channel as coverage, in case the font is ClearType filtered
+        glyph.coverage.resize(pixelCount);
+        for (int i = 0; i < pixelCount; i++)
+        {
+            BYTE r = GetRValue(bits[i]), g = GetGValue(bits[i]), b = GetBValue(bits[i]);
+            BYTE brightest = r > g ? r : g;
+            glyph.coverage[i] = brightest > b ? brightest : b;
+        }
+        return true;
+    }
+
+private:
+    HDC dc = nullptr;
+    PlatformHandle bitmap = nullptr;
+    DWORD* bits = nullptr;
+    TEXTMETRICA metrics = { 0 };
+    int cellWidth = 0;
+};
+
+// Overlay text: the atlas is built from GDI once at startup
+AtlasTextRenderer overlayText;
+
+// Settings, effects, scheduling, the CPU governor and the profiler: everything
+// but the windows, which the overlay lays out and this file puts on screen
+Overlay overlay(overlayClock, overlayText, ASTRAL_CPU_BUDGET);
+
+// F11 records the session to a trace for bench/OverlayReplay.cpp
+TraceWriter sessionTrace;
+bool traceKeyDown = false;
+bool traceToggleRequested = false;
+
+// Settings profiles: Page Up and Page Down switch, Home saves the settings
+// into the active one. The file is reloaded whenever it changes on disk.
+const char* const PROFILE_PATH = "astral_profiles.bin";
+ProfileStore profiles;
+HANDLE profileWatch = INVALID_HANDLE_VALUE; // signalled when a file in the game directory changes
+bool profileKeyDown[2] = {};
+bool profileSaveKeyDown = false;
+bool profileSaveRequested = false;
+
+// One frame of one window, as handed from the overlay thread to the present thread
+struct WindowFrame
+{
+    HBITMAP bitmap = nullptr;
+    Pixel* bits = nullptr;
+    Surface surface;
+    POINT position = { 0, 0 };  // on the virtual screen
+    IntRect dirty;              // what changed since the last presented frame
+    bool visible = false;
+    int64_t submitNs = 0;
+    PacedFrame paced;
+};
+
+struct OverlayWindow
+{
+    HWND hwnd = nullptr;
+
+    // Overlay thread
+    IntRect rect;           // in monitor coordinates, empty while hidden
+    bool visible = false;   // as of the last submitted frame
+    bool moved = false;     // position changed since the last submitted frame
+    DirtyRegionTracker tracker;
+    PresentFilter presentFilter; // row hashes of the last submitted frame
+    IntRect stale[FrameMailbox<WindowFrame>::BUFFER_COUNT]; // what each buffer missed while the others were drawn
+    IntRect lastDirty;      // carried into the next frame if this one is dropped
+
+    // Present thread
+    bool shown = false;
+
+    FrameMailbox<WindowFrame> frames;
+};
+
+OverlayWindow overlayWindows[WINDOW_COUNT];
+
+// Present thread: hands finished frames to UpdateLayeredWindowIndirect so a
+// slow compositor call never holds up rendering or input
+HANDLE presentThread = nullptr;
+HANDLE presentSignal = nullptr;
+std::atomic<bool> presenting{ true };
+LatencyHistogram presentLatency; // submit to presented, written by the present thread only
+PresentStats presentStats;       // overlay thread
+uint64_t clearedBytes = 0;       // damage cleared, overlay thread
+
+// Frames submitted but not yet presented, over all windows
+int PresentQueueDepth()
+{
+    int depth = 0;
+    for (int i = 0; i < WINDOW_COUNT; i++)
+        depth += overlayWindows[i].frames.Pending();
+    return depth;
+}
+
+// Frames replaced in a mailbox before the present thread got to them
+uint64_t DroppedFrames()
+{
+    uint64_t dropped = 0;
+    for (int i = 0; i < WINDOW_COUNT; i++)
+        dropped += overlayWindows[i].frames.Dropped();
+    return dropped;
+}
+
+// Repaints of at least this many pixels are recorded and drawn tile by tile on
+// ASTRAL_RENDER_THREADS threads; below it waking the helpers costs more than it saves
+const long long COMPOSE_MIN_PIXELS = 256 * 256;
+TileCompositor* compositor = nullptr; // null when ASTRAL_RENDER_THREADS is 0
+
+// Scratch for one loop iteration, taken back at the top of the next
+FrameArena frameArena;
+DrawList frameCommands(&frameArena);
+uint64_t heapAllocationsSeen = 0; // by the arena and the sprite allocator, up to the last iteration
+uint64_t frameHeapAllocations = 0; // in the last iteration; 0 once every widget has been drawn
+
+// Every drawn frame goes to shared memory for a viewer outside the game
+TelemetryWriter telemetry;
+PresentStats telemetryPresentStats; // as of the last record published
+uint64_t telemetryClearedBytes = 0;
+
+// Profiler readout below the info panel: p50/p99 per stage in microseconds,
+// then the present pipeline: submit-to-present latency, queued and dropped
+// frames, frames presented and skipped as unchanged, and bytes hashed to tell;
+// then memory: sprite bytes in use and at most, how often the sprite pools
+// had a block ready, the frame arena, and heap allocations in the last frame
+// and in all; then the platform calls of the last frame and the time they
+// took, and the objects alive, made and destroyed in it (Platform.h); last,
+// the pacing mode, its margin and frames that missed their refresh, and in
+// milliseconds key down to the refresh that showed it and frame start to
+// that refresh (FramePacer.h)
+const int PROFILER_X = 10, PROFILER_Y = 220;
+const int PROFILER_ROWS = STAGE_COUNT + 14;
+
+IntRect ProfilerReadoutBounds(int x, int y)
+{
+    return MakeRect(x, y, x + 271, y + 30 + PROFILER_ROWS * 18);
+}
+
+struct ProfilerReadoutText
+{
+    TextLine title;
+    TextLine names[STAGE_COUNT];
+    TextLine values[STAGE_COUNT];
+    TextLine presentName, presentValue;
+    TextLine queueName, queueValue;
+    TextLine skipName, skipValue;
+    TextLine hashedName, hashedValue;
+    TextLine spritesName, spritesValue;
+    TextLine poolName, poolValue;
+    TextLine arenaName, arenaValue;
+    TextLine heapName, heapValue;
+    TextLine callsName, callsValue;
+    TextLine objectsName, objectsValue;
+    TextLine pacingName, pacingValue;
+    TextLine marginName, marginValue;
+    TextLine inputName, inputValue;
+    TextLine lagName, lagValue;
+} profilerText;
+
+void DrawProfilerReadout(Surface& surface, TextRenderer& text, int x, int y)
+{
+    IntRect bounds = ProfilerReadoutBounds(x, y);
+    DrawPanel(surface, MakeRect(bounds.left, bounds.top, bounds.right - 1, bounds.bottom - 1), PremultipliedColor(0, 0, 0), 10);
+
+    profilerText.title.Set("Stage         p50 / p99 us");
+    text.DrawLine(surface, x + 10, y + 8, profilerText.title, whiteColor);
+
+    for (int i = 0; i < overlay.Profiler().StageCount(); i++)
+    {
+        const LatencyHistogram& h = overlay.Profiler().Histogram(i);
+        profilerText.names[i].Set(overlay.Profiler().StageName(i));
+        profilerText.values[i].Format("%.1f / %.1f", h.Percentile(50) / 1000.0, h.Percentile(99) / 1000.0);
+        int rowY = y + 28 + i * 18;
+        text.DrawLine(surface, x + 10, rowY, profilerText.names[i], i == STAGE_FRAME ? whiteColor : grayColor);
+        text.DrawLine(surface, x + 120, rowY, profilerText.values[i], blueMain);
+    }
+
+    int rowY = y + 28 + STAGE_COUNT * 18;
+    profilerText.presentName.Set("present");
+    profilerText.presentValue.Format("%.1f / %.1f", presentLatency.Percentile(50) / 1000.0, presentLatency.Percentile(99) / 1000.0);
+    text.DrawLine(surface, x + 10, rowY, profilerText.presentName, whiteColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.presentValue, blueMain);
+
+    rowY += 18;
+    profilerText.queueName.Set("queued/drop");
+    profilerText.queueValue.Format("%d / %llu", PresentQueueDepth(), (unsigned long long)DroppedFrames());
+    text.DrawLine(surface, x + 10, rowY, profilerText.queueName, grayColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.queueValue, blueMain);
+
+    rowY += 18;
+    profilerText.skipName.Set("shown/skip");
+    profilerText.skipValue.Format("%llu / %llu", (unsigned long long)presentStats.presented, (unsigned long long)presentStats.skipped);
+    text.DrawLine(surface, x + 10, rowY, profilerText.skipName, grayColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.skipValue, blueMain);
+
+    rowY += 18;
+    profilerText.hashedName.Set("hashed");
+    profilerText.hashedValue.Format("%.1f MB", presentStats.hashedBytes / (1024.0 * 1024.0));
+    text.DrawLine(surface, x + 10, rowY, profilerText.hashedName, grayColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.hashedValue, blueMain);
+
+    const MemoryStats& sprites = overlay.Sprites().MemoryUse();
+    rowY += 18;
+    profilerText.spritesName.Set("sprites");
+    profilerText.spritesValue.Format("%zu / %zu KB", sprites.bytesInUse / 1024, sprites.peakBytes / 1024);
+    text.DrawLine(surface, x + 10, rowY, profilerText.spritesName, whiteColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.spritesValue, blueMain);
+
+    rowY += 18;
+    profilerText.poolName.Set("pool hits");
+    profilerText.poolValue.Format("%.1f%%", sprites.PoolHitRate() * 100.0);
+    text.DrawLine(surface, x + 10, rowY, profilerText.poolName, grayColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.poolValue, blueMain);
+
+    MemoryStats arena = frameArena.Stats();
+    rowY += 18;
+    profilerText.arenaName.Set("frame arena");
+    profilerText.arenaValue.Format("%.1f / %zu KB", arena.peakBytes / 1024.0, arena.pooledBytes / 1024);
+    text.DrawLine(surface, x + 10, rowY, profilerText.arenaName, grayColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.arenaValue, blueMain);
+
+    rowY += 18;
+    profilerText.heapName.Set("heap allocs");
+    profilerText.heapValue.Format("%llu / %llu", (unsigned long long)frameHeapAllocations, (unsigned long long)heapAllocationsSeen);
+    text.DrawLine(surface, x + 10, rowY, profilerText.heapName, grayColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.heapValue, frameHeapAllocations ? redColor : blueMain);
+
+    const PlatformFrameReport& calls = resources.LastFrame();
+    rowY += 18;
+    profilerText.callsName.Set("os calls");
+    profilerText.callsValue.Format("%u, %.1f us", calls.TotalCalls(), calls.TotalNs() / 1000.0);
+    text.DrawLine(surface, x + 10, rowY, profilerText.callsName, whiteColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.callsValue, blueMain);
+
+    uint32_t created = 0, destroyed = 0;
+    for (int i = 0; i < OBJECT_COUNT; i++)
+    {
+        created += calls.created[i];
+        destroyed += calls.destroyed[i];
+    }
+    rowY += 18;
+    profilerText.objectsName.Set("os objects");
+    profilerText.objectsValue.Format("%d, +%u -%u", calls.live, created, destroyed);
+    text.DrawLine(surface, x + 10, rowY, profilerText.objectsName, grayColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.objectsValue, blueMain);
+
+    PacingMode mode = pacer.Mode();
+    rowY += 18;
+    profilerText.pacingName.Set("pacing");
+    if (mode == PACING_COMPOSITOR && !pacer.RefreshPeriodNs())
+        profilerText.pacingValue.Set("no compositor");
+    else
+        profilerText.pacingValue.Set(PACING_MODE_NAMES[mode]);
+    text.DrawLine(surface, x + 10, rowY, profilerText.pacingName, whiteColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.pacingValue, blueMain);
+
+    rowY += 18;
+    profilerText.marginName.Set("margin/late");
+    profilerText.marginValue.Format("%.1f / %llu", pacer.MarginNs() / 1e6, (unsigned long long)pacer.Missed(mode));
+    text.DrawLine(surface, x + 10, rowY, profilerText.marginName, grayColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.marginValue, blueMain);
+
+    const LatencyHistogram& input = pacer.InputLatency(mode);
+    rowY += 18;
+    profilerText.inputName.Set("key to shown");
+    profilerText.inputValue.Format("%.1f / %.1f", input.Percentile(50) / 1e6, input.Percentile(99) / 1e6);
+    text.DrawLine(surface, x + 10, rowY, profilerText.inputName, grayColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.inputValue, blueMain);
+
+    const LatencyHistogram& lag = pacer.FrameLag(mode);
+    rowY += 18;
+    profilerText.lagName.Set("frame lag");
+    profilerText.lagValue.Format("%.1f / %.1f", lag.Percentile(50) / 1e6, lag.Percentile(99) / 1e6);
+    text.DrawLine(surface, x + 10, rowY, profilerText.lagName, grayColor);
+    text.DrawLine(surface, x + 120, rowY, profilerText.lagValue, blueMain);
+}
+
+// Keys the overlay reacts to; everything else goes straight through the hook
+bool IsOverlayKey(DWORD vk)
+{
+    switch (vk)
+    {
+    case VK_INSERT:
+    case VK_UP:
+    case VK_DOWN:
+    case VK_LEFT:
+    case VK_RIGHT:
+    case VK_RETURN:
+    case 'K':
+    case VK_F8:
+    case VK_F9:
+    case VK_F10:
+    case VK_F11:
+    case VK_PRIOR:
+    case VK_NEXT:
+    case VK_HOME:
+        return true;
+    }
+    return false;
+}
+
+// Runs on the input thread: stamp the event, queue it, wake the overlay thread. Never blocks.
+LRESULT CALLBACK LowLevelKeyboardProc(int code, WPARAM wParam, LPARAM lParam)
+{
+    if (code == HC_ACTION)
+    {
+        const KBDLLHOOKSTRUCT* info = (const KBDLLHOOKSTRUCT*)lParam;
+        if (IsOverlayKey(info->vkCode))
+        {
+            KeyEvent e;
+            e.key = (uint16_t)info->vkCode;
+            e.down = wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN;
+            e.timeNs = overlayClock.NowNs();
+            if (keyQueue.Push(e))
+                platform.Signal(keyEventSignal);
+        }
+    }
+    return CallNextHookEx(nullptr, code, wParam, lParam);
+}
+
+// Owns the low-level keyboard hook, which only runs while this thread pumps messages
+DWORD WINAPI InputThread(LPVOID)
+{
+    keyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, LowLevelKeyboardProc, GetModuleHandle(nullptr), 0);
+    if (!keyboardHook)
+        return 1;
+
+    MSG msg;
+    while (GetMessage(&msg, nullptr, 0, 0) > 0)
+    {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+
+    UnhookWindowsHookEx(keyboardHook);
+    keyboardHook = nullptr;
+    return 0;
+}
+
+IntRect PrimaryMonitorRect()
+{
+    MONITORINFO info = { 0 };
+    info.cbSize = sizeof(info);
+    POINT origin = { 0, 0 };
+    GetMonitorInfo(MonitorFromPoint(origin, MONITOR_DEFAULTTOPRIMARY), &info);
+    return MakeRect(info.rcMonitor.left, info.rcMonitor.top, info.rcMonitor.right, info.rcMonitor.bottom);
+}
+
+// Window procedure to do nothing (we don't use WM_PAINT anymore)
+LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    if (msg == WM_DESTROY)
+    {
+        running = false;
+        PostQuitMessage(0);
+        return 0;
+    }
+    // Resolution or monitor layout changed; the next frame lays the windows out again
+    if (msg == WM_DISPLAYCHANGE)
+    {
+        monitorRect = PrimaryMonitorRect();
+        overlay.SetMonitorSize(monitorRect.Width(), monitorRect.Height());
+        return 0;
+    }
+    return DefWindowProc(hwnd, msg, wParam, lParam);
+}
+
+void FreeFrameBitmap(WindowFrame& f)
+{
+    if (f.bitmap)
+        platform.DeleteBitmap(f.bitmap);
+    f.bitmap = nullptr;
+    f.bits = nullptr;
+    f.surface = Surface();
+}
+
+bool AllocateFrameBitmap(WindowFrame& f, int width, int height)
+{
+    FreeFrameBitmap(f);
+    f.bitmap = (HBITMAP)platform.CreateBitmap(width, height, &f.bits);
+    if (!f.bitmap)
+        return false;
+
+    f.surface = Surface(f.bits, width, height, width);
+    return true;
+}
+
+// Publishes the back buffer to the present thread. dirty is what this frame
+// changed; every other buffer has now missed it.
+void SubmitWindowFrame(OverlayWindow& w, const IntRect& dirty)
+{
+    PROFILE_ZONE(overlay.Profiler(), STAGE_SUBMIT);
+    WindowFrame& f = w.frames.Back();
+
+    // A frame still waiting in the mailbox is about to be replaced, so this one
+    // must also carry its changes. If the presenter takes it meanwhile, the
+    // union only marks a little more dirty than needed.
+    f.dirty = w.frames.Pending() ? RectUnion(dirty, w.lastDirty) : dirty;
+    f.position.x = monitorRect.left + w.rect.left;
+    f.position.y = monitorRect.top + w.rect.top;
+    f.visible = w.visible;
+    f.submitNs = overlayClock.NowNs();
+    f.paced = pacedFrame;
+    w.lastDirty = f.dirty;
+
+    int submitted = w.frames.BackIndex();
+    w.frames.Submit();
+    for (int i = 0; i < FrameMailbox<WindowFrame>::BUFFER_COUNT; i++)
+        w.stale[i] = i == submitted ? IntRect() : RectUnion(w.stale[i], dirty);
+    w.moved = false;
+
+    platform.Signal(presentSignal);
+}
+
+// Hides the window and frees the DIBs the overlay thread holds; the present
+// thread keeps the one it last showed until the window is shown again
+void HideOverlayWindow(OverlayWindow& w)
+{
+    w.rect = IntRect();
+    if (!w.visible)
+        return;
+
+    w.visible = false;
+    FreeFrameBitmap(w.frames.Back());
+    SubmitWindowFrame(w, IntRect());
+    FreeFrameBitmap(w.frames.Back());
+}
+
+// Moves a window to rect (monitor coordinates). A size change repaints everything.
+void PlaceOverlayWindow(OverlayWindow& w, const IntRect& rect)
+{
+    if (rect.Width() != w.rect.Width() || rect.Height() != w.rect.Height())
+    {
+        w.tracker.Reset(rect.Width(), rect.Height());
+        w.presentFilter.Reset();
+        for (int i = 0; i < FrameMailbox<WindowFrame>::BUFFER_COUNT; i++)
+            w.stale[i] = w.tracker.SurfaceBounds();
+    }
+
+    if (rect.left != w.rect.left || rect.top != w.rect.top)
+        w.moved = true;
+    w.rect = rect;
+    w.visible = true;
+}
+
+// Brings the back buffer up to the previous frame: a buffer of the wrong size
+// is reallocated and repainted whole, otherwise only what it missed is redrawn
+bool PrepareBackBuffer(OverlayWindow& w)
+{
+    WindowFrame& f = w.frames.Back();
+    int index = w.frames.BackIndex();
+    if (!f.bitmap || f.surface.width != w.rect.Width() || f.surface.height != w.rect.Height())
+    {
+        if (!AllocateFrameBitmap(f, w.rect.Width(), w.rect.Height()))
+            return false;
+        w.stale[index] = w.tracker.SurfaceBounds();
+    }
+    w.tracker.Invalidate(w.stale[index]);
+    w.stale[index] = IntRect();
+    return true;
+}
+
+// Present thread: shows the newest frame of one window, if there is one.
+// newest is the latest overlay frame presented so far this pass.
+void PresentWindowFrame(HDC dc, OverlayWindow& w, PacedFrame& newest)
+{
+    if (!w.frames.Acquire())
+        return;
+
+    WindowFrame& f = w.frames.Front();
+    if (!f.visible)
+    {
+        if (w.shown)
+            platform.ShowWindow(w.hwnd, false);
+        w.shown = false;
+        return;
+    }
+
+    PlatformHandle previous = platform.Select(dc, f.bitmap);
+    platform.Present(w.hwnd, dc, f.position.x, f.position.y, f.surface.width, f.surface.height, f.dirty);
+
+    // Deselect so the overlay thread can delete the bitmap once it owns it again
+    platform.Select(dc, previous);
+
+    if (!w.shown)
+        platform.ShowWindow(w.hwnd, true);
+    w.shown = true;
+    presentLatency.Record((uint64_t)(overlayClock.NowNs() - f.submitNs));
+    if (f.paced.id > newest.id)
+        newest = f.paced;
+}
+
+DWORD WINAPI PresentThread(LPVOID)
+{
+    HDC dc = (HDC)platform.CreateContext();
+    while (presenting.load(std::memory_order_acquire))
+    {
+        platform.Wait(&presentSignal, 1, false);
+        GovernorWorkScope work(overlay.Governor(), overlayClock);
+        PacedFrame newest;
+        for (int i = 0; i < WINDOW_COUNT; i++)
+            PresentWindowFrame(dc, overlayWindows[i], newest);
+
+        // A frame counts as shown once all its windows are
+        pacer.Presented(newest, overlayClock.NowNs());
+    }
+    platform.DeleteContext(dc);
+    return 0;
+}
+
+// Repaints one window. rect is where its content goes this frame (empty hides
+// the window). report(tracker, dx, dy) reports the widgets in window
+// coordinates, which are monitor coordinates offset by (dx, dy);
+// draw(surface, damage, dx, dy) redraws whatever overlaps one damage rect.
+template <class ReportFn, class DrawFn>
+void UpdateOverlayWindow(OverlayWindow& w, const IntRect& rect, ReportFn report, DrawFn draw)
+{
+    if (rect.IsEmpty())
+    {
+        HideOverlayWindow(w);
+        return;
+    }
+    PlaceOverlayWindow(w, rect);
+
+    int dx = -rect.left, dy = -rect.top;
+    {
+        PROFILE_ZONE(overlay.Profiler(), STAGE_DAMAGE);
+        w.tracker.BeginFrame();
+        report(w.tracker, dx, dy);
+        w.tracker.Resolve();
+    }
+
+    // Nothing moved or changed: leave the buffers and the window alone
+    if (!w.tracker.HasDamage() && !w.moved)
+        return;
+
+    // A pure move changes no pixels, but the compositor still needs the whole window once
+    IntRect dirty = w.tracker.HasDamage() ? w.tracker.DamageBounds() : w.tracker.SurfaceBounds();
+    if (!PrepareBackBuffer(w))
+    {
+        HideOverlayWindow(w);
+        return;
+    }
+
+    // Clear only the damage to transparent and redraw what overlaps it
+    WindowFrame& f = w.frames.Back();
+    long long damageArea = 0;
+    for (int i = 0; i < w.tracker.DamageCount(); i++)
+        damageArea += w.tracker.Damage(i).Area();
+    {
+        PROFILE_ZONE(overlay.Profiler(), STAGE_CLEAR);
+        ClearDamage(f.bits, f.surface.stride * 4, w.tracker);
+        clearedBytes += (uint64_t)damageArea * sizeof(Pixel);
+    }
+
+    // Large repaints are recorded, then drawn by the compositor's threads
+    bool compose = compositor && damageArea >= COMPOSE_MIN_PIXELS;
+    Surface target = f.surface;
+    if (compose)
+    {
+        frameCommands.Clear();
+        target.recorder = &frameCommands;
+    }
+
+    // Damage rectangles never overlap, so each pixel is blended exactly once
+    for (int i = 0; i < w.tracker.DamageCount(); i++)
+    {
+        const IntRect& damage = w.tracker.Damage(i);
+        target.SetClip(damage);
+        draw(target, damage, dx, dy);
+    }
+
+    if (compose)
+    {
+        PROFILE_ZONE(overlay.Profiler(), STAGE_COMPOSE);
+        compositor->Compose(frameCommands, f.surface);
+        overlay.Governor().AddWork(compositor->TakeHelperWorkNs());
+    }
+
+    // A repaint that came out the same as the frame on screen is not presented;
+    // the back buffer already matches it, so no other buffer has missed anything
+    {
+        PROFILE_ZONE(overlay.Profiler(), STAGE_HASH);
+        if (!w.presentFilter.ShouldPresent(f.surface, dirty, w.moved, presentStats))
+            return;
+    }
+
+    SubmitWindowFrame(w, dirty);
+}
+
+// Lays out, repaints and presents whatever changed since the last frame
+void RenderFrame()
+{
+    overlay.LayoutWindows([](OverlayWindowId id, const IntRect& rect, auto report, auto draw)
+    {
+        UpdateOverlayWindow(overlayWindows[id], rect, report, draw);
+    });
+
+    UpdateOverlayWindow(overlayWindows[WINDOW_PROFILER], overlay.ProfilerReadoutEnabled() ? ProfilerReadoutBounds(PROFILER_X, PROFILER_Y) : IntRect(),
+        [&](DirtyRegionTracker& tracker, int, int)
+        {
+            tracker.Report(WIDGET_CONTENT, tracker.SurfaceBounds(), overlay.ProfilerReadoutGeneration());
+        },
+        [&](Surface& surface, const IntRect&, int dx, int dy)
+        {
+            DrawProfilerReadout(surface, overlayText, PROFILER_X + dx, PROFILER_Y + dy);
+        });
+}
+
+// Publishes the frame that started at startNs and was drawn for the sources in
+// fired. Stage times are the profiler's, so they read 0 in a build without it.
+void PublishTelemetry(uint32_t fired, int64_t startNs, int64_t endNs)
+{
+    TelemetryRecord r = {};
+    r.timeNs = startNs;
+    r.frameNs = (uint32_t)(endNs - startNs);
+    r.reasons = fired;
+    FrameProfiler& profiler = overlay.Profiler();
+    for (int i = 0; i < profiler.StageCount() && i < TELEMETRY_MAX_STAGES; i++)
+        r.stageNs[i] = (uint32_t)profiler.FrameTotal(i);
+    r.clearedBytes = clearedBytes - telemetryClearedBytes;
+    r.presentedBytes = presentStats.presentedBytes - telemetryPresentStats.presentedBytes;
+    r.windowsPresented = (uint16_t)(presentStats.presented - telemetryPresentStats.presented);
+    r.windowsSkipped = (uint16_t)(presentStats.skipped - telemetryPresentStats.skipped);
+    uint64_t heapAllocations = frameArena.Stats().heapAllocations + overlay.Sprites().MemoryUse().heapAllocations;
+    r.heapAllocations = (uint16_t)(heapAllocations - heapAllocationsSeen);
+    r.qualityLevel = (uint16_t)overlay.Governor().Level();
+    telemetry.Publish(r);
+
+    telemetryPresentStats = presentStats;
+    telemetryClearedBytes = clearedBytes;
+}
+
+// Applies the affinity and priority build options to one of the overlay's threads
+void ConfigureOverlayThread(HANDLE thread)
+{
+    if (ASTRAL_THREAD_AFFINITY)
+        SetThreadAffinityMask(thread, (DWORD_PTR)ASTRAL_THREAD_AFFINITY);
+    SetThreadPriority(thread, ASTRAL_THREAD_PRIORITY);
+}
+
+// Keys the host handles itself act once per press; held keys repeat downs
+bool HostKeyPressed(const KeyEvent& e, bool& down)
+{
+    bool pressed = e.down && !down;
+    down = e.down;
+    return pressed;
+}
+
+// Sleeps until the next scheduled frame or key repeat, a queued key event, a
+// window message or a change in the directory the profile file is in. Under
+// compositor pacing a frame wakes the loop just before the refresh it makes.
+void WaitForNextFrame(HANDLE timer)
+{
+    int64_t now = overlayClock.NowNs();
+    int64_t wake = pacer.StartNs(overlay.NextWakeNs());
+    if (wake <= now || keyQueue.Size() > 0)
+        return;
+
+    if (wake == NO_DEADLINE)
+        platform.CancelTimer(timer);
+    else
+        platform.ArmTimer(timer, wake - now);
+
+    HANDLE handles[3] = { timer, keyEventSignal, profileWatch };
+    int count = profileWatch != INVALID_HANDLE_VALUE ? 3 : 2;
+    platform.Wait(handles, count, true);
+}
+
+DWORD WINAPI OverlayThread(LPVOID)
+{
+    WNDCLASS wc = { 0 };
+    wc.lpfnWndProc = WndProc;
+    wc.hInstance = GetModuleHandle(nullptr);
+    wc.lpszClassName = L"AstralOverlayClass";
+    wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+    RegisterClass(&wc);
+
+    monitorRect = PrimaryMonitorRect();
+    overlay.SetMonitorSize(monitorRect.Width(), monitorRect.Height());
+
+    // Windows start hidden and get their size and position on their first present
+    for (int i = 0; i < WINDOW_COUNT; i++)
+    {
+        overlayWindows[i].hwnd = CreateWindowEx(
+            WS_EX_LAYERED | WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_TRANSPARENT | WS_EX_NOACTIVATE,
+            wc.lpszClassName,
+            L"AstralOverlay",
+            WS_POPUP,
+            0, 0, 1, 1,
+            nullptr, nullptr,
+            wc.hInstance,
+            nullptr);
+
+        if (!overlayWindows[i].hwnd)
+            return 1;
+        resources.Created(OBJECT_WINDOW, overlayWindows[i].hwnd);
+    }
+
+    presentSignal = platform.CreateSignal();
+    presentThread = CreateThread(nullptr, 0, PresentThread, nullptr, 0, nullptr);
+    resources.Created(OBJECT_THREAD, presentThread);
+    ConfigureOverlayThread(GetCurrentThread());
+    ConfigureOverlayThread(presentThread);
+
+    // The render thread is one of the compositor's threads; the others are its helpers
+    if (ASTRAL_RENDER_THREADS > 0)
+    {
+        compositor = new TileCompositor(overlayClock, ASTRAL_RENDER_THREADS);
+        for (int i = 0; i < compositor->ThreadCount() - 1; i++)
+            ConfigureOverlayThread((HANDLE)compositor->Helper(i).native_handle());
+    }
+
+    // The glyph source's DC and bitmap are only needed to build the atlas
+    {
+        GdiGlyphSource glyphSource;
+        overlayText.Build(glyphSource);
+    }
+
+    HANDLE frameTimer = platform.CreateTimer();
+    pacer.SetMode(ASTRAL_PACING);
+
+    // The active profile, if there is a profile file yet, replaces the defaults
+    if (profiles.Load(PROFILE_PATH))
+        overlay.ApplyProfile(ProfileSettings(profiles.ActiveRecord()));
+    profileWatch = FindFirstChangeNotificationA(".", FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (profileWatch != INVALID_HANDLE_VALUE)
+        resources.Created(OBJECT_WATCH, profileWatch);
+
+    // Frames go nowhere if the mapping can't be made
+    if (ASTRAL_TELEMETRY)
+    {
+        const char* sourceNames[FrameScheduler::MAX_SOURCES];
+        FrameScheduler& scheduler = overlay.Scheduler();
+        for (int i = 0; i < scheduler.SourceCount(); i++)
+            sourceNames[i] = scheduler.SourceName(i);
+        telemetry.Open(TELEMETRY_DEFAULT_NAME, PROFILE_STAGE_NAMES, STAGE_COUNT, sourceNames, scheduler.SourceCount(), (uint64_t)overlayClock.NowNs());
+    }
+
+    // Key capture runs on its own thread and feeds keyQueue
+    keyEventSignal = platform.CreateSignal();
+    HANDLE inputThread = CreateThread(nullptr, 0, InputThread, nullptr, 0, &inputThreadId);
+    resources.Created(OBJECT_THREAD, inputThread);
+
+    while (running)
+    {
+        WaitForNextFrame(frameTimer);
+
+        // Everything from here to the next wait counts against the CPU budget
+        GovernorWorkScope work(overlay.Governor(), overlayClock);
+        overlay.StartIteration();
+
+        // Last iteration's scratch is done with: the list it was recorded
+        // into is cleared before the arena under it starts over
+        uint64_t heapAllocations = frameArena.Stats().heapAllocations + overlay.Sprites().MemoryUse().heapAllocations;
+        frameHeapAllocations = heapAllocations - heapAllocationsSeen;
+        heapAllocationsSeen = heapAllocations;
+        frameCommands.Clear();
+        frameArena.Reset();
+
+        PROFILE_BEGIN_FRAME(overlay.Profiler());
+
+        // Input and message processing
+        {
+            PROFILE_ZONE(overlay.Profiler(), STAGE_MESSAGES);
+            MSG msg;
+            while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+            {
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
+                overlay.RequestFrame();
+            }
+
+            // Something in the directory changed. Mapping the file again costs
+            // microseconds, and only a change to the active profile reaches
+            // the overlay, so editing the file never holds up a frame.
+            if (profileWatch != INVALID_HANDLE_VALUE && WaitForSingleObject(profileWatch, 0) == WAIT_OBJECT_0)
+            {
+                FindNextChangeNotification(profileWatch);
+                if (profiles.ReloadIfChanged())
+                    overlay.ApplyProfile(ProfileSettings(profiles.ActiveRecord()));
+            }
+        }
+
+        // F8, F11, Page Up, Page Down and Home are the host's own keys. F11
+        // starts or stops a trace once this iteration is done, so the trace
+        // never holds half an iteration; a profile switch applies on the spot.
+        // Every fresh press is timed to the refresh that shows it.
+        overlay.ProcessInput([](KeyEvent& e)
+        {
+            while (keyQueue.Pop(e))
+            {
+                if (e.down && !inputKeyDown[e.key & 0xFF])
+                    pacer.KeyDown(e.timeNs);
+                inputKeyDown[e.key & 0xFF] = e.down;
+
+                if (e.key == VK_F8)
+                {
+                    if (HostKeyPressed(e, pacingKeyDown))
+                    {
+                        pacer.SetMode(pacer.Mode() == PACING_COMPOSITOR ? PACING_IMMEDIATE : PACING_COMPOSITOR);
+                        overlay.RequestFrame();
+                    }
+                }
+                else if (e.key == VK_F11)
+                {
+                    if (HostKeyPressed(e, traceKeyDown))
+                        traceToggleRequested = true;
+                }
+                else if (e.key == VK_PRIOR || e.key == VK_NEXT)
+                {
+                    int delta = e.key == VK_NEXT ? 1 : -1;
+                    if (HostKeyPressed(e, profileKeyDown[delta > 0]) && profiles.Step(delta))
+                        overlay.ApplyProfile(ProfileSettings(profiles.ActiveRecord()));
+                }
+                else if (e.key == VK_HOME)
+                {
+                    if (HostKeyPressed(e, profileSaveKeyDown))
+                        profileSaveRequested = true;
+                }
+                else
+                {
+                    return true;
+                }
+            }
+            return false;
+        });
+
+        // A frame held back for the compositor stays due, and the wait comes back for it
+        bool held = pacer.Hold(overlay.NextWakeNs());
+        uint32_t fired = 0;
+        if (held)
+            overlay.HoldFrame();
+        else
+        {
+            fired = overlay.BeginFrame();
+            pacedFrame = pacer.FrameBegun(fired);
+        }
+        int64_t frameStartNs = overlayClock.NowNs();
+        if (fired)
+        {
+            PROFILE_ZONE(overlay.Profiler(), STAGE_FRAME);
+            RenderFrame();
+        }
+        PROFILE_END_FRAME(overlay.Profiler());
+        if (fired && telemetry.IsOpen())
+            PublishTelemetry(fired, frameStartNs, overlayClock.NowNs());
+
+        // Calls made between frames, the waits among them, count toward the next
+        if (fired)
+            resources.EndFrame();
+
+#if ASTRAL_PROFILING
+        if (traceToggleRequested)
+        {
+            if (overlay.Tracing())
+                overlay.StopTrace();
+            else
+                overlay.StartTrace(sessionTrace, "astral_session.trace");
+        }
+#endif
+        traceToggleRequested = false;
+
+        // The file is written after the frame; the change notification it
+        // raises finds the file as it was saved and reloads nothing
+        if (profileSaveRequested)
+            profiles.SaveActive(overlay.Settings());
+        profileSaveRequested = false;
+    }
+
+    overlay.StopTrace();
+    telemetry.Close();
+    if (profileWatch != INVALID_HANDLE_VALUE)
+    {
+        resources.Destroyed(OBJECT_WATCH, profileWatch);
+        FindCloseChangeNotification(profileWatch);
+    }
+    PostThreadMessage(inputThreadId, WM_QUIT, 0, 0);
+    WaitForSingleObject(inputThread, INFINITE);
+    resources.Destroyed(OBJECT_THREAD, inputThread);
+    CloseHandle(inputThread);
+    platform.CloseSignal(keyEventSignal);
+    platform.CloseTimer(frameTimer);
+
+    presenting.store(false, std::memory_order_release);
+    platform.Signal(presentSignal);
+    WaitForSingleObject(presentThread, INFINITE);
+    resources.Destroyed(OBJECT_THREAD, presentThread);
+    CloseHandle(presentThread);
+    platform.CloseSignal(presentSignal);
+
+    delete compositor;
+    compositor = nullptr;
+
+    for (int i = 0; i < WINDOW_COUNT; i++)
+    {
+        for (int b = 0; b < FrameMailbox<WindowFrame>::BUFFER_COUNT; b++)
+            FreeFrameBitmap(overlayWindows[i].frames.Buffer(b));
+        resources.Destroyed(OBJECT_WINDOW, overlayWindows[i].hwnd);
+        DestroyWindow(overlayWindows[i].hwnd);
+    }
+
+    // Everything the overlay made is gone by now; whatever the tracker still
+    // holds leaked. It goes to a file next to the game and to the debugger's
+    // output, and a debug build stops there so a leak can't go unnoticed
+    if (resources.LiveCount() > 0 || resources.Strays() > 0)
+    {
+        FILE* f = nullptr;
+#if defined(_MSC_VER)
+        if (fopen_s(&f, LEAK_REPORT_PATH, "w") != 0) f = nullptr;
+#else
+        f = fopen(LEAK_REPORT_PATH, "w");
+#endif
+        resources.ForEachLeak([f](const char* line)
+        {
+            OutputDebugStringA(line);
+            if (f) fputs(line, f);
+        });
+        if (f) fclose(f);
+#ifdef _DEBUG
+        __debugbreak();
+#endif
+    }
+
+    return 0;
+}
+
+BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID)
+{
+    if (reason == DLL_PROCESS_ATTACH)
+    {
+        DisableThreadLibraryCalls(hModule);
+        // The thread outlives the handle; nothing waits on it
+        HANDLE thread = CreateThread(nullptr, 0, OverlayThread, nullptr, 0, nullptr);
+        if (thread)
+            CloseHandle(thread);
+    }
+    return TRUE;
+}